@@ -0,0 +1,265 @@
+// aio.c - Asynchronous I/O submission and completion rings
+//
+// Copyright (c) 2024-2025 University of Illinois
+// SPDX-License-identifier: NCSA
+//
+
+#ifdef AIO_TRACE
+#define TRACE
+#endif
+
+#ifdef AIO_DEBUG
+#define DEBUG
+#endif
+
+#include "aio.h"
+#include "conf.h"
+#include "process.h"
+#include "thread.h"
+#include "memory.h"
+#include "heap.h"
+#include "io.h"
+#include "fs.h"
+#include "error.h"
+#include "console.h"
+#include "assert.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+// COMPILE-TIME PARAMETERS
+//
+
+// AIO_NWORKERS is the number of worker threads per process, which is also the
+// number of requests a process can have in progress at once.
+
+#ifndef AIO_NWORKERS
+#define AIO_NWORKERS 4
+#endif
+
+// INTERNAL TYPE DEFINITIONS
+//
+
+struct aioctx {
+    struct aio_ring * ring; // in user memory
+    struct process * proc;
+    struct condition sq_ready; // signalled by aio_enter and aio_stop
+    struct condition cq_ready; // signalled when a completion is posted
+    struct condition idle; // signalled when a worker or waiter leaves
+    unsigned int inflight; // entries taken but not yet completed
+    int nworkers;
+    int nwaiters; // threads blocked in aio_enter
+    char closing;
+};
+
+// INTERNAL FUNCTION DECLARATIONS
+//
+
+static void aio_worker(struct aioctx * ctx);
+static long aio_execute(struct process * proc, const struct aio_sqe * sqe);
+
+// EXPORTED FUNCTION DEFINITIONS
+//
+
+int aio_setup(struct aio_ring * ring) {
+    struct process * const proc = running_thread_process();
+    struct aioctx * ctx;
+    uintptr_t va;
+    int tid;
+    int i;
+
+    trace("%s(%p)", __func__, ring);
+
+    if (proc->aio != NULL)
+        return -EBUSY;
+
+    // The ring must be in user memory and every page of it must be mapped,
+    // since workers access it directly.
+
+    va = (uintptr_t)ring;
+    if (va < UMEM_START_VMA || UMEM_END_VMA - sizeof(*ring) < va || (va & 7))
+        return -EINVAL;
+
+    for (va &= ~(PAGE_SIZE-1); va < (uintptr_t)(ring+1); va += PAGE_SIZE) {
+        if (vma_to_pma(va) == 0)
+            return -EINVAL;
+    }
+
+    ctx = kcalloc(1, sizeof(struct aioctx));
+    if (ctx == NULL)
+        return -ENOMEM;
+
+    ctx->ring = ring;
+    ctx->proc = proc;
+    condition_init(&ctx->sq_ready, "aio_sq_ready");
+    condition_init(&ctx->cq_ready, "aio_cq_ready");
+    condition_init(&ctx->idle, "aio_idle");
+
+    ring->sq_head = ring->sq_tail = 0;
+    ring->cq_head = ring->cq_tail = 0;
+
+    proc->aio = ctx;
+
+    for (i = 0; i < AIO_NWORKERS; i++) {
+        tid = thread_spawn("aio", (void (*)(void))&aio_worker, ctx);
+        if (tid < 0)
+            break;
+
+        thread_set_process(tid, proc);
+        thread_detach(tid);
+        proc->thrcnt += 1;
+        ctx->nworkers += 1;
+    }
+
+    if (ctx->nworkers == 0) {
+        proc->aio = NULL;
+        kfree(ctx);
+        return tid;
+    }
+
+    return 0;
+}
+
+int aio_enter(unsigned int min_complete) {
+    struct process * const proc = running_thread_process();
+    struct aioctx * const ctx = proc->aio;
+    struct aio_ring * ring;
+
+    if (ctx == NULL)
+        return -EINVAL;
+
+    ring = ctx->ring;
+
+    if (AIO_NENT < min_complete)
+        min_complete = AIO_NENT;
+
+    condition_broadcast(&ctx->sq_ready);
+
+    ctx->nwaiters += 1;
+    while (!ctx->closing && ring->cq_tail - ring->cq_head < min_complete)
+        condition_wait(&ctx->cq_ready);
+    ctx->nwaiters -= 1;
+
+    if (ctx->closing)
+        condition_broadcast(&ctx->idle);
+
+    return ring->cq_tail - ring->cq_head;
+}
+
+void aio_stop(struct aioctx * ctx) {
+    ctx->closing = 1;
+    condition_broadcast(&ctx->sq_ready);
+    condition_broadcast(&ctx->cq_ready);
+}
+
+void aio_shutdown(struct process * proc) {
+    struct aioctx * const ctx = proc->aio;
+
+    if (ctx == NULL)
+        return;
+
+    trace("%s(proc=%d)", __func__, proc->idx);
+
+    aio_stop(ctx);
+
+    while (0 < ctx->nworkers || 0 < ctx->nwaiters)
+        condition_wait(&ctx->idle);
+
+    proc->aio = NULL;
+    kfree(ctx);
+}
+
+int aio_nworkers(const struct aioctx * ctx) {
+    return ctx->nworkers;
+}
+
+// INTERNAL FUNCTION DEFINITIONS
+//
+
+// Each worker runs as a thread of the process that set up the ring, so it runs
+// in the process's memory space and can use the ring and I/O buffers directly.
+// Ring updates are not interleaved between workers because a thread in the
+// kernel is only switched out when it blocks.
+
+void aio_worker(struct aioctx * ctx) {
+    struct aio_ring * const ring = ctx->ring;
+    struct aio_sqe sqe;
+    unsigned int slot;
+    long result;
+
+    for (;;) {
+        // Only take an entry if its completion is sure to have a slot.
+
+        while (!ctx->closing && (ring->sq_head == ring->sq_tail ||
+            AIO_NENT <= ring->cq_tail - ring->cq_head + ctx->inflight))
+        {
+            condition_wait(&ctx->sq_ready);
+        }
+
+        if (ctx->closing)
+            break;
+
+        sqe = ring->sq[ring->sq_head % AIO_NENT];
+        ring->sq_head += 1;
+        ctx->inflight += 1;
+
+        debug("aio: op %d fd %d len %ld tag %lu",
+            sqe.op, sqe.fd, sqe.len, sqe.tag);
+
+        result = aio_execute(ctx->proc, &sqe);
+
+        slot = ring->cq_tail % AIO_NENT;
+        ring->cq[slot].tag = sqe.tag;
+        ring->cq[slot].result = result;
+        __sync_synchronize();
+        ring->cq_tail += 1;
+        ctx->inflight -= 1;
+
+        condition_broadcast(&ctx->cq_ready);
+    }
+
+    ctx->nworkers -= 1;
+    condition_broadcast(&ctx->idle);
+    process_thread_exit();
+}
+
+long aio_execute(struct process * proc, const struct aio_sqe * sqe) {
+    struct io * io;
+    long result;
+
+    if (sqe->fd < 0 || PROCESS_IOMAX <= sqe->fd)
+        return -EBADFD;
+
+    io = proc->iotab[sqe->fd];
+
+    if (io == NULL)
+        return -EBADFD;
+
+    // Hold a reference so that a concurrent close of the descriptor does not
+    // free the I/O object under us.
+
+    ioaddref(io);
+
+    switch (sqe->op) {
+    case AIO_OP_READ:
+        result = ioread(io, sqe->buf, sqe->len);
+        break;
+    case AIO_OP_WRITE:
+        result = iowrite(io, sqe->buf, sqe->len);
+        break;
+    case AIO_OP_READAT:
+        result = ioreadat(io, sqe->pos, sqe->buf, sqe->len);
+        break;
+    case AIO_OP_WRITEAT:
+        result = iowriteat(io, sqe->pos, sqe->buf, sqe->len);
+        break;
+    case AIO_OP_FSYNC:
+        result = fsflush();
+        break;
+    default:
+        result = -EINVAL;
+    }
+
+    ioclose(io);
+    return result;
+}
@@ -0,0 +1,86 @@
+// aio.h - Asynchronous I/O submission and completion rings
+//
+// Copyright (c) 2024-2025 University of Illinois
+// SPDX-License-identifier: NCSA
+//
+
+#ifndef _AIO_H_
+#define _AIO_H_
+
+// A process sets up asynchronous I/O by handing the kernel a struct aio_ring in
+// its own memory. User code fills submission entries and advances sq_tail, then
+// calls the _aio_enter_ system call to kick the kernel's worker threads. Each
+// worker takes an entry (advancing sq_head), performs the I/O, and posts a
+// completion entry (advancing cq_tail). User code consumes completions by
+// advancing cq_head and does not need a system call to do so.
+//
+// The indices are free-running; the slot for index i is i % AIO_NENT. The
+// kernel never has more than AIO_NENT completions outstanding, so the
+// completion ring cannot overflow.
+//
+// The same layout is defined in usr/aio.h.
+
+#define AIO_NENT 32 // entries per ring (power of two)
+
+#define AIO_OP_READ     0 // ioread at the file position
+#define AIO_OP_WRITE    1 // iowrite at the file position
+#define AIO_OP_READAT   2 // ioreadat at _pos_
+#define AIO_OP_WRITEAT  3 // iowriteat at _pos_
+#define AIO_OP_FSYNC    4 // flush the filesystem
+
+struct aio_sqe {
+    int op;
+    int fd;
+    unsigned long long pos;
+    void * buf;
+    long len;
+    unsigned long tag; // copied to the completion entry
+};
+
+struct aio_cqe {
+    unsigned long tag;
+    long result; // as returned by the corresponding io function
+};
+
+struct aio_ring {
+    volatile unsigned int sq_head; // advanced by kernel
+    volatile unsigned int sq_tail; // advanced by user
+    volatile unsigned int cq_head; // advanced by user
+    volatile unsigned int cq_tail; // advanced by kernel
+    struct aio_sqe sq[AIO_NENT];
+    struct aio_cqe cq[AIO_NENT];
+};
+
+struct process; // extern decl.
+struct aioctx;  // opaque decl.
+
+// EXPORTED FUNCTION DECLARATIONS
+//
+
+// Registers _ring_ with the running process and starts the process's AIO
+// worker threads. Returns 0 on success, -EBUSY if the process already has a
+// ring, or another negative error code.
+
+extern int aio_setup(struct aio_ring * ring);
+
+// Wakes the workers to pick up newly submitted entries, then waits until at
+// least _min_complete_ completions are available. Returns the number of
+// completions available.
+
+extern int aio_enter(unsigned int min_complete);
+
+// Asks a process's workers to stop. Does not wait for them to exit.
+
+extern void aio_stop(struct aioctx * ctx);
+
+// Stops a process's workers and waits for in-flight requests to finish, then
+// releases the process's AIO state. Called before the process's memory space
+// is discarded or the process exits.
+
+extern void aio_shutdown(struct process * proc);
+
+// Returns the number of AIO worker threads still running for _ctx_.
+
+extern int aio_nworkers(const struct aioctx * ctx);
+
+#endif // _AIO_H_
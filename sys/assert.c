@@ -10,6 +10,7 @@
 // Define a weak kprintf() so that panic() and assert() still work even
 // if the kernel is built without console.o.
 extern void kprintf(const char * fmt, ...) __attribute__ ((weak));
+extern void console_flush(void) __attribute__ ((weak));
 
 void panic_actual(const char * srcfile, int srcline, const char * msg) {    
     if (msg != NULL && *msg != '\0')
@@ -17,14 +18,20 @@ void panic_actual(const char * srcfile, int srcline, const char * msg) {
     else
         klprintf("PANIC", srcfile, srcline, "\n");
 
+    console_flush(); // interrupts may never run again
     halt_failure();
 }
 
 void assert_failed(const char * srcfile, int srcline, const char * stmt) {
     klprintf("ASSERT", srcfile, srcline, "failed (%s)\n", stmt);
+    console_flush();
     halt_failure();
 }
 
 void kprintf(const char * fmt, ...) {
     // nothing
+}
+
+void console_flush(void) {
+    // nothing
 }
\ No newline at end of file
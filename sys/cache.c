@@ -4,15 +4,25 @@
 #include "heap.h"
 #include "ktfs.h"
 #include "thread.h"
+#include "ktrace.h"
+#include "work.h"
+#include <stdint.h>
 
 #define CACHE_SZ 64         //amount of blocks that can be stored in cache
 
+// The cache is write-back: releasing a dirty block only marks it, and the
+// flush_work item writes dirty blocks to the backing device from the system
+// workqueue, so the releasing thread does not wait for the device. A dirty
+// block picked for eviction is written back first. Before the workqueue is
+// running (unit tests), dirty blocks are written through on release.
+
 struct block_node {
     struct block_node * next;
     struct ktfs_data_block block;
     unsigned long long idx;
     unsigned long long release;
     void * ptr;
+    char dirty;             //modified since last written back
     struct lock lock;
 };
 
@@ -22,8 +32,12 @@ struct cache {
     struct block_node * head;
     unsigned long long last_release;
     unsigned size;
+    struct work flush_work;
 };
 
+static int cache_write_back(struct cache *cache, struct block_node *node);
+static void cache_flush_work(void *aux);
+
 // int create_cache(struct io *bkgio, struct cache **cptr)
 // parameters:
 //                                                            
@@ -44,6 +58,7 @@ int create_cache(struct io *bkgio, struct cache **cptr) {
     (*cptr)->size = 0;
     (*cptr)->last_release = 0;
     (*cptr)->head = NULL;
+    work_init(&(*cptr)->flush_work, &cache_flush_work, *cptr);
 
     // (*cptr)->blocks = kmalloc(CACHE_BLKSZ);  // Allocate space for a block
     // if (!(*cptr)->blocks) {
@@ -70,51 +85,77 @@ int cache_get_block(struct cache *cache, unsigned long long pos, void **pptr) {
     if (!cache || !pptr) return -1;
     //*pptr = cache->blocks;  // For now, return a fixed block
     struct block_node * node;
-    if(cache->head == NULL){                                 //cache is empty, create new block
-        cache->head = kmalloc(sizeof(struct block_node));
-        cache->head->next = NULL;
-        lock_init(&cache->head->lock);
-        node = cache->head;
-        cache->size++;
-    }
-    else{
-        node = cache->head;                     //search cache if block is already in it
-        struct block_node * LRU_node = node;
-        for(unsigned i = 0; (node->next != NULL) && (i < CACHE_SZ); node = node->next){
-            if(node->idx == pos){
-                lock_acquire(&node->lock);
-                *pptr = &node->block;
-                node->ptr = *pptr;
-                return 0;
-            }
-            if(node->release < LRU_node->release){
-                LRU_node = node;
-            }
-            i++;
-        }
+    struct block_node * LRU_node;
+
+    // Several threads may be in here at once (AIO workers, for example), and
+    // any of them can block on a node lock or on the device. A node that is in
+    // use has release == UINT64_MAX and is never picked for eviction. After
+    // blocking on a node's lock we check that it still holds our block, since
+    // it may have been recycled in the meantime.
+
+retry:
+    LRU_node = NULL;
+    for(node = cache->head; node != NULL; node = node->next){       //search cache if block is already in it
         if(node->idx == pos){
             lock_acquire(&node->lock);
+            if(node->idx != pos){
+                lock_release(&node->lock);
+                goto retry;
+            }
+            node->release = UINT64_MAX;
             *pptr = &node->block;
             node->ptr = *pptr;
+            ktrace(KT_CACHE_HIT, 0, pos);
             return 0;
         }
-        if(cache->size == CACHE_SZ){        //if cache full, choose node to evict
-            node = LRU_node;
+        if(node->release != UINT64_MAX && (LRU_node == NULL || node->release < LRU_node->release)){
+            LRU_node = node;
         }
-        else{
-            node->next = kmalloc(sizeof(struct block_node));    
-            cache->size++;
-            node = node->next;
-            node->next = NULL;
-            lock_init(&node->lock);
+    }
+
+    ktrace(KT_CACHE_MISS, 0, pos);
+
+    if(cache->size < CACHE_SZ || LRU_node == NULL){         //room left (or every block in use), add a node
+        node = kmalloc(sizeof(struct block_node));
+        if (!node) return -1;
+        lock_init(&node->lock);
+        node->dirty = 0;
+        node->next = cache->head;
+        cache->head = node;
+        cache->size++;
+    }
+    else{                                   //if cache full, evict least recently released node
+        node = LRU_node;
+
+        // Write a dirty victim back while it still holds its old block, so
+        // that nobody can miss on that block and read the stale copy from the
+        // device meanwhile. The node may be taken while we wait, so start over.
+
+        if(node->dirty){
+            lock_acquire(&node->lock);
+            if(cache_write_back(cache, node) < 0){
+                lock_release(&node->lock);
+                return -1;
+            }
+            lock_release(&node->lock);
+            goto retry;
         }
     }
-    ioreadat(cache->bkgio, pos, &node->block, KTFS_BLKSZ);
+
+    // Claim the node before reading into it so that nobody else evicts it or
+    // looks up the old block in it while we wait for the device.
+
     node->idx = pos;
     node->release = UINT64_MAX;             //block still in use until release, set to max release time
+    lock_acquire(&node->lock);
+    if (ioreadat(cache->bkgio, pos, &node->block, KTFS_BLKSZ) < 0) {
+        node->idx = UINT64_MAX;
+        node->release = 0;
+        lock_release(&node->lock);
+        return -1;
+    }
     *pptr = &node->block;
     node->ptr = *pptr;
-    lock_acquire(&node->lock);
     return 0;
 }
 
@@ -126,23 +167,26 @@ int cache_get_block(struct cache *cache, unsigned long long pos, void **pptr) {
 //          pblk - A (physical) pointer to the block data returned by cache_get_block().
 //          dirty - 1 if the block should be written back to backing device, 0 otherwise.
 // 
-//  Description: releases lock on block, writes back to cache if block is dirty
+//  Description: releases lock on block; a dirty block is written back later by
+//  the flush work item
 //    
 //  Returns:   none
 
 void cache_release_block(struct cache *cache, void *pblk, int dirty) {
-    // Placeholder: In a real implementation, mark the block as dirty/clean
     struct block_node * node = cache->head;
-    for(unsigned i = 0; (node != NULL) && (i < CACHE_SZ); node = node->next){
+    for(; node != NULL; node = node->next){
         if(node->ptr == pblk){
             if(dirty == CACHE_DIRTY){
-                iowriteat(cache->bkgio, node->idx, pblk, KTFS_BLKSZ);
-                memcpy(node->block.data, pblk, KTFS_BLKSZ);     //save block in cache
+                node->dirty = 1;
+                if(workmgr_initialized)
+                    schedule_work(&cache->flush_work);
+                else
+                    cache_write_back(cache, node);
             }
             node->release = cache->last_release++;
             lock_release(&node->lock);
+            break;
         }
-        i++;
     }
 }
 
@@ -152,15 +196,49 @@ void cache_release_block(struct cache *cache, void *pblk, int dirty) {
 //          
 //              cache - The cache to write back.
 // 
-//  Description: flushes the cache - write through cache -- does nothing
+//  Description: writes every dirty block back to the backing device, waiting
+//  for blocks that are in use to be released first
 //    
 //  Returns:   0 on success, or a negative error code
 
 int cache_flush(struct cache *cache) {
-    // Placeholder: Would write back dirty blocks to storage -- write through cache: this wont do anything
+    struct block_node * node;
+    int result = 0;
+
+    // Nodes are only ever added at the head, so the list can be walked while
+    // other threads use the cache.
+
+    for(node = cache->head; node != NULL; node = node->next){
+        if(node->dirty){
+            lock_acquire(&node->lock);
+            if(cache_write_back(cache, node) < 0)
+                result = -1;
+            lock_release(&node->lock);
+        }
+    }
+
+    return result;
+}
+
+// Writes _node_'s block back if it is dirty. The caller holds the node's lock.
+// The block stays dirty until the write has completed, so that it is not
+// picked for eviction in the meantime.
+
+static int cache_write_back(struct cache *cache, struct block_node *node) {
+    if(!node->dirty)
+        return 0;
+
+    if(iowriteat(cache->bkgio, node->idx, &node->block, KTFS_BLKSZ) < 0)
+        return -1;
+
+    node->dirty = 0;
     return 0;
 }
 
+static void cache_flush_work(void *aux) {
+    cache_flush(aux);
+}
+
 // #include "cache.h"
 // #include <stdlib.h>  
 // #include <string.h>
@@ -14,17 +14,48 @@
 #include "string.h"
 #include "ioimpl.h"  // needed for iointf
 
+// COMPILE-TIME PARAMETERS
+//
+
+// CONSOLE_LOGSZ is the size of the console output ring. It must be a power of
+// two.
+
+#ifndef CONSOLE_LOGSZ
+#define CONSOLE_LOGSZ 4096
+#endif
 
 // INTERNAL FUNCTION DECLARATIONS
 // 
 
 static void vprintf_putc(char c, void * aux);
+static void console_putc(char c);
+static void console_start(void);
+static void log_printf(const char * fmt, ...);
+static void log_putc(char c);
 
 // EXPORTED GLOBAL VARIABLES
 //
 
 char console_initialized = 0;
 
+// INTERNAL GLOBAL VARIABLES
+//
+
+// A driver that can send the log ring faster than console_device_kick (see
+// console_set_kick) replaces it here.
+
+static void (*console_kick)(void) = NULL;
+
+// Console output goes into the log ring and is sent to the device later, by
+// console_device_kick() or the device's transmit interrupt. The indices are
+// free-running.
+
+static struct {
+    unsigned int head; // where kputc appends
+    unsigned int tail; // where the device takes from
+    char buf[CONSOLE_LOGSZ];
+} logring;
+
 // EXPORTED FUNCTION DEFINITIONS
 //
 
@@ -35,23 +66,42 @@ void console_init(void) {
 }
 
 void kputc(char c) {
-    static char cprev = '\0';
+    console_putc(c);
+    console_start();
+}
 
-    switch (c) {
-    case '\r':
-        console_device_putc(c);
-        console_device_putc('\n');
-        break;
-    case '\n':
-        if (cprev != '\r')
-            console_device_putc('\r');
-        // nobreak
-    default:
-        console_device_putc(c);
-        break;
-    }
+void console_set_kick(void (*kick)(void)) {
+    int pie;
 
-    cprev = c;
+    // The old device must stop taking from the ring, or output would be split
+    // between the two and come out of order.
+
+    pie = disable_interrupts();
+    console_device_release();
+    console_kick = kick;
+    restore_interrupts(pie);
+}
+
+long console_log_take(char * buf, long n) {
+    long cnt = 0;
+    int pie;
+
+    pie = disable_interrupts();
+    while (cnt < n && logring.tail != logring.head)
+        buf[cnt++] = logring.buf[logring.tail++ % CONSOLE_LOGSZ];
+    restore_interrupts(pie);
+
+    return cnt;
+}
+
+void console_flush(void) {
+    char c;
+    int pie;
+
+    pie = disable_interrupts();
+    while (console_log_take(&c, 1) != 0)
+        console_device_putc(c);
+    restore_interrupts(pie);
 }
 
 char kgetc(void) {
@@ -78,8 +128,9 @@ void kputs(const char * str) {
     pie = disable_interrupts();
 
     while (*str != '\0')
-        kputc(*str++);
-    kputc('\n');
+        console_putc(*str++);
+    console_putc('\n');
+    console_start();
 
     restore_interrupts(pie);
 }
@@ -101,9 +152,10 @@ char * kgetsn(char * buf, size_t n) {
 		case '\b':
 		case '\177':
 			if (p != buf) {
-				kputc('\b');
-				kputc(' ');
-				kputc('\b');
+				console_putc('\b');
+				console_putc(' ');
+				console_putc('\b');
+				console_start();
 
 				p -= 1;
 				n += 1;
@@ -134,6 +186,7 @@ void kvprintf(const char * fmt, va_list ap) {
 
     pie = disable_interrupts();
     vgprintf(vprintf_putc, NULL, fmt, ap);
+    console_start();
     restore_interrupts(pie);
 }
 
@@ -148,13 +201,15 @@ void klprintf (
 
     pie = disable_interrupts();
 
-    kprintf("%s %s:%d: ", label, src_flname, src_lineno);
+    log_printf("%s %s:%d: ", label, src_flname, src_lineno);
 
     va_start(ap, fmt);
-    kvprintf(fmt, ap);
-    kputc('\n');
+    vgprintf(vprintf_putc, NULL, fmt, ap);
+    console_putc('\n');
     va_end(ap);
 
+    console_start();
+
     restore_interrupts(pie);
 }
 
@@ -162,7 +217,75 @@ void klprintf (
 //
 
 void vprintf_putc(char c, void * __attribute__ ((unused)) aux) {
-    kputc(c);
+    console_putc(c);
+}
+
+// Appends a character to the log ring, translating line endings. It does not
+// start the device: kputc, kputs, kprintf and kgetsn do that once at the end,
+// since on the UART each start is an MMIO read-modify-write of IER.
+
+void console_putc(char c) {
+    static char cprev = '\0';
+
+    switch (c) {
+    case '\r':
+        log_putc(c);
+        log_putc('\n');
+        break;
+    case '\n':
+        if (cprev != '\r')
+            log_putc('\r');
+        // nobreak
+    default:
+        log_putc(c);
+        break;
+    }
+
+    cprev = c;
+}
+
+// Lets the device start sending what is in the log ring.
+
+void console_start(void) {
+    if (console_kick != NULL)
+        console_kick();
+    else
+        console_device_kick();
+}
+
+void log_printf(const char * fmt, ...) {
+    va_list ap;
+
+    va_start(ap, fmt);
+    vgprintf(vprintf_putc, NULL, fmt, ap);
+    va_end(ap);
+}
+
+// Appends a character to the log ring. This only finds the ring full if the
+// kernel prints faster than the device drains. The console device then sends
+// the oldest character synchronously to make room, so its output is never
+// lost. A driver that took over with console_set_kick is kicked to take what
+// it can instead, and if that frees nothing, the oldest character is dropped:
+// writing it to the console device would put it on a different device, out of
+// order with the rest.
+
+void log_putc(char c) {
+    int pie;
+
+    pie = disable_interrupts();
+
+    if (logring.head - logring.tail == CONSOLE_LOGSZ) {
+        if (console_kick == NULL)
+            console_device_putc(logring.buf[logring.tail++ % CONSOLE_LOGSZ]);
+        else {
+            console_kick();
+            if (logring.head - logring.tail == CONSOLE_LOGSZ)
+                logring.tail += 1;
+        }
+    }
+
+    logring.buf[logring.head++ % CONSOLE_LOGSZ] = c;
+    restore_interrupts(pie);
 }
 
 // DEFAULT CONSOLE FUNCTION DEFINITIONS
@@ -176,6 +299,7 @@ void vprintf_putc(char c, void * __attribute__ ((unused)) aux) {
 
 extern void console_device_init(void) __attribute__ ((weak));
 extern void console_device_putc(char c) __attribute__ ((weak));
+extern void console_device_kick(void) __attribute__ ((weak));
 extern char console_device_getc(void) __attribute__ ((weak));
 
 void console_device_init(void) {
@@ -186,6 +310,10 @@ void console_device_putc(char c __attribute__ ((unused))) {
     // nothing
 }
 
+void console_device_kick(void) {
+    console_flush();
+}
+
 char console_device_getc(void) {
     panic("no getc");
 }
\ No newline at end of file
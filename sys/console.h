@@ -20,6 +20,13 @@ extern char kgetc(void);
 extern void kputs(const char * str);
 extern char * kgetsn(char * buf, size_t n);
 
+// Console output is buffered in a log ring and sent to the device by its
+// transmit interrupt, so kprintf does not wait for the device. The device is
+// started once per kputc, kputs or kprintf call, not once per character. console_flush
+// sends everything still buffered synchronously; the panic path uses it.
+
+extern void console_flush(void);
+
 extern void kprintf(const char * fmt, ...);
 extern void kvprintf(const char * fmt, va_list ap);
 
@@ -32,13 +39,26 @@ extern void klprintf (
     int lineno,
     const char * fmt, ...);
 
-#ifdef DEBUG
+// debug() and trace() output is compiled in for a file that defines DEBUG or
+// TRACE (usually through its own FILE_DEBUG and FILE_TRACE switches), or for
+// every file when the kernel is built with LOG_LEVEL at or above LOG_DEBUG or
+// LOG_TRACE (make LOG_LEVEL=n). Otherwise the calls compile to nothing.
+
+#define LOG_NONE  0
+#define LOG_DEBUG 1
+#define LOG_TRACE 2
+
+#ifndef LOG_LEVEL
+#define LOG_LEVEL LOG_NONE
+#endif
+
+#if defined(DEBUG) || LOG_DEBUG <= LOG_LEVEL
 #define debug(...) klprintf("DEBUG", __FILE__, __LINE__, __VA_ARGS__)
 #else
 #define debug(...) do {} while(0)
 #endif
 
-#ifdef TRACE
+#if defined(TRACE) || LOG_TRACE <= LOG_LEVEL
 #define trace(...) klprintf("TRACE", __FILE__, __LINE__, __VA_ARGS__)
 #else
 #define trace(...) do {} while(0)
@@ -49,6 +69,26 @@ extern void klprintf (
 extern void console_device_init(void);
 extern void console_device_putc(char c);
 extern char console_device_getc(void);
+
+// console_device_kick tells the device that the log ring has data. The device
+// takes it with console_log_take, which returns the number of characters
+// copied into _buf_ (at most _n_). Until the device can take interrupts,
+// console_device_kick just calls console_flush.
+
+extern void console_device_kick(void);
+extern long console_log_take(char * buf, long n);
+
+// console_device_release stops the device's transmit interrupt from taking
+// from the log ring. console_set_kick calls it when another driver takes over.
+
+extern void console_device_release(void);
+
+// console_set_kick hands the log ring to another device driver (viocons.c),
+// whose _kick_ function the console calls from then on instead of
+// console_device_kick, after releasing the console device. From then on, only
+// the panic path (console_flush) writes to the console device.
+
+extern void console_set_kick(void (*kick)(void));
 extern struct io *console_io;
 
 
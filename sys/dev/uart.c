@@ -19,16 +19,28 @@
 #include "console.h"
 
 #include "error.h"
+#include "string.h"
 
 #include <stdint.h>
 
 #include "thread.h"
+#include "work.h"
 
 // COMPILE-TIME CONSTANT DEFINITIONS
 //
 
+// UART_RBUFSZ is the size of each of the receive and transmit ring buffers. It
+// must be a power of two.
+
 #ifndef UART_RBUFSZ
-#define UART_RBUFSZ 64
+#define UART_RBUFSZ 512
+#endif
+
+// UART_FIFO_DEPTH is the size of the 16550 receive and transmit FIFOs, which
+// bounds how many bytes the ISR can move per interrupt.
+
+#ifndef UART_FIFO_DEPTH
+#define UART_FIFO_DEPTH 16
 #endif
 
 #ifndef UART_INTR_PRIO
@@ -72,6 +84,10 @@ struct uart_regs {
 #define LSR_THRE (1 << 5)
 #define IER_DRIE (1 << 0)
 #define IER_THREIE (1 << 1)
+#define FCR_FE (1 << 0) // FIFO enable
+#define FCR_RFR (1 << 1) // receive FIFO reset
+#define FCR_TFR (1 << 2) // transmit FIFO reset
+#define FCR_RT8 (2 << 6) // receive interrupt at 8 bytes
 
 struct ringbuf {
     unsigned int hpos; // head of queue (from where elements are removed)
@@ -92,8 +108,24 @@ struct uart_device {
     struct ringbuf txbuf;
     struct condition rxbuf_not_empty;
     struct condition txbuf_not_full;
+    struct pollq pollq;
+
+    // The ISR only moves bytes between the FIFOs and the rings. Waking up
+    // readers, writers and pollers is left to this tasklet; rxwake and
+    // txwake tell it which.
+    struct tasklet wake_tasklet;
+    char rxwake;
+    char txwake;
 };
 
+// INTERNAL GLOBAL VARIABLES
+//
+
+// console_async is set once uart_attach has hooked up console_isr for UART0.
+// Until then, console output is written synchronously.
+
+static char console_async = 0;
+
 // INTERNAL FUNCTION DEFINITIONS
 //
 
@@ -101,14 +133,21 @@ static int uart_open(struct io ** ioptr, void * aux);
 static void uart_close(struct io * io);
 static long uart_read(struct io * io, void * buf, long bufsz);
 static long uart_write(struct io * io, const void * buf, long len);
+static int uart_poll(struct io * io, int events);
+static struct pollq * uart_pollq(struct io * io);
 
 static void uart_isr(int srcno, void * driver_private);
+static void uart_wake(void * aux);
+static void console_isr(int srcno, void * aux);
 
 static void rbuf_init(struct ringbuf * rbuf);
 static int rbuf_empty(const struct ringbuf * rbuf);
 static int rbuf_full(const struct ringbuf * rbuf);
+static unsigned int rbuf_count(const struct ringbuf * rbuf);
 static void rbuf_putc(struct ringbuf * rbuf, char c);
 static char rbuf_getc(struct ringbuf * rbuf);
+static void rbuf_put(struct ringbuf * rbuf, const char * src, unsigned int n);
+static void rbuf_get(struct ringbuf * rbuf, char * dst, unsigned int n);
 
 // EXPORTED FUNCTION DEFINITIONS
 // 
@@ -117,7 +156,9 @@ void uart_attach(void * mmio_base, int irqno) {
     static const struct iointf uart_iointf = {
         .close = &uart_close,
         .read = &uart_read,
-        .write = &uart_write
+        .write = &uart_write,
+        .poll = &uart_poll,
+        .pollq = &uart_pollq
     };
 
     struct uart_device * uart;
@@ -128,6 +169,7 @@ void uart_attach(void * mmio_base, int irqno) {
     uart->irqno = irqno;
 
     ioinit0(&uart->io, &uart_iointf);
+    tasklet_init(&uart->wake_tasklet, &uart_wake, uart);
 
     // Check if we're trying to attach UART0, which is used for the console. It
     // had already been initialized and should not be accessed as a normal
@@ -142,11 +184,19 @@ void uart_attach(void * mmio_base, int irqno) {
         uart->regs->dlm = 0x00;
         // fence o,o ?
         uart->regs->lcr = 0; // DLAB=0
+        uart->regs->fcr = FCR_FE | FCR_RFR | FCR_TFR | FCR_RT8;
 
         uart->instno = register_device(UART_NAME, uart_open, uart);
 
-    } else
+    } else {
         uart->instno = register_device(UART_NAME, NULL, NULL);
+
+        // From here on, console output is sent by the transmit interrupt.
+
+        enable_intr_source(irqno, UART_INTR_PRIO, console_isr, uart);
+        console_async = 1;
+        console_device_kick();
+    }
 }
 
 // int uart_open(struct io ** ioptr, void * aux)
@@ -184,6 +234,10 @@ int uart_open(struct io ** ioptr, void * aux) {
     condition_init(&(uart->rxbuf_not_empty), "rxbuf_not_empty");
     condition_init(&(uart->txbuf_not_full), "txbuf_not_full");
 
+    // The io object outlives each open, so don't inherit the last opener's
+    // non-blocking mode.
+
+    uart->io.nonblock = 0;
     *ioptr = ioaddref(&uart->io);
 
 
@@ -222,7 +276,8 @@ void uart_close(struct io * io) {
 // Inputs: struct io * io - io ptr associated with uart device
 //         void * buf - buffer to write to
 //         long bufsz - size of buffer in bytes
-// Outputs: size of data written to buffer
+// Outputs: number of bytes read, at least 1 and at most bufsz; if the io is
+//          non-blocking and nothing has been received, -EAGAIN
 // Description: Copies data read from device into input buffer
 // Side Effects: Enables DRIE
 
@@ -234,30 +289,43 @@ long uart_read(struct io * io, void * buf, long bufsz) {    //change for cp3
     struct uart_device * const uart =
         (void*)io - offsetof(struct uart_device, io);
 
-    if(UART_RBUFSZ < bufsz){
-        return -ENOTSUP;
-    }
-
-    for(long i = 0; i < bufsz; i++){
-        int pie = disable_interrupts();
-        while(rbuf_empty(&uart->rxbuf)){
-            condition_wait(&uart->rxbuf_not_empty);
-        }
-        ((char *)buf)[i] = rbuf_getc(&uart->rxbuf);
-        uart->regs->ier |= IER_DRIE;
-        restore_interrupts(pie);
-    }
+    unsigned int n;
+    int pie;
 
+    if(bufsz <= 0)
+        return 0;
 
+    // Like a terminal, a read returns as soon as some input is available,
+    // taking everything the ring holds (up to _bufsz_) in one interrupt-
+    // disabled window.
 
-    return bufsz;
+    pie = disable_interrupts();
+    while(rbuf_empty(&uart->rxbuf)){
+        if(io->nonblock){
+            restore_interrupts(pie);
+            return -EAGAIN;
+        }
+        if(condition_wait_intr(&uart->rxbuf_not_empty) < 0){
+            restore_interrupts(pie);
+            return -EINTR;
+        }
+    }
+    n = rbuf_count(&uart->rxbuf);
+    if(bufsz < n)
+        n = bufsz;
+    rbuf_get(&uart->rxbuf, buf, n);
+    uart->regs->ier |= IER_DRIE;
+    restore_interrupts(pie);
+
+    return n;
 }
 
 // long uart_write(struct io * io, const void * buf, long len)
 // Inputs: struct io * io - io ptr associated with uart device
 //         void * buf - buffer with data to write to device
 //         long len - size of buffer in bytes
-// Outputs: size of data written to device
+// Outputs: size of data written to device; if the io is non-blocking, the
+//          bytes that fit in the buffer, or -EAGAIN if none did
 // Description: Writes data into uart device transmit buffer
 // Side Effects: Enables THREIE
 
@@ -273,27 +341,61 @@ long uart_write(struct io * io, const void * buf, long len) {       //change for
         return -ENOTSUP;
     }
 
-    for(long i = 0; i < len; i++){
-        int pie = disable_interrupts();
+    long cnt = 0;
+    unsigned int n;
+    int pie;
+
+    while(cnt < len){
+        pie = disable_interrupts();
         while(rbuf_full(&uart->txbuf)){
+            if(io->nonblock){
+                restore_interrupts(pie);
+                return (0 < cnt) ? cnt : -EAGAIN;
+            }
             condition_wait(&uart->txbuf_not_full);
         }
-        
-        rbuf_putc(&uart->txbuf,((char*)buf)[i]);
-        uart->regs->ier |= IER_THREIE;   
+        n = UART_RBUFSZ - rbuf_count(&uart->txbuf);
+        if(len - cnt < n)
+            n = len - cnt;
+        rbuf_put(&uart->txbuf, (const char *)buf + cnt, n);
+        uart->regs->ier |= IER_THREIE;
         restore_interrupts(pie);
+        cnt += n;
     }
 
     return len;
 }
 
+// Reports POLLIN when a byte is waiting in the receive buffer and POLLOUT
+// when the transmit buffer has room.
+
+int uart_poll(struct io * io, int events) {
+    struct uart_device * const uart =
+        (void*)io - offsetof(struct uart_device, io);
+    int revents = 0;
+
+    if (!rbuf_empty(&uart->rxbuf))
+        revents |= POLLIN;
+    if (!rbuf_full(&uart->txbuf))
+        revents |= POLLOUT;
+
+    return revents;
+}
+
+struct pollq * uart_pollq(struct io * io) {
+    struct uart_device * const uart =
+        (void*)io - offsetof(struct uart_device, io);
+
+    return &uart->pollq;
+}
+
 // void uart_isr(int srcno, void * aux)
 // Inputs: struct io * io - io ptr associated with uart device
 //         void * buf - buffer with data to write to device
 //         long len - size of buffer in bytes
 // Outputs: none
 // Description: Analyzes interrupt source and handles interrupt accodringly
-// Side Effects: May disable DRIE or THREIE
+// Side Effects: May disable DRIE or THREIE, schedules uart_wake
 
 void uart_isr(int srcno, void * aux) {                              //change for cp3
     // FIXME your code goes here
@@ -301,37 +403,68 @@ void uart_isr(int srcno, void * aux) {                              //change for
         panic("uart isr bad params");
     }
     struct uart_device * const uart = aux;
+    unsigned int rxcnt = 0;
+    unsigned int txcnt = 0;
+    uint8_t lsr;
 
-    int pie;
-    if(!rbuf_full(&uart->rxbuf)){
-        if((uart->regs->lsr & LSR_DR)){
-            pie = disable_interrupts();
-            rbuf_putc(&uart->rxbuf,uart->regs->rbr);
-            restore_interrupts(pie);
-        }
-    }
-    else{
-        uart->regs->ier &= (~IER_DRIE);
+    // Drain the receive FIFO into the ring. If the ring fills up, stop taking
+    // receive interrupts until a reader makes room.
+
+    while(((lsr = uart->regs->lsr) & LSR_DR) && !rbuf_full(&uart->rxbuf)){
+        if(lsr & LSR_OE)
+            uart->rxovrcnt += 1;
+        rbuf_putc(&uart->rxbuf, uart->regs->rbr);
+        rxcnt += 1;
     }
 
-    if(!rbuf_empty(&uart->txbuf)){
-        if((uart->regs->lsr & LSR_THRE)){
-            pie = disable_interrupts();
+    if(rbuf_full(&uart->rxbuf))
+        uart->regs->ier &= ~IER_DRIE;
+
+    // THRE means the transmit FIFO is empty, so it can take a full FIFO's
+    // worth of bytes.
+
+    if(uart->regs->lsr & LSR_THRE){
+        while(txcnt < UART_FIFO_DEPTH && !rbuf_empty(&uart->txbuf)){
             uart->regs->thr = rbuf_getc(&uart->txbuf);
-            restore_interrupts(pie);
+            txcnt += 1;
         }
     }
-    else{
-         uart->regs->ier &= (~IER_THREIE);
-    }
-    if(!rbuf_empty(&uart->rxbuf)){
+
+    if(rbuf_empty(&uart->txbuf))
+        uart->regs->ier &= ~IER_THREIE;
+
+    if(rxcnt != 0)
+        uart->rxwake = 1;
+
+    if(txcnt != 0)
+        uart->txwake = 1;
+
+    if(rxcnt != 0 || txcnt != 0)
+        tasklet_schedule(&uart->wake_tasklet);
+}
+
+// Wakes up the threads waiting for what the ISR moved.
+
+void uart_wake(void * aux) {
+    struct uart_device * const uart = aux;
+    char rxwake, txwake;
+    int pie;
+
+    pie = disable_interrupts();
+    rxwake = uart->rxwake;
+    txwake = uart->txwake;
+    uart->rxwake = 0;
+    uart->txwake = 0;
+    restore_interrupts(pie);
+
+    if(rxwake)
         condition_broadcast(&uart->rxbuf_not_empty);
-    }
 
-    if(!rbuf_full(&uart->txbuf)){
+    if(txwake)
         condition_broadcast(&uart->txbuf_not_full);
-    }
-   // restore_interrupts(pie);
+
+    if(rxwake || txwake)
+        pollq_wakeup(&uart->pollq);
 }
 
 void rbuf_init(struct ringbuf * rbuf) {
@@ -344,11 +477,15 @@ int rbuf_empty(const struct ringbuf * rbuf) {
 }
 
 int rbuf_full(const struct ringbuf * rbuf) {
-    return ((uint16_t)(rbuf->tpos - rbuf->hpos) == UART_RBUFSZ);
+    return (rbuf->tpos - rbuf->hpos == UART_RBUFSZ);
+}
+
+unsigned int rbuf_count(const struct ringbuf * rbuf) {
+    return rbuf->tpos - rbuf->hpos;
 }
 
 void rbuf_putc(struct ringbuf * rbuf, char c) {
-    uint_fast16_t tpos;
+    unsigned int tpos;
 
     tpos = rbuf->tpos;
     rbuf->data[tpos % UART_RBUFSZ] = c;
@@ -357,7 +494,7 @@ void rbuf_putc(struct ringbuf * rbuf, char c) {
 }
 
 char rbuf_getc(struct ringbuf * rbuf) {
-    uint_fast16_t hpos;
+    unsigned int hpos;
     char c;
 
     hpos = rbuf->hpos;
@@ -367,6 +504,30 @@ char rbuf_getc(struct ringbuf * rbuf) {
     return c;
 }
 
+// Bulk versions of rbuf_putc and rbuf_getc. The caller guarantees that there
+// is room for (or data for) _n_ bytes. The copy is done in at most two spans,
+// up to the end of the array and then from the start.
+
+void rbuf_put(struct ringbuf * rbuf, const char * src, unsigned int n) {
+    unsigned int off = rbuf->tpos % UART_RBUFSZ;
+    unsigned int span = (n < UART_RBUFSZ - off) ? n : UART_RBUFSZ - off;
+
+    memcpy(rbuf->data + off, src, span);
+    memcpy(rbuf->data, src + span, n - span);
+    asm volatile ("" ::: "memory");
+    rbuf->tpos += n;
+}
+
+void rbuf_get(struct ringbuf * rbuf, char * dst, unsigned int n) {
+    unsigned int off = rbuf->hpos % UART_RBUFSZ;
+    unsigned int span = (n < UART_RBUFSZ - off) ? n : UART_RBUFSZ - off;
+
+    memcpy(dst, rbuf->data + off, span);
+    memcpy(dst + span, rbuf->data, n - span);
+    asm volatile ("" ::: "memory");
+    rbuf->hpos += n;
+}
+
 // The functions below provide polled uart input and output for the console.
 
 #define UART0 (*(volatile struct uart_regs*)UART0_MMIO_BASE)
@@ -386,6 +547,7 @@ void console_device_init(void) {
     // The com0_putc and com0_getc functions assume DLAB=0.
 
     UART0.lcr = 0;
+    UART0.fcr = FCR_FE | FCR_RFR | FCR_TFR;
 }
 
 void console_device_putc(char c) {
@@ -396,6 +558,36 @@ void console_device_putc(char c) {
     UART0.thr = c;
 }
 
+void console_device_kick(void) {
+    if (console_async)
+        UART0.ier |= IER_THREIE;
+    else
+        console_flush();
+}
+
+void console_device_release(void) {
+    UART0.ier &= ~IER_THREIE;
+}
+
+// Refills the transmit FIFO from the console log ring. Once the ring is empty,
+// the interrupt is turned off until the next console_device_kick.
+
+void console_isr(int srcno, void * aux) {
+    char buf[UART_FIFO_DEPTH];
+    long n, i;
+
+    if (!(UART0.lsr & LSR_THRE))
+        return;
+
+    n = console_log_take(buf, UART_FIFO_DEPTH);
+
+    for (i = 0; i < n; i++)
+        UART0.thr = buf[i];
+
+    if (n < UART_FIFO_DEPTH)
+        UART0.ier &= ~IER_THREIE;
+}
+
 char console_device_getc(void) {
     // Spin until RBR contains a byte
     while (!(UART0.lsr & LSR_DR))
@@ -26,6 +26,8 @@
 #include "io.h"
 #include "conf.h"
 #include "vioblk.h"
+#include "work.h"
+#include "ktrace.h"
 #include <limits.h>
 
 // COMPILE-TIME PARAMETERS
@@ -41,7 +43,7 @@
 
 // INTERNAL CONSTANT DEFINITIONS
 //
-#define VIOBLK_DESC_COUNT  8  // or 16/32/etc. Must be <= queue_num_max
+#define VIOBLK_DESC_COUNT  16 // or 32/etc. Must be <= queue_num_max
 
 struct virtio_blk_req {
     uint32_t type;      
@@ -74,6 +76,9 @@ struct vioblk_device {
     struct lock lock;  
     struct condition io_done;
 
+    // Used ring processing is deferred out of the ISR to this tasklet.
+    struct tasklet done_tasklet;
+
     // A simple virtqueue. You can adapt the pattern from viorng but with more descriptors:
     struct {
         uint16_t last_used_idx;
@@ -142,6 +147,12 @@ struct vioblk_device {
 
 // static void vioblk_isr(int srcno, void * aux);
 
+static void vioblk_complete(void * aux);
+
+static long vioblk_request (
+    struct vioblk_device * dev, uint32_t type, unsigned long long pos,
+    const struct iovec * iov, int iovcnt);
+
 // EXPORTED FUNCTION DEFINITIONS
 //
 
@@ -162,6 +173,7 @@ void vioblk_attach(volatile struct virtio_mmio_regs * regs, int irqno) {
     dev->irqno = irqno;
     lock_init(&dev->lock);
     condition_init(&dev->io_done, "vioblk_io_done");
+    tasklet_init(&dev->done_tasklet, &vioblk_complete, dev);
 
     for (int i = 0; i < VIOBLK_DESC_COUNT; i++) {
         dev->requests[i].in_use = 0;
@@ -278,6 +290,8 @@ void vioblk_attach(volatile struct virtio_mmio_regs * regs, int irqno) {
 static const struct iointf vioblk_iointf = {
     .readat = &vioblk_readat,
     .writeat = &vioblk_writeat,
+    .readvat = &vioblk_readvat,
+    .writevat = &vioblk_writevat,
     .close = &vioblk_close,
     .cntl = &vioblk_cntl
 };
@@ -303,47 +317,51 @@ void vioblk_isr(int srcno, void * aux) {
     struct vioblk_device * const dev = (struct vioblk_device *)aux;
     if(!dev) return;
 
-    //lock_acquire(&dev->lock);
-
     // Check if the interrupt is for this device   
     uint32_t status = dev->regs->interrupt_status;
-    if(!status) {
-        lock_release(&dev->lock);
+    if(!status)
         return; // No interrupt for this device
-    }
 
     trace("vioblk_isr - irqno=%d status=0x%x", srcno, status);
 
+    // Acknowledge the interrupt here and leave the used ring walk to the
+    // tasklet, which runs after the PLIC source is completed.
+
+    dev->regs->interrupt_ack = status;
+    __sync_synchronize();
+    tasklet_schedule(&dev->done_tasklet);
+}
+
+void vioblk_complete(void * aux) {
+    struct vioblk_device * const dev = (struct vioblk_device *)aux;
+
     while(dev->vq.used.idx != dev->vq.last_used_idx) {
         uint16_t used_pos = dev->vq.last_used_idx % VIOBLK_DESC_COUNT;
         struct virtq_used_elem used_elem = dev->vq.used.ring[used_pos];
 
         uint16_t desc_idx = used_elem.id;
         uint16_t len = used_elem.len;
-        // struct virtq_desc *desc = &dev->vq.desc[desc_idx];
 
         dev->requests[desc_idx].in_use = 0;
         dev->requests[desc_idx].result = len;
         dev->requests[desc_idx].status = dev->status_bytes[desc_idx];
 
+        // Free the rest of the chain now, but leave the head descriptor to
+        // the waiting thread: its index is also the slot holding this
+        // request's result, which must not be reused until it has been read.
+
         uint16_t d = desc_idx;
 
-        while (1){
+        while (dev->vq.desc[d].flags & VIRTQ_DESC_F_NEXT) {
+            d = dev->vq.desc[d].next;
             dev->desc_free[d] = 1;
-            if (dev->vq.desc[d].flags & VIRTQ_DESC_F_NEXT) {
-                d = dev->vq.desc[d].next;
-            } else {
-                break;
-            }
         }
         trace("Processed request: desc_idx=%d len=%d", desc_idx, len);
+        ktrace(KT_VIOBLK_DONE, desc_idx, len);
         dev->vq.last_used_idx++;
     }
 
     condition_broadcast(&dev->io_done); // Notify any waiting threads
-    dev->regs->interrupt_ack = status; // Acknowledge the interrupt
-    __sync_synchronize(); // Ensure memory operations are completed
-    //lock_release(&dev->lock);
 }
 
 int vioblk_cntl (struct io * io, int cmd, void * arg){
@@ -379,6 +397,8 @@ int vioblk_cntl (struct io * io, int cmd, void * arg){
 #define VIRTIO_BLK_T_OUT  1
 #define VIRTIO_BLK_T_FLUSH 4
 
+#define VIRTIO_BLK_S_OK    0
+
 long vioblk_readat(struct io *io, unsigned long long pos, void *buf, long bufsz)
 {
     struct vioblk_device *dev =
@@ -386,140 +406,79 @@ long vioblk_readat(struct io *io, unsigned long long pos, void *buf, long bufsz)
     if (!dev || !buf || bufsz <= 0)
         return -EINVAL;
 
-    lock_acquire(&dev->lock);
-
-    // Enforce block alignment for pos and length.
-    if ((pos % dev->blk_size) != 0 || (bufsz % dev->blk_size) != 0) {
-        lock_release(&dev->lock);
-        return -EINVAL;
-    }
+    const struct iovec iov = { .base = buf, .len = bufsz };
+    return vioblk_request(dev, VIRTIO_BLK_T_IN, pos, &iov, 1);
+}
 
-    if (pos > dev->capacity * dev->blk_size) {
-        lock_release(&dev->lock);
+long vioblk_writeat(struct io *io, unsigned long long pos, const void *buf, long len)
+{
+    struct vioblk_device *dev =
+        (struct vioblk_device *)((char *)io - offsetof(struct vioblk_device, io));
+    if (!dev || !buf || len <= 0)
         return -EINVAL;
-    }
-    
-    uint64_t start_sector = pos / dev->blk_size;
-    long total_blocks = bufsz / dev->blk_size;
-    if (start_sector + total_blocks > dev->capacity) {
-        total_blocks = dev->capacity - start_sector;
-        bufsz = total_blocks * dev->blk_size;
-    }
-
-    // Determine maximum segment size from device config.
-    uint32_t max_seg = dev->regs->config.blk.seg_max;
-    if (max_seg == 0)
-        max_seg = bufsz;  // if not provided, treat entire I/O as one segment
-
-    // Compute number of data descriptors needed.
-    int num_data_desc = (bufsz + max_seg - 1) / max_seg;
-    int total_desc_needed = 1 + num_data_desc + 1; // header + data descriptors + status
-
-    // Collect free descriptor indices from the pool.
-    int chain[total_desc_needed];
-    int count = 0;
-    for (int i = 0; i < VIOBLK_DESC_COUNT && count < total_desc_needed; i++) {
-        if (dev->desc_free[i]) {
-            chain[count++] = i;
-        }
-    }
-    if (count < total_desc_needed) {
-        lock_release(&dev->lock);
-        return -EBUSY; // not enough free descriptors
-    }
-
-    // Use chain[0] as the request slot.
-    int slot = chain[0];
-    dev->requests[slot].in_use = 1;
-    dev->requests[slot].result = 0;
-    dev->requests[slot].status = 0xFF;
-
-    // Fill the request header for a read request.
-    dev->reqhdrs[slot].type = VIRTIO_BLK_T_IN;
-    dev->reqhdrs[slot].reserved = 0;
-    dev->reqhdrs[slot].sector = start_sector;
-
-    // Build the chain.
-    // Header descriptor (chain[0])
-    dev->desc_free[chain[0]] = 0;
-    dev->vq.desc[chain[0]].addr = (uint64_t)(uintptr_t)&dev->reqhdrs[slot];
-    dev->vq.desc[chain[0]].len = sizeof(struct virtio_blk_req);
-    if (total_desc_needed > 1) {
-        dev->vq.desc[chain[0]].flags = VIRTQ_DESC_F_NEXT;
-        dev->vq.desc[chain[0]].next = chain[1];
-    } else {
-        dev->vq.desc[chain[0]].flags = 0;
-        dev->vq.desc[chain[0]].next = 0;
-    }
-
-    // Data descriptors: break the data buffer into segments.
-    long remaining = bufsz;
-    char *data_ptr = (char *)buf;
-    for (int j = 1; j <= num_data_desc; j++) {
-        int idx = chain[j];
-        dev->desc_free[idx] = 0;
-        uint32_t seg_len = (remaining > max_seg) ? max_seg : remaining;
-        dev->vq.desc[idx].addr = (uint64_t)(uintptr_t)data_ptr;
-        dev->vq.desc[idx].len = seg_len;
-        // For read requests, device writes into the buffer.
-        if (j < num_data_desc) {
-            dev->vq.desc[idx].flags = VIRTQ_DESC_F_WRITE | VIRTQ_DESC_F_NEXT;
-            dev->vq.desc[idx].next = chain[j+1];
-        } else {
-            // Last data descriptor: chain to status descriptor.
-            dev->vq.desc[idx].flags = VIRTQ_DESC_F_WRITE | VIRTQ_DESC_F_NEXT;
-            dev->vq.desc[idx].next = chain[total_desc_needed - 1];
-        }
-        data_ptr += seg_len;
-        remaining -= seg_len;
-    }
 
-    // Status descriptor (last in chain)
-    int stat_idx = chain[total_desc_needed - 1];
-    dev->desc_free[stat_idx] = 0;
-    dev->vq.desc[stat_idx].addr = (uint64_t)(uintptr_t)&dev->status_bytes[slot];
-    dev->vq.desc[stat_idx].len = 1;
-    dev->vq.desc[stat_idx].flags = VIRTQ_DESC_F_WRITE; // End of chain.
-    dev->vq.desc[stat_idx].next = 0;
-
-    // Enqueue: Add the header descriptor (chain[0]) to the avail ring.
-    uint16_t avail_idx = dev->vq.avail.idx % VIOBLK_DESC_COUNT;
-    dev->vq.avail.ring[avail_idx] = chain[0];
-    dev->vq.avail.idx++;
-    __sync_synchronize();
-
-    // Notify device.
-    dev->regs->queue_notify = 0;
+    const struct iovec iov = { .base = (void *)buf, .len = len };
+    return vioblk_request(dev, VIRTIO_BLK_T_OUT, pos, &iov, 1);
+}
 
-    // Wait until the ISR marks this request complete.
-    while (dev->requests[slot].in_use) {
-        condition_wait(&dev->io_done);
-    }
+long vioblk_readvat (
+    struct io *io, unsigned long long pos,
+    const struct iovec *iov, int iovcnt)
+{
+    struct vioblk_device *dev =
+        (struct vioblk_device *)((char *)io - offsetof(struct vioblk_device, io));
+    if (!dev || !iov || iovcnt <= 0)
+        return -EINVAL;
 
-    long ret = dev->requests[slot].result;
-    ret -= 1;
-    lock_release(&dev->lock);
-    return ret;
+    return vioblk_request(dev, VIRTIO_BLK_T_IN, pos, iov, iovcnt);
 }
 
-long vioblk_writeat(struct io *io, unsigned long long pos, const void *buf, long len)
+long vioblk_writevat (
+    struct io *io, unsigned long long pos,
+    const struct iovec *iov, int iovcnt)
 {
     struct vioblk_device *dev =
         (struct vioblk_device *)((char *)io - offsetof(struct vioblk_device, io));
-    if (!dev || !buf || len <= 0)
+    if (!dev || !iov || iovcnt <= 0)
         return -EINVAL;
 
-    lock_acquire(&dev->lock);
+    return vioblk_request(dev, VIRTIO_BLK_T_OUT, pos, iov, iovcnt);
+}
 
-    if ((pos % dev->blk_size) != 0 || (len % dev->blk_size) != 0) {
-        lock_release(&dev->lock);
+// long vioblk_request(dev, type, pos, iov, iovcnt)
+//
+// Submits one read (VIRTIO_BLK_T_IN) or write (VIRTIO_BLK_T_OUT) request and
+// waits for it to complete. Each non-empty segment of _iov_ gets its own data
+// descriptor, so a scattered transfer is still a single device request. Only
+// the total length must be a multiple of the block size. The device lock is
+// held only while building and posting the descriptor chain, so several
+// threads can have requests in flight at once; a thread that finds too few
+// free descriptors waits for a completion to release some. Returns the number
+// of bytes transferred or -EIO if the device reports an error.
+
+long vioblk_request (
+    struct vioblk_device * dev, uint32_t type, unsigned long long pos,
+    const struct iovec * iov, int iovcnt)
+{
+    // header + data segments + status
+    int chain[VIOBLK_DESC_COUNT];
+    int total_desc_needed;
+    int nseg;
+    long len;
+    long rem;
+    int count;
+    int pie;
+
+    if (VIOBLK_DESC_COUNT - 2 < iovcnt)
         return -EINVAL;
-    }
 
-    if (pos > dev->capacity * dev->blk_size) {
-        lock_release(&dev->lock);
+    len = iov_length(iov, iovcnt);
+
+    if ((pos % dev->blk_size) != 0 || (len % dev->blk_size) != 0)
+        return -EINVAL;
+
+    if (pos > dev->capacity * dev->blk_size)
         return -EINVAL;
-    }
 
     uint64_t start_sector = pos / dev->blk_size;
     long total_blocks = len / dev->blk_size;
@@ -528,92 +487,107 @@ long vioblk_writeat(struct io *io, unsigned long long pos, const void *buf, long
         len = total_blocks * dev->blk_size;
     }
 
-    //uint32_t blk_sz = dev->blk_size;
-    uint32_t max_seg = dev->regs->config.blk.seg_max;
-    if (max_seg == 0)
-        max_seg = len;
+    if (len == 0)
+        return 0;
 
-    int num_data_desc = (len + max_seg - 1) / max_seg;
-    int total_desc_needed = 1 + num_data_desc + 1; // header + data descriptors + status
+    // Count the segments that carry data after truncation to _len_.
 
-    int chain[total_desc_needed];
-    int count = 0;
-    for (int i = 0; i < VIOBLK_DESC_COUNT && count < total_desc_needed; i++) {
-        if (dev->desc_free[i]) {
-            chain[count++] = i;
-        }
+    nseg = 0;
+    rem = len;
+    for (int i = 0; i < iovcnt && 0 < rem; i++) {
+        if (iov[i].len == 0)
+            continue;
+        rem -= (iov[i].len < rem) ? iov[i].len : rem;
+        nseg++;
     }
-    if (count < total_desc_needed) {
-        lock_release(&dev->lock);
-        return -EBUSY;
+
+    total_desc_needed = nseg + 2;
+
+    lock_acquire(&dev->lock);
+
+    // Collect free descriptor indices from the pool. Descriptors are released
+    // by the completion tasklet and by threads picking up their results, both
+    // of which broadcast io_done.
+
+    pie = disable_interrupts();
+    for (;;) {
+        count = 0;
+        for (int i = 0; i < VIOBLK_DESC_COUNT && count < total_desc_needed; i++) {
+            if (dev->desc_free[i])
+                chain[count++] = i;
+        }
+        if (count == total_desc_needed)
+            break;
+        condition_wait(&dev->io_done);
     }
+    restore_interrupts(pie);
 
+    // Use chain[0] as the request slot.
     int slot = chain[0];
     dev->requests[slot].in_use = 1;
     dev->requests[slot].result = 0;
     dev->requests[slot].status = 0xFF;
 
-    // Fill header for write.
-    dev->reqhdrs[slot].type = VIRTIO_BLK_T_OUT;
+    dev->reqhdrs[slot].type = type;
     dev->reqhdrs[slot].reserved = 0;
     dev->reqhdrs[slot].sector = start_sector;
 
-    // Build the chain.
-    // Header descriptor.
+    // Header descriptor
     dev->desc_free[chain[0]] = 0;
     dev->vq.desc[chain[0]].addr = (uint64_t)(uintptr_t)&dev->reqhdrs[slot];
     dev->vq.desc[chain[0]].len = sizeof(struct virtio_blk_req);
-    if (total_desc_needed > 1) {
-        dev->vq.desc[chain[0]].flags = VIRTQ_DESC_F_NEXT;
-        dev->vq.desc[chain[0]].next = chain[1];
-    } else {
-        dev->vq.desc[chain[0]].flags = 0;
-        dev->vq.desc[chain[0]].next = 0;
+    dev->vq.desc[chain[0]].flags = VIRTQ_DESC_F_NEXT;
+    dev->vq.desc[chain[0]].next = chain[1];
+
+    // Data descriptors, one per segment. We do not negotiate
+    // VIRTIO_BLK_F_SIZE_MAX, so the device accepts each segment whole. For a
+    // read, the device writes into the buffers.
+    rem = len;
+    count = 1;
+    for (int i = 0; i < iovcnt && 0 < rem; i++) {
+        if (iov[i].len == 0)
+            continue;
+        dev->desc_free[chain[count]] = 0;
+        dev->vq.desc[chain[count]].addr = (uint64_t)(uintptr_t)iov[i].base;
+        dev->vq.desc[chain[count]].len = (iov[i].len < rem) ? iov[i].len : rem;
+        dev->vq.desc[chain[count]].flags = VIRTQ_DESC_F_NEXT;
+        if (type == VIRTIO_BLK_T_IN)
+            dev->vq.desc[chain[count]].flags |= VIRTQ_DESC_F_WRITE;
+        dev->vq.desc[chain[count]].next = chain[count+1];
+        rem -= dev->vq.desc[chain[count]].len;
+        count++;
     }
 
-    // Data descriptors: For write, device reads from our buffer.
-    long remaining = len;
-    const char *data_ptr = (const char *)buf;
-    for (int j = 1; j <= num_data_desc; j++) {
-        int idx = chain[j];
-        dev->desc_free[idx] = 0;
-        uint32_t seg_len = (remaining > max_seg) ? max_seg : remaining;
-        dev->vq.desc[idx].addr = (uint64_t)(uintptr_t)data_ptr;
-        dev->vq.desc[idx].len = seg_len;
-        // For write, device reads; so do not set F_WRITE.
-        if (j < num_data_desc) {
-            dev->vq.desc[idx].flags = VIRTQ_DESC_F_NEXT;
-            dev->vq.desc[idx].next = chain[j+1];
-        } else {
-            dev->vq.desc[idx].flags = VIRTQ_DESC_F_NEXT;
-            dev->vq.desc[idx].next = chain[total_desc_needed - 1];
-        }
-        data_ptr += seg_len;
-        remaining -= seg_len;
-    }
-
-    // Status descriptor.
-    int stat_idx = chain[total_desc_needed - 1];
-    dev->desc_free[stat_idx] = 0;
-    dev->vq.desc[stat_idx].addr = (uint64_t)(uintptr_t)&dev->status_bytes[slot];
-    dev->vq.desc[stat_idx].len = 1;
-    dev->vq.desc[stat_idx].flags = VIRTQ_DESC_F_WRITE;
-    dev->vq.desc[stat_idx].next = 0;
+    // Status descriptor (last in chain)
+    dev->desc_free[chain[count]] = 0;
+    dev->vq.desc[chain[count]].addr = (uint64_t)(uintptr_t)&dev->status_bytes[slot];
+    dev->vq.desc[chain[count]].len = 1;
+    dev->vq.desc[chain[count]].flags = VIRTQ_DESC_F_WRITE; // End of chain.
+    dev->vq.desc[chain[count]].next = 0;
 
-    // Enqueue the request.
+    // Enqueue: Add the header descriptor (chain[0]) to the avail ring.
     uint16_t avail_idx = dev->vq.avail.idx % VIOBLK_DESC_COUNT;
     dev->vq.avail.ring[avail_idx] = chain[0];
+    __sync_synchronize();
     dev->vq.avail.idx++;
     __sync_synchronize();
 
+    // Notify device.
+    ktrace(KT_VIOBLK_SUBMIT, slot, pos);
     dev->regs->queue_notify = 0;
 
-    // Wait for the ISR to mark this request complete.
-    while (dev->requests[slot].in_use) {
+    lock_release(&dev->lock);
+
+    // Wait until the completion tasklet marks this request complete, then
+    // release the head descriptor.
+    pie = disable_interrupts();
+    while (dev->requests[slot].in_use)
         condition_wait(&dev->io_done);
-    }
 
-    long ret = dev->requests[slot].result;
-    lock_release(&dev->lock);
-    return ret;
-}
\ No newline at end of file
+    uint8_t status = dev->requests[slot].status;
+    dev->desc_free[slot] = 1;
+    condition_broadcast(&dev->io_done);
+    restore_interrupts(pie);
+
+    return (status == VIRTIO_BLK_S_OK) ? len : -EIO;
+}
@@ -10,6 +10,8 @@ int vioblk_open(struct io **ioptr, void *aux);
 void vioblk_close(struct io *io);
 long vioblk_readat(struct io *io, unsigned long long pos, void *buf, long bufsz);
 long vioblk_writeat(struct io *io, unsigned long long pos, const void *buf, long len);
+long vioblk_readvat(struct io *io, unsigned long long pos, const struct iovec *iov, int iovcnt);
+long vioblk_writevat(struct io *io, unsigned long long pos, const struct iovec *iov, int iovcnt);
 int vioblk_cntl(struct io *io, int cmd, void *arg);
 void vioblk_isr(int srcno, void *aux);
 
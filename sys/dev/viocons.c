@@ -0,0 +1,436 @@
+// viocons.c - VirtIO console device
+//
+// Copyright (c) 2024-2025 University of Illinois
+// SPDX-License-identifier: NCSA
+//
+
+#ifdef VIOCONS_TRACE
+#define TRACE
+#endif
+
+#ifdef VIOCONS_DEBUG
+#define DEBUG
+#endif
+
+#include "virtio.h"
+#include "intr.h"
+#include "io.h"
+#include "ioimpl.h"
+#include "device.h"
+#include "error.h"
+#include "string.h"
+#include "thread.h"
+#include "assert.h"
+#include "conf.h"
+#include "console.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+// COMPILE-TIME PARAMETERS
+//
+
+// VIOCONS_QLEN is the number of descriptors in each queue. Every descriptor
+// has its own buffer of VIOCONS_BUFSZ bytes, so up to VIOCONS_QLEN buffers can
+// be with the device in each direction at once.
+
+#ifndef VIOCONS_QLEN
+#define VIOCONS_QLEN 8
+#endif
+
+#ifndef VIOCONS_BUFSZ
+#define VIOCONS_BUFSZ 512
+#endif
+
+#ifndef VIOCONS_NAME
+#define VIOCONS_NAME "viocons"
+#endif
+
+// INTERNAL CONSTANT DEFINITIONS
+//
+
+// Without VIRTIO_CONSOLE_F_MULTIPORT, the device has a single port using the
+// first two queues.
+
+#define VIOCONS_RXQ 0 // receiveq(port0)
+#define VIOCONS_TXQ 1 // transmitq(port0)
+
+// INTERNAL TYPE DEFINITIONS
+//
+
+// Descriptor i always refers to buffer i of its queue, so a descriptor is
+// posted by putting its index in the avail ring and nothing is chained.
+
+struct viocons_vq {
+    uint16_t last_used_idx;
+
+    union {
+        struct virtq_avail avail;
+        char _avail_filler[VIRTQ_AVAIL_SIZE(VIOCONS_QLEN)];
+    };
+
+    union {
+        volatile struct virtq_used used;
+        char _used_filler[VIRTQ_USED_SIZE(VIOCONS_QLEN)];
+    };
+
+    struct virtq_desc desc[VIOCONS_QLEN];
+    char buf[VIOCONS_QLEN][VIOCONS_BUFSZ];
+};
+
+struct viocons_device {
+    volatile struct virtio_mmio_regs * regs;
+    int irqno;
+    int instno;
+
+    struct io io;
+
+    struct viocons_vq rxq;
+    struct viocons_vq txq;
+
+    // Receive buffers returned by the device, in the order the device filled
+    // them. The indices are free-running; rx_off is how much of the oldest
+    // buffer has already been read.
+
+    unsigned int rx_head;
+    unsigned int rx_tail;
+    unsigned int rx_off;
+    uint8_t rx_ready[VIOCONS_QLEN];
+    uint16_t rx_len[VIOCONS_QLEN];
+
+    // Transmit buffers not with the device
+
+    unsigned int tx_nfree;
+    uint8_t tx_free[VIOCONS_QLEN];
+
+    char console; // set once the kernel console goes through this device
+
+    struct condition rx_ready_cond;
+    struct condition tx_free_cond;
+    struct pollq pollq;
+};
+
+// INTERNAL FUNCTION DECLARATIONS
+//
+
+static int viocons_open(struct io ** ioptr, void * aux);
+static void viocons_close(struct io * io);
+static long viocons_read(struct io * io, void * buf, long bufsz);
+static long viocons_write(struct io * io, const void * buf, long len);
+static int viocons_poll(struct io * io, int events);
+static struct pollq * viocons_pollq(struct io * io);
+static void viocons_isr(int irqno, void * aux);
+
+static void viocons_console_kick(void);
+static void viocons_console_drain(struct viocons_device * dev);
+
+static void viocons_post (
+    struct viocons_device * dev, int qid, int idx, uint32_t len);
+
+// INTERNAL GLOBAL VARIABLES
+//
+
+static struct viocons_device global_viocons;
+
+// EXPORTED FUNCTION DEFINITIONS
+//
+
+// Attaches a VirtIO console device. Declared and called directly from
+// virtio.c. All receive buffers are handed to the device right away, and the
+// kernel console output is moved over to this device.
+
+void viocons_attach(volatile struct virtio_mmio_regs * regs, int irqno) {
+    static const struct iointf viocons_iointf = {
+        .close = &viocons_close,
+        .read = &viocons_read,
+        .write = &viocons_write,
+        .poll = &viocons_poll,
+        .pollq = &viocons_pollq
+    };
+
+    virtio_featset_t enabled_features, wanted_features, needed_features;
+    struct viocons_device * const dev = &global_viocons;
+    int result;
+    int i;
+
+    assert(regs->device_id == VIRTIO_ID_CONSOLE);
+
+    memset(dev, 0, sizeof(*dev));
+    dev->regs = regs;
+    dev->irqno = irqno;
+    condition_init(&dev->rx_ready_cond, "viocons_rx");
+    condition_init(&dev->tx_free_cond, "viocons_tx");
+
+    regs->status |= VIRTIO_STAT_DRIVER;
+    __sync_synchronize();
+
+    virtio_featset_init(needed_features);
+    virtio_featset_init(wanted_features);
+    result = virtio_negotiate_features(regs,
+        enabled_features, wanted_features, needed_features);
+
+    if (result != 0) {
+        kprintf("%p: virtio feature negotiation failed\n", regs);
+        return;
+    }
+
+    for (i = 0; i < VIOCONS_QLEN; i++) {
+        dev->rxq.desc[i].addr = (uint64_t)(uintptr_t)dev->rxq.buf[i];
+        dev->rxq.desc[i].len = VIOCONS_BUFSZ;
+        dev->rxq.desc[i].flags = VIRTQ_DESC_F_WRITE;
+        dev->txq.desc[i].addr = (uint64_t)(uintptr_t)dev->txq.buf[i];
+        dev->txq.desc[i].flags = 0;
+        dev->tx_free[dev->tx_nfree++] = i;
+    }
+
+    virtio_attach_virtq(regs, VIOCONS_RXQ, VIOCONS_QLEN,
+        (uint64_t)(uintptr_t)dev->rxq.desc,
+        (uint64_t)(uintptr_t)&dev->rxq.used,
+        (uint64_t)(uintptr_t)&dev->rxq.avail);
+
+    virtio_attach_virtq(regs, VIOCONS_TXQ, VIOCONS_QLEN,
+        (uint64_t)(uintptr_t)dev->txq.desc,
+        (uint64_t)(uintptr_t)&dev->txq.used,
+        (uint64_t)(uintptr_t)&dev->txq.avail);
+
+    virtio_enable_virtq(regs, VIOCONS_RXQ);
+    virtio_enable_virtq(regs, VIOCONS_TXQ);
+
+    enable_intr_source(irqno, VIOCONS_INTR_PRIO, &viocons_isr, dev);
+
+    ioinit0(&dev->io, &viocons_iointf);
+    dev->instno = register_device(VIOCONS_NAME, &viocons_open, dev);
+
+    regs->status |= VIRTIO_STAT_DRIVER_OK;
+    __sync_synchronize();
+
+    for (i = 0; i < VIOCONS_QLEN; i++)
+        viocons_post(dev, VIOCONS_RXQ, i, VIOCONS_BUFSZ);
+
+    // From here on, console output buffered in the log ring is sent in bulk
+    // through the transmit queue instead of character by character.
+
+    dev->console = 1;
+    console_set_kick(&viocons_console_kick);
+    viocons_console_kick();
+}
+
+// INTERNAL FUNCTION DEFINITIONS
+//
+
+int viocons_open(struct io ** ioptr, void * aux) {
+    struct viocons_device * const dev = aux;
+
+    *ioptr = ioaddref(&dev->io);
+    return 0;
+}
+
+// The device stays up after the last close because it also carries the kernel
+// console, so there is nothing to tear down.
+
+void viocons_close(struct io * io) {
+    trace("%s()", __func__);
+}
+
+// Returns whatever input has arrived, blocking only until there is some. Each
+// receive buffer goes back to the device as soon as it has been read out.
+
+long viocons_read(struct io * io, void * buf, long bufsz) {
+    struct viocons_device * const dev =
+        (void*)io - offsetof(struct viocons_device, io);
+    long cnt = 0;
+    long n;
+    int idx;
+    int pie;
+
+    if (bufsz <= 0)
+        return 0;
+
+    pie = disable_interrupts();
+
+    while (dev->rx_head == dev->rx_tail) {
+        if (io->nonblock) {
+            restore_interrupts(pie);
+            return -EAGAIN;
+        }
+        if (condition_wait_intr(&dev->rx_ready_cond) < 0) {
+            restore_interrupts(pie);
+            return -EINTR;
+        }
+    }
+
+    while (cnt < bufsz && dev->rx_head != dev->rx_tail) {
+        idx = dev->rx_ready[dev->rx_head % VIOCONS_QLEN];
+        n = dev->rx_len[idx] - dev->rx_off;
+        if (bufsz - cnt < n)
+            n = bufsz - cnt;
+
+        memcpy(buf + cnt, dev->rxq.buf[idx] + dev->rx_off, n);
+        dev->rx_off += n;
+        cnt += n;
+
+        if (dev->rx_off == dev->rx_len[idx]) {
+            dev->rx_head += 1;
+            dev->rx_off = 0;
+            viocons_post(dev, VIOCONS_RXQ, idx, VIOCONS_BUFSZ);
+        }
+    }
+
+    restore_interrupts(pie);
+    return cnt;
+}
+
+// Copies the data into as many transmit buffers as it needs, posting each one
+// as soon as it is filled, and waits only when all of them are with the
+// device. In non-blocking mode, returns what fit or -EAGAIN if nothing did.
+
+long viocons_write(struct io * io, const void * buf, long len) {
+    struct viocons_device * const dev =
+        (void*)io - offsetof(struct viocons_device, io);
+    long cnt = 0;
+    long n;
+    int idx;
+    int pie;
+
+    pie = disable_interrupts();
+
+    while (cnt < len) {
+        while (dev->tx_nfree == 0) {
+            if (io->nonblock) {
+                restore_interrupts(pie);
+                return (cnt != 0) ? cnt : -EAGAIN;
+            }
+            condition_wait(&dev->tx_free_cond);
+        }
+
+        idx = dev->tx_free[--dev->tx_nfree];
+        n = len - cnt;
+        if (VIOCONS_BUFSZ < n)
+            n = VIOCONS_BUFSZ;
+
+        memcpy(dev->txq.buf[idx], buf + cnt, n);
+        viocons_post(dev, VIOCONS_TXQ, idx, n);
+        cnt += n;
+    }
+
+    restore_interrupts(pie);
+    return cnt;
+}
+
+int viocons_poll(struct io * io, int events) {
+    struct viocons_device * const dev =
+        (void*)io - offsetof(struct viocons_device, io);
+    int revents = 0;
+
+    if (dev->rx_head != dev->rx_tail)
+        revents |= POLLIN;
+    if (dev->tx_nfree != 0)
+        revents |= POLLOUT;
+
+    return revents;
+}
+
+struct pollq * viocons_pollq(struct io * io) {
+    struct viocons_device * const dev =
+        (void*)io - offsetof(struct viocons_device, io);
+
+    return &dev->pollq;
+}
+
+// Collects the buffers the device has finished with. Filled receive buffers
+// are queued for viocons_read; sent transmit buffers are freed and, if the
+// kernel console uses the device, immediately refilled from the log ring.
+
+void viocons_isr(int irqno, void * aux) {
+    struct viocons_device * const dev = aux;
+    struct viocons_vq * vq;
+    volatile struct virtq_used_elem * elem;
+    uint16_t used_idx;
+    int moved = 0;
+    int idx;
+
+    dev->regs->interrupt_ack = dev->regs->interrupt_status;
+    __sync_synchronize();
+
+    vq = &dev->rxq;
+    used_idx = vq->used.idx;
+    while (vq->last_used_idx != used_idx) {
+        elem = &vq->used.ring[vq->last_used_idx++ % VIOCONS_QLEN];
+        idx = elem->id;
+        dev->rx_len[idx] = elem->len;
+
+        // An empty buffer carries nothing; give it straight back.
+
+        if (dev->rx_len[idx] == 0)
+            viocons_post(dev, VIOCONS_RXQ, idx, VIOCONS_BUFSZ);
+        else
+            dev->rx_ready[dev->rx_tail++ % VIOCONS_QLEN] = idx;
+        moved = 1;
+    }
+
+    vq = &dev->txq;
+    used_idx = vq->used.idx;
+    while (vq->last_used_idx != used_idx) {
+        idx = vq->used.ring[vq->last_used_idx++ % VIOCONS_QLEN].id;
+        dev->tx_free[dev->tx_nfree++] = idx;
+        moved = 1;
+    }
+
+    if (dev->console)
+        viocons_console_drain(dev);
+
+    if (moved) {
+        condition_broadcast(&dev->rx_ready_cond);
+        condition_broadcast(&dev->tx_free_cond);
+        pollq_wakeup(&dev->pollq);
+    }
+}
+
+// Called at the end of every kputc, kputs and kprintf. Only sends when the
+// transmit queue is idle, so that output printed while a buffer is in flight
+// goes out together once it completes, rather than a few characters per
+// buffer.
+
+void viocons_console_kick(void) {
+    struct viocons_device * const dev = &global_viocons;
+    int pie;
+
+    pie = disable_interrupts();
+    if (dev->tx_nfree == VIOCONS_QLEN)
+        viocons_console_drain(dev);
+    restore_interrupts(pie);
+}
+
+// Moves as much of the log ring as fits into free transmit buffers. Called
+// with interrupts disabled.
+
+void viocons_console_drain(struct viocons_device * dev) {
+    long n;
+    int idx;
+
+    while (dev->tx_nfree != 0) {
+        idx = dev->tx_free[dev->tx_nfree - 1];
+        n = console_log_take(dev->txq.buf[idx], VIOCONS_BUFSZ);
+        if (n == 0)
+            break;
+        dev->tx_nfree -= 1;
+        viocons_post(dev, VIOCONS_TXQ, idx, n);
+    }
+}
+
+// Hands descriptor _idx_ of queue _qid_ to the device with _len_ bytes of
+// buffer. Called with interrupts disabled.
+
+void viocons_post (
+    struct viocons_device * dev, int qid, int idx, uint32_t len)
+{
+    struct viocons_vq * const vq =
+        (qid == VIOCONS_RXQ) ? &dev->rxq : &dev->txq;
+
+    vq->desc[idx].len = len;
+    vq->avail.ring[vq->avail.idx % VIOCONS_QLEN] = idx;
+    __sync_synchronize();
+    vq->avail.idx += 1;
+    __sync_synchronize();
+    virtio_notify_avail(dev->regs, qid);
+}
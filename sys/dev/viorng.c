@@ -16,6 +16,7 @@
 #include "intr.h"
 #include "console.h"
 #include "thread.h"
+#include "work.h"
 
 // INTERNAL CONSTANT DEFINITIONS
 //
@@ -64,8 +65,14 @@ struct viorng_device {
     // between buf+0 and buf+bufcnt. (We read from the end of the buffer.)
 
     unsigned int bufcnt;
+    char pending; // set while a fill request is with the device
     char buf[VIORNG_BUFSZ];
     struct condition rd_data; 
+    struct pollq pollq;
+
+    // The used ring is processed and readers woken in this tasklet, not in
+    // the ISR.
+    struct tasklet done_tasklet;
 };
 
 // INTERNAL FUNCTION DECLARATIONS
@@ -74,13 +81,19 @@ struct viorng_device {
 static int viorng_open(struct io ** ioptr, void * aux);
 static void viorng_close(struct io * io);
 static long viorng_read(struct io * io, void * buf, long bufsz);
+static int viorng_poll(struct io * io, int events);
+static struct pollq * viorng_pollq(struct io * io);
+static void viorng_request(struct viorng_device * viorng);
 static void viorng_isr(int irqno, void * aux);
+static void viorng_complete(void * aux);
 
 // EXPORTED FUNCTION DEFINITIONS
 //
 static const struct iointf viorng_iointf = {
     .read = viorng_read,
-    .close = viorng_close
+    .close = viorng_close,
+    .poll = viorng_poll,
+    .pollq = viorng_pollq
 };
 // Attaches a VirtIO rng device. Declared and called directly from virtio.c.
 ////////////////////////////////////////////////////////////////////////////////////////
@@ -115,6 +128,7 @@ void viorng_attach(volatile struct virtio_mmio_regs * regs, int irqno) {
     viorng->irqno = irqno;
     viorng->bufcnt = 0;
     viorng->vq.last_used_idx = 0;
+    tasklet_init(&viorng->done_tasklet, &viorng_complete, viorng);
     
     // Signal device that we found a driver
     regs->status |= VIRTIO_STAT_DRIVER;
@@ -222,29 +236,70 @@ long viorng_read(struct io *io, void *buf, long bufsz) {
     if (!viorng || !buf || bufsz <= 0) return -EINVAL; // invalid args chk
     // if no data, req new rnd bytes
     
-    if (viorng->bufcnt == 0) {//descriptor table
-        viorng->vq.desc[0].addr = (uint64_t)(uintptr_t)viorng->buf;
-        viorng->vq.desc[0].len = VIORNG_BUFSZ;
-        viorng->vq.desc[0].flags = VIRTQ_DESC_F_WRITE;
-        viorng->vq.desc[0].next = 0;
-
-        
-        viorng->vq.avail.ring[viorng->vq.avail.idx % 1] = 0; // add desc to avail ring
-        viorng->vq.avail.idx++;
-
-        __sync_synchronize(); // mem sync before notifying dev
-        viorng->regs->queue_notify = 0; // tell dev to fill buf
-    }
     int pie = disable_interrupts();
+    if (viorng->bufcnt == 0)
+        viorng_request(viorng);
+    if (viorng->bufcnt == 0 && io->nonblock) { // fill started, come back later
+        restore_interrupts(pie);
+        return -EAGAIN;
+    }
     while (viorng->bufcnt == 0) condition_wait(&viorng->rd_data); // wait till dev writes new data
     restore_interrupts(pie);
     long rdbytes = (bufsz < viorng->bufcnt) ? bufsz : viorng->bufcnt; // decide how much to copy
     memcpy(buf, viorng->buf, rdbytes); // copy from dev buf
     viorng->bufcnt -= rdbytes; // reduce avail bytes
 
-    if (viorng->bufcnt > 0) memcpy(viorng->buf, viorng->buf + rdbytes, viorng->bufcnt); // shift remaining bytes only if needed
+    // Shift the remaining bytes down. The ranges overlap, so this is a byte
+    // loop rather than memcpy.
+
+    for (unsigned int i = 0; i < viorng->bufcnt; i++)
+        viorng->buf[i] = viorng->buf[rdbytes + i];
     return rdbytes; // return num bytes read
 }
+
+// Reports POLLIN when buffered bytes are available. Otherwise starts a fill so
+// that the poller is woken when the device completes it.
+
+int viorng_poll(struct io * io, int events) {
+    struct viorng_device * const viorng =
+        (void*)io - offsetof(struct viorng_device, io);
+
+    if (0 < viorng->bufcnt)
+        return POLLIN;
+
+    if (events & POLLIN)
+        viorng_request(viorng);
+
+    return 0;
+}
+
+struct pollq * viorng_pollq(struct io * io) {
+    struct viorng_device * const viorng =
+        (void*)io - offsetof(struct viorng_device, io);
+
+    return &viorng->pollq;
+}
+
+// Hands the buffer to the device to be filled, unless a request is already
+// outstanding. Called with interrupts disabled.
+
+void viorng_request(struct viorng_device * viorng) {
+    if (viorng->pending)
+        return;
+
+    viorng->vq.desc[0].addr = (uint64_t)(uintptr_t)viorng->buf;
+    viorng->vq.desc[0].len = VIORNG_BUFSZ;
+    viorng->vq.desc[0].flags = VIRTQ_DESC_F_WRITE;
+    viorng->vq.desc[0].next = 0;
+
+    viorng->vq.avail.ring[viorng->vq.avail.idx % 1] = 0; // add desc to avail ring
+    viorng->vq.avail.idx++;
+    viorng->pending = 1;
+
+    __sync_synchronize(); // mem sync before notifying dev
+    viorng->regs->queue_notify = 0; // tell dev to fill buf
+}
+
 ////////////////////////////////////////////////////////////////////////////////////
 // void viorng_isr(int irqno, void *aux)  
 // Inputs: int irqno - interrupt number for the VirtIO RNG device  
@@ -253,22 +308,42 @@ long viorng_read(struct io *io, void *buf, long bufsz) {
 // Desc:  
 // handles VirtIO RNG device interrupts when new random data is available
 // first, checks if the device pointer viorng is valid
-// reads the intrpt status register to verify the interrupt source
-// retrieves the amount of data written to the buffer bufcnt  
-// updates the `last_used_idx` to mv to the next completed descriptor 
-// signals any thrd waiting on `rd_data` that new data is available (MP3)
 // acknowledges the interpt by writing back to the status register
-// Side Effects: Wakes up waiting threads, modifies buffer tracking, clears interrupt flag 
+// leaves the used ring and the wakeups to viorng_complete, a tasklet that runs
+// once the PLIC source is completed
+// Side Effects: clears interrupt flag, schedules the completion tasklet
 ////////////////////////////////////////////////////////////////////////////////////
 void viorng_isr(int irqno, void *aux) {
     struct viorng_device *viorng = (struct viorng_device *)aux;
     if (!viorng) return; // chck if dev valid
     trace("viorng_isr - intrpt fire chck St=%x", viorng->regs->interrupt_status);
-    uint16_t used_pos = viorng->vq.last_used_idx % 1; // get entry pos
+    viorng->regs->interrupt_ack = viorng->regs->interrupt_status; //clear intrpt
+    __sync_synchronize();
+    tasklet_schedule(&viorng->done_tasklet);
+}
+
+// Takes the filled buffer from the used ring and wakes up readers and pollers.
+
+void viorng_complete(void * aux) {
+    struct viorng_device * const viorng = aux;
+    uint16_t used_pos;
+    int pie;
+
+    pie = disable_interrupts();
+
+    if (viorng->vq.used.idx == viorng->vq.last_used_idx) {
+        restore_interrupts(pie);
+        return;
+    }
+
+    used_pos = viorng->vq.last_used_idx % 1; // get entry pos
     viorng->bufcnt = viorng->vq.used.ring[used_pos].len; // update buf size
-    
-    trace("viorng_isr - bufcnt=%u", viorng->bufcnt);
-    viorng->vq.last_used_idx++;// move to next used desc
+    trace("viorng_complete - bufcnt=%u", viorng->bufcnt);
+    viorng->vq.last_used_idx++; // move to next used desc
+    viorng->pending = 0;
+
+    restore_interrupts(pie);
+
     condition_broadcast(&viorng->rd_data); //mp3
-    viorng->regs->interrupt_ack = viorng->regs->interrupt_status; //clear intrpt
+    pollq_wakeup(&viorng->pollq);
 }
\ No newline at end of file
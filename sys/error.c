@@ -25,7 +25,9 @@ extern const char * error_name(int code) {
         [ECHILD] = "ECHILD",
         [ENOMEM] = "ENOMEM",
         [ENODATABLKS] = "ENODATABLKS",
-        [ENOINODEBLKS] = "ENOINODEBLKS"
+        [ENOINODEBLKS] = "ENOINODEBLKS",
+        [EAGAIN] = "EAGAIN",
+        [EINTR] = "EINTR"
     };
 
     const char * name;
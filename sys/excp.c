@@ -14,6 +14,10 @@
 #include "string.h"
 #include "process.h"
 
+#ifdef RVV
+#include "vec.h"
+#endif
+
 #include <stddef.h>
 
 // EXPORTED FUNCTION DECLARATIONS
@@ -56,6 +60,12 @@ void handle_smode_exception(unsigned int cause, struct trap_frame * tfr) {
     const char * name = NULL;
     char msgbuf[80];
 
+    // The kernel writes to user buffers directly, so a system call can store
+    // to a copy-on-write user page. Resolve it the same way as a user write.
+
+    if (cause == RISCV_SCAUSE_STORE_PAGE_FAULT && cow_fault(csrr_stval()))
+        return;
+
     if (0 <= cause && cause < sizeof(excp_names)/sizeof(excp_names[0]))
 		name = excp_names[cause];
 	
@@ -108,15 +118,11 @@ void handle_umode_exception(unsigned int cause, struct trap_frame * tfr) {
                 name, (void*)tfr->sepc, (void*)csrr_stval());
             break;
 
+        // System calls normally take the fast path in trap.s and never get
+        // here. Handle one anyway in case the fast path is bypassed.
+
         case RISCV_SCAUSE_ECALL_FROM_UMODE:
-            snprintf(msgbuf, sizeof(msgbuf),
-                "%s at %p in U mode",
-                name, (void*)tfr->sepc);
             handle_syscall(tfr);
-            if(tfr->a0 < 0){
-                process_exit();
-                return;
-            }
             return;
 
         //page fault -- virt memory stuff
@@ -138,6 +144,16 @@ void handle_umode_exception(unsigned int cause, struct trap_frame * tfr) {
                 return;
             }
 
+#ifdef RVV
+        // The first vector instruction of a thread traps because its
+        // sstatus.VS is off; vec_fault turns the unit on for it.
+
+        case RISCV_SCAUSE_ILLEGAL_INSTR:
+            if (vec_fault(tfr))
+                return;
+            // nobreak
+#endif
+
         default:
             snprintf(msgbuf, sizeof(msgbuf),
                 "%s at %p in U mode",
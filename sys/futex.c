@@ -0,0 +1,165 @@
+// futex.c - Fast user-space mutex support
+//
+// Copyright (c) 2024-2025 University of Illinois
+// SPDX-License-identifier: NCSA
+//
+
+#ifdef FUTEX_TRACE
+#define TRACE
+#endif
+
+#ifdef FUTEX_DEBUG
+#define DEBUG
+#endif
+
+#include "futex.h"
+#include "conf.h"
+#include "thread.h"
+#include "memory.h"
+#include "intr.h"
+#include "error.h"
+#include "console.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+// INTERNAL TYPE DEFINITIONS
+//
+
+// A futex in private memory is identified by its memory space and virtual
+// address, since copy-on-write can move the page under it (a waker's store
+// after fork copies the page that the waiter only read). A futex in a shared
+// segment is identified by its physical address, with mtag 0, so that every
+// process that maps the segment finds the same entry. An unused key has addr 0.
+
+struct futex_key {
+    mtag_t mtag;
+    uintptr_t addr;
+};
+
+// One entry per futex that has waiters. An entry is free when its waiter count
+// drops to zero. Every waiter is a distinct thread, so NTHR entries are enough
+// as long as waiters always come back to drop their count; the waiters of an
+// exiting process are woken for this (see process_exit).
+
+struct futex {
+    struct futex_key key;
+    int nwait;
+    struct condition cv;
+};
+
+// INTERNAL GLOBAL VARIABLE DEFINITIONS
+//
+
+static struct futex futex_table[NTHR];
+
+// INTERNAL FUNCTION DECLARATIONS
+//
+
+static int futex_key(int * uaddr, struct futex_key * key);
+static struct futex * futex_lookup(const struct futex_key * key, int alloc);
+
+// EXPORTED FUNCTION DEFINITIONS
+//
+
+int futex_wait(int * uaddr, int val) {
+    struct futex_key key;
+    struct futex * fx;
+    int result;
+    int pie;
+
+    if (futex_key(uaddr, &key) < 0)
+        return -EINVAL;
+
+    // The value check and the enqueue must be atomic with respect to a waker,
+    // which can only run once we give up the CPU in condition_wait.
+
+    pie = disable_interrupts();
+
+    if (*uaddr != val) {
+        restore_interrupts(pie);
+        return 0;
+    }
+
+    fx = futex_lookup(&key, 1);
+    if (fx == NULL) {
+        restore_interrupts(pie);
+        return -ENOMEM;
+    }
+
+    fx->nwait += 1;
+
+    trace("%s: %p (key %p) waiters=%d", __func__, uaddr, (void*)key.addr, fx->nwait);
+    result = condition_wait_intr(&fx->cv);
+
+    fx->nwait -= 1;
+    if (fx->nwait == 0)
+        fx->key.addr = 0;
+
+    restore_interrupts(pie);
+    return result;
+}
+
+int futex_wake(int * uaddr, int cnt) {
+    struct futex_key key;
+    struct futex * fx;
+    int nwoken = 0;
+    int pie;
+
+    if (futex_key(uaddr, &key) < 0)
+        return -EINVAL;
+
+    pie = disable_interrupts();
+    fx = futex_lookup(&key, 0);
+
+    if (fx != NULL) {
+        while (nwoken < cnt && condition_signal(&fx->cv))
+            nwoken += 1;
+    }
+
+    restore_interrupts(pie);
+    trace("%s: %p woke %d", __func__, uaddr, nwoken);
+    return nwoken;
+}
+
+// INTERNAL FUNCTION DEFINITIONS
+//
+
+int futex_key(int * uaddr, struct futex_key * key) {
+    if ((uintptr_t)uaddr & (sizeof(int) - 1))
+        return -EINVAL;
+
+    if (vma_to_pma((uintptr_t)uaddr) == 0)
+        return -EINVAL;
+
+    if (vma_is_shared((uintptr_t)uaddr)) {
+        key->mtag = 0;
+        key->addr = vma_to_pma((uintptr_t)uaddr);
+    } else {
+        key->mtag = active_mspace();
+        key->addr = (uintptr_t)uaddr;
+    }
+
+    return 0;
+}
+
+struct futex * futex_lookup(const struct futex_key * key, int alloc) {
+    struct futex * avail = NULL;
+    int i;
+
+    for (i = 0; i < NTHR; i++) {
+        if (futex_table[i].key.addr == key->addr &&
+            futex_table[i].key.mtag == key->mtag)
+            return &futex_table[i];
+        if (avail == NULL && futex_table[i].key.addr == 0)
+            avail = &futex_table[i];
+    }
+
+    if (!alloc || avail == NULL)
+        return NULL;
+
+    avail->key = *key;
+    avail->nwait = 0;
+    condition_init(&avail->cv, "futex");
+    return avail;
+}
@@ -0,0 +1,33 @@
+// futex.h - Fast user-space mutex support
+//
+// Copyright (c) 2024-2025 University of Illinois
+// SPDX-License-identifier: NCSA
+//
+
+#ifndef _FUTEX_H_
+#define _FUTEX_H_
+
+// Operations for the _futex_ system call
+
+#define FUTEX_WAIT  0   // sleep if *uaddr == val
+#define FUTEX_WAKE  1   // wake up to val waiters
+
+// EXPORTED FUNCTION DECLARATIONS
+//
+
+// Puts the calling thread to sleep if the int at _uaddr_ still holds _val_.
+// Returns 0 when woken up or immediately if the value has already changed; the
+// caller is expected to re-check its condition either way. Waiters on private
+// memory are keyed by memory space and virtual address, so that copy-on-write
+// after fork does not separate them from their wakers. Waiters on a shared
+// segment are keyed by physical address, so threads that map the segment at
+// different virtual addresses share a wait queue.
+
+extern int futex_wait(int * uaddr, int val);
+
+// Wakes up to _cnt_ threads waiting on _uaddr_, oldest first. Returns the number
+// of threads woken.
+
+extern int futex_wake(int * uaddr, int cnt);
+
+#endif // _FUTEX_H_
@@ -19,6 +19,8 @@
 #include "plic.h"
 #include "timer.h"
 #include "thread.h"
+#include "work.h"
+#include "process.h"
 
 #include <stddef.h>
 
@@ -83,8 +85,17 @@ void handle_smode_interrupt(unsigned int cause) {
 }
 
 void handle_umode_interrupt(unsigned int cause) {
+    struct process * proc;
+
     handle_interrupt(cause);
     thread_yield();
+
+    // Another thread of this process may have called process_exit while we
+    // were in U mode.
+
+    proc = current_process();
+    if (proc != NULL && proc->exiting)
+        process_thread_exit();
 }
 
 
@@ -103,6 +114,11 @@ void handle_interrupt(unsigned int cause) {
         panic(NULL);
         break;
     }
+
+    // Bottom halves scheduled by the ISR run now, after the source has been
+    // completed at the PLIC, with interrupts enabled.
+
+    run_tasklets();
 }
 
 void handle_extern_interrupt(void) {
@@ -117,7 +133,13 @@ void handle_extern_interrupt(void) {
     if (isrtab[srcno].isr == NULL)
         panic(NULL);
     
+    // The PLIC threshold now masks this source and anything at or below its
+    // priority, so let higher-priority sources preempt the ISR. The trap entry
+    // code has already saved sepc and sstatus.
+
+    enable_interrupts();
     isrtab[srcno].isr(srcno, isrtab[srcno].isr_aux);
+    disable_interrupts();
 
     plic_finish_interrupt(srcno);
 }
@@ -12,6 +12,8 @@
 #include "error.h"
 #include "thread.h"
 #include "memory.h"
+#include "timer.h"
+#include "intr.h"
 
 #include <stddef.h>
 #include <limits.h>
@@ -26,12 +28,43 @@ struct memio {
 
 #define PIPE_BUFSZ PAGE_SIZE
 
+// The pipe ring uses free-running indices: head - tail is the number of bytes
+// in the buffer and the byte for index i is at buf[i % PIPE_BUFSZ], so all
+// PIPE_BUFSZ bytes are usable. Readers wait on _readable_ only when the pipe
+// is empty, so writers signal it only when they make an empty pipe non-empty.
+// Writers wait on _writable_ for a specific amount of free space (all of it
+// for an atomic write); _wr_need_ is the smallest amount any waiting writer
+// needs, and readers signal only once that much is free.
+
+//
+// Large page-aligned writes skip the ring: the writer's pages are shared
+// copy-on-write and queued in _pages_, and a reader with a page-aligned buffer
+// gets them mapped into its own space (see pipe_write_pages and
+// pipe_read_pages). The ring and the page queue are never both non-empty,
+// which keeps the data in order. _wr_page_ is set by a writer waiting for a
+// free page slot.
+
+#ifndef PIPE_NPAGES
+#define PIPE_NPAGES 16
+#endif
+
+#ifndef PIPE_FLIP_MIN
+#define PIPE_FLIP_MIN (2 * PAGE_SIZE)
+#endif
+
 struct pipe {
     char *buf;
-    int head, tail;
+    unsigned int head, tail;
+    unsigned int wr_need; // 0 if no writer is waiting
+    void *pages[PIPE_NPAGES];
+    unsigned int pg_head, pg_tail;
+    unsigned int pg_off; // bytes already read from the front page
+    char wr_page;
     int closed_read, closed_write;
     struct condition readable;
     struct condition writable;
+    struct pollq rpollq; // threads polling the read end
+    struct pollq wpollq; // threads polling the write end
 };
 
 struct pipe_io {
@@ -73,10 +106,64 @@ static long seekio_readat (
 static long seekio_writeat (
     struct io * io, unsigned long long pos, const void * buf, long len);
 
+static long seekio_readv(struct io * io, const struct iovec * iov, int iovcnt);
+
+static long seekio_writev(struct io * io, const struct iovec * iov, int iovcnt);
+
+static long seekio_readvat (
+    struct io * io, unsigned long long pos,
+    const struct iovec * iov, int iovcnt);
+
+static long seekio_writevat (
+    struct io * io, unsigned long long pos,
+    const struct iovec * iov, int iovcnt);
+
+static long seekio_splice (
+    struct io * io, unsigned long long pos, struct io * out, long len);
+
+static long splice_bounce (
+    struct io * in, const unsigned long long * pos, struct io * out, long len);
+
+static int seekio_poll(struct io * io, int events);
+static struct pollq * seekio_pollq(struct io * io);
+
+static int iov_trim (
+    struct iovec * dst, const struct iovec * src, int iovcnt, size_t len);
+
 static void pipe_close(struct io *io);
 static long pipe_write(struct io *io, const void *buf, long len);
 static long pipe_read(struct io *io, void *buf, long len);
+static long pipe_writev(struct io *io, const struct iovec *iov, int iovcnt);
+static long pipe_readv(struct io *io, const struct iovec *iov, int iovcnt);
 static int pipe_cntl(struct io *io, int cmd, void *arg);
+static int pipe_poll(struct io *io, int events);
+static struct pollq * pipe_pollq(struct io *io);
+static long pipe_write_pages(struct pipe *p, const char *buf, size_t len);
+static long pipe_read_pages (
+    struct pipe *p, const struct iovec *iov, int iovcnt, size_t len);
+static void pipe_wake_writers(struct pipe *p);
+static uintptr_t iov_span (
+    const struct iovec *iov, int iovcnt, size_t off, size_t n);
+
+// COMPILE-TIME PARAMETERS
+//
+
+// SPLICE_BUFSZ is the size of the bounce buffer used to splice from an
+// endpoint that has no splice operation of its own.
+
+#ifndef SPLICE_BUFSZ
+#define SPLICE_BUFSZ 512
+#endif
+
+// While a thread waits in iopoll, it has an entry on the poll queue of each
+// endpoint it watches. The entries point to its alarm's condition, which is
+// broadcast either by the alarm (timeout) or by pollq_wakeup.
+
+struct pollent {
+    struct pollent * next;
+    struct pollq * pq;
+    struct condition * cond;
+};
 
 // INTERNAL GLOBAL CONSTANTS
 static const struct iointf seekio_iointf = {
@@ -85,7 +172,14 @@ static const struct iointf seekio_iointf = {
     .read = &seekio_read,
     .write = &seekio_write,
     .readat = &seekio_readat,
-    .writeat = &seekio_writeat
+    .writeat = &seekio_writeat,
+    .readv = &seekio_readv,
+    .writev = &seekio_writev,
+    .readvat = &seekio_readvat,
+    .writevat = &seekio_writevat,
+    .splice = &seekio_splice,
+    .poll = &seekio_poll,
+    .pollq = &seekio_pollq
 };
 
 // EXPORTED FUNCTION DEFINITIONS
@@ -93,13 +187,19 @@ static const struct iointf seekio_iointf = {
 static const struct iointf pipe_writer_intf = {
     .close = pipe_close,
     .write = pipe_write,
-    .cntl = pipe_cntl
+    .writev = pipe_writev,
+    .cntl = pipe_cntl,
+    .poll = pipe_poll,
+    .pollq = pipe_pollq
 };
 
 static const struct iointf pipe_reader_intf = {
     .close = pipe_close,
     .read = pipe_read,
-    .cntl = pipe_cntl
+    .readv = pipe_readv,
+    .cntl = pipe_cntl,
+    .poll = pipe_poll,
+    .pollq = pipe_pollq
 };
 
 void create_pipe(struct io **wioptr, struct io **rioptr) {
@@ -130,6 +230,7 @@ struct io * ioinit0(struct io * io, const struct iointf * intf) {
     assert (intf != NULL);
     io->intf = intf;
     io->refcnt = 0;
+    io->nonblock = 0;
     return io;
 }
 
@@ -138,6 +239,7 @@ struct io * ioinit1(struct io * io, const struct iointf * intf) {
     assert (io != NULL);
     io->intf = intf;
     io->refcnt = 1;
+    io->nonblock = 0;
     return io;
 }
 
@@ -256,10 +358,362 @@ long iowriteat (
     return io->intf->writeat(io, pos, buf, len);
 }
 
+long ioreadv(struct io * io, const struct iovec * iov, int iovcnt) {
+    long total = 0;
+    long n;
+    int i;
+
+    assert (io != NULL);
+    assert (io->intf != NULL);
+
+    if (iovcnt < 0)
+        return -EINVAL;
+
+    if (io->intf->readv != NULL)
+        return io->intf->readv(io, iov, iovcnt);
+
+    if (io->intf->read == NULL)
+        return -ENOTSUP;
+
+    for (i = 0; i < iovcnt; i++) {
+        n = io->intf->read(io, iov[i].base, iov[i].len);
+
+        if (n < 0)
+            return (total > 0) ? total : n;
+
+        total += n;
+
+        if (n < iov[i].len)
+            break;
+    }
+
+    return total;
+}
+
+long iowritev(struct io * io, const struct iovec * iov, int iovcnt) {
+    long total = 0;
+    long n;
+    int i;
+
+    assert (io != NULL);
+    assert (io->intf != NULL);
+
+    if (iovcnt < 0)
+        return -EINVAL;
+
+    if (io->intf->writev != NULL)
+        return io->intf->writev(io, iov, iovcnt);
+
+    for (i = 0; i < iovcnt; i++) {
+        n = iowrite(io, iov[i].base, iov[i].len);
+
+        if (n < 0)
+            return (total > 0) ? total : n;
+
+        total += n;
+
+        if (n < iov[i].len)
+            break;
+    }
+
+    return total;
+}
+
+long ioreadvat (
+    struct io * io, unsigned long long pos,
+    const struct iovec * iov, int iovcnt)
+{
+    long total = 0;
+    long n;
+    int i;
+
+    assert (io != NULL);
+    assert (io->intf != NULL);
+
+    if (iovcnt < 0)
+        return -EINVAL;
+
+    if (io->intf->readvat != NULL)
+        return io->intf->readvat(io, pos, iov, iovcnt);
+
+    if (io->intf->readat == NULL)
+        return -ENOTSUP;
+
+    for (i = 0; i < iovcnt; i++) {
+        n = io->intf->readat(io, pos + total, iov[i].base, iov[i].len);
+
+        if (n < 0)
+            return (total > 0) ? total : n;
+
+        total += n;
+
+        if (n < iov[i].len)
+            break;
+    }
+
+    return total;
+}
+
+long iowritevat (
+    struct io * io, unsigned long long pos,
+    const struct iovec * iov, int iovcnt)
+{
+    long total = 0;
+    long n;
+    int i;
+
+    assert (io != NULL);
+    assert (io->intf != NULL);
+
+    if (iovcnt < 0)
+        return -EINVAL;
+
+    if (io->intf->writevat != NULL)
+        return io->intf->writevat(io, pos, iov, iovcnt);
+
+    if (io->intf->writeat == NULL)
+        return -ENOTSUP;
+
+    for (i = 0; i < iovcnt; i++) {
+        n = io->intf->writeat(io, pos + total, iov[i].base, iov[i].len);
+
+        if (n < 0)
+            return (total > 0) ? total : n;
+
+        total += n;
+
+        if (n < iov[i].len)
+            break;
+    }
+
+    return total;
+}
+
+long iospliceat (
+    struct io * in, unsigned long long pos, struct io * out, long len)
+{
+    assert (in != NULL && in->intf != NULL);
+    assert (out != NULL && out->intf != NULL);
+
+    if (len < 0)
+        return -EINVAL;
+
+    if (in->intf->splice != NULL)
+        return in->intf->splice(in, pos, out, len);
+
+    if (in->intf->readat == NULL)
+        return -ENOTSUP;
+
+    return splice_bounce(in, &pos, out, len);
+}
+
+long iosplice(struct io * in, struct io * out, long len) {
+    unsigned long long pos;
+    long total;
+
+    assert (in != NULL && in->intf != NULL);
+    assert (out != NULL && out->intf != NULL);
+
+    if (len < 0)
+        return -EINVAL;
+
+    // An endpoint with a position is spliced positionally, so that a KTFS file
+    // (which is wrapped in a seekio) reaches its splice operation.
+
+    if (ioctl(in, IOCTL_GETPOS, &pos) == 0) {
+        total = iospliceat(in, pos, out, len);
+
+        if (0 < total) {
+            pos += total;
+            ioctl(in, IOCTL_SETPOS, &pos);
+        }
+
+        return total;
+    }
+
+    if (in->intf->read == NULL)
+        return -ENOTSUP;
+
+    return splice_bounce(in, NULL, out, len);
+}
+
+int iopoll (
+    struct io * const * ios, const int * events, int * revents,
+    int cnt, long timeout_us)
+{
+    struct pollent ents[IOPOLL_MAX];
+    struct pollent ** pp;
+    struct alarm alarm;
+    int nready;
+    int pie;
+    int i;
+
+    if (cnt < 0 || IOPOLL_MAX < cnt)
+        return -EINVAL;
+
+    pie = disable_interrupts();
+
+    alarm_init(&alarm, "poll");
+
+    if (0 < timeout_us)
+        alarm_arm(&alarm, timeout_us * (TIMER_FREQ / 1000 / 1000));
+
+    // Register on the poll queue of every endpoint that has one, so that only
+    // their events wake us. The reference keeps the endpoint and its queue
+    // around if another thread closes the descriptor meanwhile.
+
+    for (i = 0; i < cnt; i++) {
+        ents[i].pq = NULL;
+        ents[i].cond = &alarm.cond;
+
+        if (ios[i] == NULL)
+            continue;
+
+        ioaddref(ios[i]);
+        if (ios[i]->intf->pollq != NULL)
+            ents[i].pq = ios[i]->intf->pollq(ios[i]);
+        if (ents[i].pq != NULL) {
+            ents[i].next = ents[i].pq->head;
+            ents[i].pq->head = &ents[i];
+        }
+    }
+
+    // Interrupts stay disabled between checking readiness and waiting, so a
+    // wakeup from an ISR cannot slip in between.
+
+    for (;;) {
+        nready = 0;
+
+        for (i = 0; i < cnt; i++) {
+            if (ios[i] == NULL)
+                revents[i] = 0;
+            else if (ios[i]->intf->poll != NULL)
+                revents[i] = ios[i]->intf->poll(ios[i], events[i]);
+            else
+                revents[i] = events[i] & (POLLIN | POLLOUT);
+
+            revents[i] &= events[i] | POLLHUP;
+            nready += (revents[i] != 0);
+        }
+
+        if (nready != 0 || timeout_us == 0)
+            break;
+
+        if (0 < timeout_us && alarm.twake <= rdtime())
+            break;
+
+        if (condition_wait_intr(&alarm.cond) < 0) {
+            nready = -EINTR;
+            break;
+        }
+    }
+
+    if (0 < timeout_us)
+        alarm_cancel(&alarm);
+
+    for (i = 0; i < cnt; i++) {
+        if (ents[i].pq == NULL)
+            continue;
+        for (pp = &ents[i].pq->head; *pp != &ents[i]; pp = &(*pp)->next)
+            continue;
+        *pp = ents[i].next;
+    }
+
+    restore_interrupts(pie);
+
+    for (i = 0; i < cnt; i++) {
+        if (ios[i] != NULL)
+            ioclose(ios[i]);
+    }
+
+    return nready;
+}
+
+void pollq_wakeup(struct pollq * pq) {
+    struct pollent * pe;
+    int pie;
+
+    if (pq->head == NULL)
+        return;
+
+    pie = disable_interrupts();
+    for (pe = pq->head; pe != NULL; pe = pe->next)
+        condition_broadcast(pe->cond);
+    restore_interrupts(pie);
+}
+
+size_t iov_length(const struct iovec * iov, int iovcnt) {
+    size_t len = 0;
+    int i;
+
+    for (i = 0; i < iovcnt; i++)
+        len += iov[i].len;
+
+    return len;
+}
+
+void iov_copy_to (
+    const struct iovec * iov, int iovcnt,
+    size_t off, const void * src, size_t n)
+{
+    size_t cnt;
+    int i;
+
+    for (i = 0; i < iovcnt && 0 < n; i++) {
+        if (off >= iov[i].len) {
+            off -= iov[i].len;
+            continue;
+        }
+
+        cnt = iov[i].len - off;
+        if (n < cnt)
+            cnt = n;
+
+        memcpy(iov[i].base + off, src, cnt);
+        src += cnt;
+        n -= cnt;
+        off = 0;
+    }
+}
+
+void iov_copy_from (
+    void * dst, const struct iovec * iov, int iovcnt,
+    size_t off, size_t n)
+{
+    size_t cnt;
+    int i;
+
+    for (i = 0; i < iovcnt && 0 < n; i++) {
+        if (off >= iov[i].len) {
+            off -= iov[i].len;
+            continue;
+        }
+
+        cnt = iov[i].len - off;
+        if (n < cnt)
+            cnt = n;
+
+        memcpy(dst, iov[i].base + off, cnt);
+        dst += cnt;
+        n -= cnt;
+        off = 0;
+    }
+}
+
 int ioctl(struct io * io, int cmd, void * arg) {
     assert (io != NULL);
     assert (io->intf != NULL);
 
+    // Non-blocking mode is a property of the I/O object, so it is handled
+    // here rather than by each endpoint.
+
+    if (cmd == IOCTL_SETNONBLOCK) {
+        if (arg == NULL)
+            return -EINVAL;
+        io->nonblock = (*(const int *)arg != 0);
+        return 0;
+    }
+
 	if (io->intf->cntl != NULL)
         return io->intf->cntl(io, cmd, arg);
     else if (cmd == IOCTL_GETBLKSZ)
@@ -493,48 +947,429 @@ long seekio_writeat (
     return iowriteat(sio->bkgio, pos, buf, len);
 }
 
-static long pipe_read(struct io *io, void *buf, long len) {
-    struct pipe_io *pio = (void*)io - offsetof(struct pipe_io, io);
-    struct pipe *p = pio->pipe;
-    char *dst = buf;
+// The vectored reads and writes follow the same rules as seekio_read and
+// seekio_write, applied to the total length of the segments, and go to the
+// backing endpoint as a single vectored request.
+
+long seekio_readv(struct io * io, const struct iovec * iov, int iovcnt) {
+    struct seekio * const sio = (void*)io - offsetof(struct seekio, io);
+    unsigned long long const pos = sio->pos;
+    unsigned long long const end = sio->end;
+    struct iovec trimmed[IOV_MAX];
+    long bufsz;
+    long rcnt;
+
+    if (IOV_MAX < iovcnt)
+        return -EINVAL;
+
+    bufsz = iov_length(iov, iovcnt);
+
+    if (end - pos < bufsz)
+        bufsz = end - pos;
+
+    if (bufsz == 0)
+        return 0;
+
+    if (bufsz < sio->blksz)
+        return -EINVAL;
+
+    bufsz &= ~(sio->blksz - 1);
+    iovcnt = iov_trim(trimmed, iov, iovcnt, bufsz);
+
+    rcnt = ioreadvat(sio->bkgio, pos, trimmed, iovcnt);
+    sio->pos = pos + ((rcnt < 0) ? 0 : rcnt);
+    return rcnt;
+}
+
+long seekio_writev(struct io * io, const struct iovec * iov, int iovcnt) {
+    struct seekio * const sio = (void*)io - offsetof(struct seekio, io);
+    unsigned long long const pos = sio->pos;
+    unsigned long long end = sio->end;
+    struct iovec trimmed[IOV_MAX];
+    int result;
+    long len;
+    long wcnt;
+
+    if (IOV_MAX < iovcnt)
+        return -EINVAL;
+
+    len = iov_length(iov, iovcnt);
+
+    if (len == 0)
+        return 0;
+
+    if (len < sio->blksz)
+        return -EINVAL;
+
+    len &= ~(sio->blksz - 1);
+    iovcnt = iov_trim(trimmed, iov, iovcnt, len);
+
+    if (end - pos < len) {
+        if (ULLONG_MAX - pos < len)
+            return -EINVAL;
+
+        end = pos + len;
+
+        result = ioctl(sio->bkgio, IOCTL_SETEND, &end);
+
+        if (result != 0)
+            return result;
+
+        sio->end = end;
+    }
+
+    wcnt = iowritevat(sio->bkgio, pos, trimmed, iovcnt);
+    sio->pos = pos + ((wcnt < 0) ? 0 : wcnt);
+    return wcnt;
+}
+
+long seekio_readvat (
+    struct io * io, unsigned long long pos,
+    const struct iovec * iov, int iovcnt)
+{
+    struct seekio * const sio = (void*)io - offsetof(struct seekio, io);
+    return ioreadvat(sio->bkgio, pos, iov, iovcnt);
+}
+
+long seekio_writevat (
+    struct io * io, unsigned long long pos,
+    const struct iovec * iov, int iovcnt)
+{
+    struct seekio * const sio = (void*)io - offsetof(struct seekio, io);
+    return iowritevat(sio->bkgio, pos, iov, iovcnt);
+}
+
+long seekio_splice (
+    struct io * io, unsigned long long pos, struct io * out, long len)
+{
+    struct seekio * const sio = (void*)io - offsetof(struct seekio, io);
+    return iospliceat(sio->bkgio, pos, out, len);
+}
+
+// Splices through a kernel buffer, reading at *_pos_ onward or, if _pos_ is
+// NULL, from the stream.
+
+long splice_bounce (
+    struct io * in, const unsigned long long * pos, struct io * out, long len)
+{
     long total = 0;
+    long chunk;
+    long rcnt, wcnt;
+    void * buf;
+
+    buf = kmalloc(SPLICE_BUFSZ);
 
-    while (len > 0) {
-        while (p->head == p->tail) {
-            if (p->closed_write) return total > 0 ? total : 0;  // EOF
-            condition_wait(&p->readable);
+    if (buf == NULL)
+        return -ENOMEM;
+
+    while (total < len) {
+        chunk = (len - total < SPLICE_BUFSZ) ? len - total : SPLICE_BUFSZ;
+
+        if (pos != NULL)
+            rcnt = ioreadat(in, *pos + total, buf, chunk);
+        else
+            rcnt = ioread(in, buf, chunk);
+
+        if (rcnt <= 0) {
+            if (total == 0)
+                total = rcnt;
+            break;
         }
 
-        dst[total++] = p->buf[p->tail];
-        p->tail = (p->tail + 1) % PIPE_BUFSZ;
-        len--;
-        condition_broadcast(&p->writable);
+        wcnt = iowrite(out, buf, rcnt);
+
+        if (wcnt < 0) {
+            if (total == 0)
+                total = wcnt;
+            break;
+        }
+
+        total += wcnt;
+
+        if (wcnt < rcnt)
+            break;
     }
 
+    kfree(buf);
     return total;
 }
 
+int seekio_poll(struct io * io, int events) {
+    struct seekio * const sio = (void*)io - offsetof(struct seekio, io);
+
+    if (sio->bkgio->intf->poll != NULL)
+        return sio->bkgio->intf->poll(sio->bkgio, events);
+    else
+        return events & (POLLIN | POLLOUT);
+}
+
+struct pollq * seekio_pollq(struct io * io) {
+    struct seekio * const sio = (void*)io - offsetof(struct seekio, io);
+
+    if (sio->bkgio->intf->pollq != NULL)
+        return sio->bkgio->intf->pollq(sio->bkgio);
+    else
+        return NULL;
+}
+
+// Copies up to _iovcnt_ segments from _src_ to _dst_, cutting the list off
+// after _len_ bytes. Returns the number of segments in _dst_.
+
+int iov_trim (
+    struct iovec * dst, const struct iovec * src, int iovcnt, size_t len)
+{
+    int i;
+
+    for (i = 0; i < iovcnt && 0 < len; i++) {
+        dst[i] = src[i];
+        if (len < dst[i].len)
+            dst[i].len = len;
+        len -= dst[i].len;
+    }
+
+    return i;
+}
+
+static long pipe_read(struct io *io, void *buf, long len) {
+    const struct iovec iov = { .base = buf, .len = len };
+    return pipe_readv(io, &iov, 1);
+}
+
 static long pipe_write(struct io *io, const void *buf, long len) {
+    const struct iovec iov = { .base = (void *)buf, .len = len };
+    return pipe_writev(io, &iov, 1);
+}
+
+// Reads follow POSIX: wait until the pipe is non-empty (or the write end is
+// closed), then take as much as is there, up to the requested length.
+
+static long pipe_readv(struct io *io, const struct iovec *iov, int iovcnt) {
     struct pipe_io *pio = (void*)io - offsetof(struct pipe_io, io);
     struct pipe *p = pio->pipe;
-    const char *src = buf;
-    long total = 0;
+    size_t len = iov_length(iov, iovcnt);
+    unsigned int off;
+    size_t cnt, span;
+
+    if (len == 0)
+        return 0;
+
+    while (p->head == p->tail && p->pg_head == p->pg_tail) {
+        if (p->closed_write) return 0;  // EOF
+        if (io->nonblock) return -EAGAIN;
+        if (condition_wait_intr(&p->readable) < 0) return -EINTR;
+    }
+
+    if (p->pg_head != p->pg_tail)
+        return pipe_read_pages(p, iov, iovcnt, len);
+
+    cnt = p->head - p->tail;
+    if (len < cnt)
+        cnt = len;
 
-    while (len > 0) {
-        while ((p->head + 1) % PIPE_BUFSZ == p->tail) {
+    // Copy out in at most two spans: up to the end of the buffer, then from
+    // the start.
+
+    off = p->tail % PIPE_BUFSZ;
+    span = (cnt < PIPE_BUFSZ - off) ? cnt : PIPE_BUFSZ - off;
+    iov_copy_to(iov, iovcnt, 0, p->buf + off, span);
+    iov_copy_to(iov, iovcnt, span, p->buf, cnt - span);
+    p->tail += cnt;
+
+    pipe_wake_writers(p);
+    pollq_wakeup(&p->wpollq);
+    return cnt;
+}
+
+// A write of at most PIPE_BUFSZ bytes is atomic: it waits until there is room
+// for all of it and is never interleaved with another writer's data. Larger
+// writes are copied in as space frees up and may be interleaved. A large
+// write from a page-aligned buffer sends its whole pages by reference and
+// copies only the tail. In non-blocking mode, a small write still goes in
+// whole or not at all, and a large one is always copied and takes what fits.
+
+static long pipe_writev(struct io *io, const struct iovec *iov, int iovcnt) {
+    struct pipe_io *pio = (void*)io - offsetof(struct pipe_io, io);
+    struct pipe *p = pio->pipe;
+    size_t len = iov_length(iov, iovcnt);
+    size_t total = 0;
+    unsigned int need;
+    unsigned int room;
+    unsigned int off;
+    size_t cnt, span;
+    long flipped;
+    int was_empty;
+
+    need = (len <= PIPE_BUFSZ) ? len : 1;
+
+    if (!io->nonblock && iovcnt == 1 && PIPE_FLIP_MIN <= len &&
+        ((uintptr_t)iov[0].base & (PAGE_SIZE - 1)) == 0)
+    {
+        total = len & ~(PAGE_SIZE - 1);
+        flipped = pipe_write_pages(p, iov[0].base, total);
+        if (flipped < 0 || flipped < total)
+            return flipped;
+    }
+
+    while (total < len) {
+        for (;;) {
             if (p->closed_read) return -EPIPE;  // broken pipe
-            condition_wait(&p->writable);
+            room = PIPE_BUFSZ - (p->head - p->tail);
+            if (p->pg_head == p->pg_tail && need <= room)
+                break;
+            if (io->nonblock)
+                return (0 < total) ? total : -EAGAIN;
+            if (p->wr_need == 0 || need < p->wr_need)
+                p->wr_need = need;
+            if (condition_wait_intr(&p->writable) < 0)
+                return (0 < total) ? total : -EINTR;
         }
 
-        p->buf[p->head] = src[total++];
-        p->head = (p->head + 1) % PIPE_BUFSZ;
-        len--;
-        condition_broadcast(&p->readable);
+        cnt = len - total;
+        if (room < cnt)
+            cnt = room;
+
+        off = p->head % PIPE_BUFSZ;
+        span = (cnt < PIPE_BUFSZ - off) ? cnt : PIPE_BUFSZ - off;
+        iov_copy_from(p->buf + off, iov, iovcnt, total, span);
+        iov_copy_from(p->buf, iov, iovcnt, total + span, cnt - span);
+
+        was_empty = (p->head == p->tail);
+        p->head += cnt;
+        total += cnt;
+
+        if (was_empty) {
+            condition_broadcast(&p->readable);
+            pollq_wakeup(&p->rpollq);
+        }
+    }
+
+    return total;
+}
+
+// Queues the _len_ / PAGE_SIZE pages of _buf_ (page-aligned) on the pipe. Each
+// page is shared copy-on-write with the writer, so the writer's later stores
+// do not change what the reader sees. A page that cannot be shared (not mapped
+// writable) is copied into a new page instead.
+
+static long pipe_write_pages(struct pipe *p, const char *buf, size_t len) {
+    size_t total = 0;
+    int was_empty;
+    void *pp;
+
+    while (total < len) {
+        for (;;) {
+            if (p->closed_read) return -EPIPE;  // broken pipe
+            if (p->head != p->tail) {
+                if (p->wr_need == 0 || PIPE_BUFSZ < p->wr_need)
+                    p->wr_need = PIPE_BUFSZ;
+            } else if (p->pg_head - p->pg_tail == PIPE_NPAGES)
+                p->wr_page = 1;
+            else
+                break;
+            if (condition_wait_intr(&p->writable) < 0)
+                return (total > 0) ? (long)total : -EINTR;
+        }
+
+        pp = cow_share_page((uintptr_t)buf + total);
+
+        if (pp == NULL) {
+            pp = alloc_phys_page();
+            if (pp == NULL)
+                return (total > 0) ? (long)total : -ENOMEM;
+            copy_page(pp, buf + total);
+        }
+
+        was_empty = (p->pg_head == p->pg_tail);
+        p->pages[p->pg_head++ % PIPE_NPAGES] = pp;
+        total += PAGE_SIZE;
+
+        if (was_empty) {
+            condition_broadcast(&p->readable);
+            pollq_wakeup(&p->rpollq);
+        }
     }
 
     return total;
 }
 
+// Reads up to _len_ bytes from the page queue. A whole page headed for a
+// page-aligned spot in the reader's buffer is mapped there instead of copied;
+// anything else is copied out of the page.
+
+static long pipe_read_pages (
+    struct pipe *p, const struct iovec *iov, int iovcnt, size_t len)
+{
+    size_t total = 0;
+    uintptr_t dst;
+    size_t cnt;
+    void *pp;
+
+    while (total < len && p->pg_head != p->pg_tail) {
+        pp = p->pages[p->pg_tail % PIPE_NPAGES];
+        cnt = PAGE_SIZE - p->pg_off;
+        if (len - total < cnt)
+            cnt = len - total;
+
+        dst = iov_span(iov, iovcnt, total, PAGE_SIZE);
+
+        if (cnt != PAGE_SIZE || (dst & (PAGE_SIZE - 1)) != 0 ||
+            cow_map_page(dst, pp) != 0)
+        {
+            iov_copy_to(iov, iovcnt, total, pp + p->pg_off, cnt);
+            total += cnt;
+
+            if (p->pg_off + cnt < PAGE_SIZE) {
+                p->pg_off += cnt;
+                break;
+            }
+
+            page_release(pp);
+        } else
+            total += cnt;  // the queue's reference went to the mapping
+
+        p->pg_off = 0;
+        p->pg_tail += 1;
+
+        if (p->wr_page) {
+            p->wr_page = 0;
+            condition_broadcast(&p->writable);
+        }
+    }
+
+    pipe_wake_writers(p);
+    pollq_wakeup(&p->wpollq);
+    return total;
+}
+
+// Wakes ring writers once there is room for the smallest waiting write.
+
+static void pipe_wake_writers(struct pipe *p) {
+    if (p->wr_need == 0 || p->pg_head != p->pg_tail)
+        return;
+
+    if (p->wr_need <= PIPE_BUFSZ - (p->head - p->tail)) {
+        p->wr_need = 0;
+        condition_broadcast(&p->writable);
+    }
+}
+
+// Returns the address of the _n_ bytes at offset _off_ in the segment list if
+// they lie in a single segment, or 0 otherwise.
+
+static uintptr_t iov_span (
+    const struct iovec *iov, int iovcnt, size_t off, size_t n)
+{
+    int i;
+
+    for (i = 0; i < iovcnt; i++) {
+        if (off < iov[i].len)
+            return (n <= iov[i].len - off) ? (uintptr_t)iov[i].base + off : 0;
+        off -= iov[i].len;
+    }
+
+    return 0;
+}
+
 static void pipe_close(struct io *io) {
     struct pipe_io *pio = (void*)io - offsetof(struct pipe_io, io);
     struct pipe *p = pio->pipe;
@@ -542,12 +1377,16 @@ static void pipe_close(struct io *io) {
     if (pio->is_writer) {
         p->closed_write = 1;
         condition_broadcast(&p->readable);
+        pollq_wakeup(&p->rpollq);
     } else {
         p->closed_read = 1;
         condition_broadcast(&p->writable);
+        pollq_wakeup(&p->wpollq);
     }
 
     if (p->closed_read && p->closed_write) {
+        while (p->pg_tail != p->pg_head)
+            page_release(p->pages[p->pg_tail++ % PIPE_NPAGES]);
         free_phys_page(p->buf);
         kfree(p);
     }
@@ -555,6 +1394,32 @@ static void pipe_close(struct io *io) {
     kfree(pio);
 }
 
+static int pipe_poll(struct io *io, int events) {
+    struct pipe_io *pio = (void*)io - offsetof(struct pipe_io, io);
+    struct pipe *p = pio->pipe;
+    int revents = 0;
+
+    if (pio->is_writer) {
+        if (p->closed_read)
+            revents |= POLLHUP;
+        else if (p->pg_head == p->pg_tail && p->head - p->tail < PIPE_BUFSZ)
+            revents |= POLLOUT;
+    } else {
+        if (p->head != p->tail || p->pg_head != p->pg_tail)
+            revents |= POLLIN;
+        if (p->closed_write)
+            revents |= POLLHUP;
+    }
+
+    return revents;
+}
+
+static struct pollq * pipe_pollq(struct io *io) {
+    struct pipe_io *pio = (void*)io - offsetof(struct pipe_io, io);
+
+    return pio->is_writer ? &pio->pipe->wpollq : &pio->pipe->rpollq;
+}
+
 static int pipe_cntl(struct io *io, int cmd, void *arg) {
     switch (cmd) {
         case IOCTL_GETBLKSZ: return 1;
@@ -14,11 +14,23 @@
 
 struct io; // opaque (defined in ioimpl.h)
 
+// A struct iovec describes one segment of a vectored read or write. The layout
+// matches struct iovec in usr/syscall.h, since the readv/writev system calls
+// pass user arrays through.
+
+struct iovec {
+    void * base;
+    size_t len;
+};
+
+#define IOV_MAX 16 // most segments accepted by the vectored system calls
+
 #define IOCTL_GETBLKSZ  0 // arg is ignored
 #define IOCTL_GETEND    2 // arg is unsigned long long *
 #define IOCTL_SETEND    3 // arg is const unsigned long long *
 #define IOCTL_GETPOS    4 // arg is unsigned long long *
 #define IOCTL_SETPOS    5 // arg is const unsigned long long *
+#define IOCTL_SETNONBLOCK 6 // arg is const int * (non-zero to set)
 #define PIPE_BUFSZ PAGE_SIZE 
 // EXPORTED FUNCTION DECLARATIONS
 //
@@ -70,6 +82,95 @@ extern int ioseek (
     unsigned long long pos
 );
 
+// Vectored versions of ioread, iowrite, ioreadat and iowriteat. The segments
+// are filled or drained in order, as if they were one contiguous buffer.
+// Endpoints that do not implement a vectored operation get a generic version
+// that loops over the scalar one; for reads, the loop stops at the first short
+// read.
+
+extern long ioreadv (
+    struct io * io,
+    const struct iovec * iov,
+    int iovcnt
+);
+
+extern long iowritev (
+    struct io * io,
+    const struct iovec * iov,
+    int iovcnt
+);
+
+extern long ioreadvat (
+    struct io * io,
+    unsigned long long pos,
+    const struct iovec * iov,
+    int iovcnt
+);
+
+extern long iowritevat (
+    struct io * io,
+    unsigned long long pos,
+    const struct iovec * iov,
+    int iovcnt
+);
+
+// Helpers for implementors of vectored operations. iov_length returns the total
+// length of the segments. iov_copy_to copies _n_ bytes from _src_ into the
+// segments starting _off_ bytes in; iov_copy_from copies the other way.
+
+extern size_t iov_length(const struct iovec * iov, int iovcnt);
+
+extern void iov_copy_to (
+    const struct iovec * iov, int iovcnt,
+    size_t off, const void * src, size_t n);
+
+extern void iov_copy_from (
+    void * dst, const struct iovec * iov, int iovcnt,
+    size_t off, size_t n);
+
+// Moves up to _len_ bytes from _in_ to _out_ without a user-space buffer.
+// iospliceat reads _in_ starting at _pos_; an endpoint that implements the
+// splice operation writes straight from its own buffers (for KTFS, the block
+// cache), and any other endpoint is read through a kernel bounce buffer.
+// iosplice reads from the current position of _in_ and advances it, or reads
+// _in_ as a stream if it has no position. Both return the number of bytes
+// written to _out_, which is short only at end of input or on error.
+
+extern long iospliceat (
+    struct io * in,
+    unsigned long long pos,
+    struct io * out,
+    long len
+);
+
+extern long iosplice (
+    struct io * in,
+    struct io * out,
+    long len
+);
+
+// Readiness polling. iopoll waits until at least one of the _cnt_ endpoints in
+// _ios_ is ready for an event in the corresponding _events_ entry, or until
+// _timeout_us_ microseconds pass (a negative timeout waits forever; zero only
+// checks). The ready events are stored in _revents_ (POLLHUP is reported even
+// if not asked for). Returns the number of endpoints with events, 0 on
+// timeout. An endpoint without a poll operation is always ready. At most
+// IOPOLL_MAX endpoints can be watched at once.
+
+#define POLLIN  0x1 // read will not block
+#define POLLOUT 0x2 // write will not block
+#define POLLHUP 0x4 // other end closed
+
+#define IOPOLL_MAX 16
+
+extern int iopoll (
+    struct io * const * ios,
+    const int * events,
+    int * revents,
+    int cnt,
+    long timeout_us
+);
+
 extern int ioblksz(struct io * io);
 extern struct io * create_memory_io(void * buf, size_t size);
 extern struct io * create_seekable_io(struct io * io);
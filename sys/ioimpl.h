@@ -12,9 +12,14 @@
 // EXPORTED TYPE DEFINITIONS
 //
 
+// When _nonblock_ is set (IOCTL_SETNONBLOCK), a read or write that would have
+// to wait returns what it could transfer so far, or -EAGAIN if that is
+// nothing. Endpoints that never wait ignore it.
+
 struct io {
     const struct iointf * intf;
     unsigned long refcnt; 
+    char nonblock;
 };
 
 struct iointf {
@@ -48,6 +53,41 @@ struct iointf {
         const void * buf,
         long len
     );
+    long (*readv) (
+        struct io * io,
+        const struct iovec * iov,
+        int iovcnt
+    );
+    long (*writev) (
+        struct io * io,
+        const struct iovec * iov,
+        int iovcnt
+    );
+    long (*readvat) (
+        struct io * io,
+        unsigned long long pos,
+        const struct iovec * iov,
+        int iovcnt
+    );
+    long (*writevat) (
+        struct io * io,
+        unsigned long long pos,
+        const struct iovec * iov,
+        int iovcnt
+    );
+    long (*splice) (
+        struct io * io,
+        unsigned long long pos,
+        struct io * out,
+        long len
+    );
+    int (*poll) (
+        struct io * io,
+        int events
+    );
+    struct pollq * (*pollq) (
+        struct io * io
+    );
 };
 
 // EXPORTED FUNCTION DECLARATIONS
@@ -62,4 +102,21 @@ struct iointf {
 extern struct io * ioinit0(struct io * io, const struct iointf * intf);
 extern struct io * ioinit1(struct io * io, const struct iointf * intf);
 
+// An endpoint with a poll operation returns the subset of POLLIN, POLLOUT and
+// POLLHUP that currently holds, without blocking. If that can change while a
+// thread waits, the endpoint also has a pollq operation that returns its poll
+// queue, on which iopoll registers while it waits. Whenever one of the events
+// may have become true (data arrived, space freed, peer closed), the endpoint
+// must call pollq_wakeup on its queue, which wakes only the threads polling
+// that endpoint. pollq_wakeup may be called from an ISR and is cheap when no
+// thread is polling. A zero-filled pollq is an empty queue.
+
+struct pollent; // io.c
+
+struct pollq {
+    struct pollent * head;
+};
+
+extern void pollq_wakeup(struct pollq * pq);
+
 #endif // _IOIMPL_H_
\ No newline at end of file
@@ -52,12 +52,15 @@ int ktfs_mount(struct io * io);
 int ktfs_open(const char * name, struct io ** ioptr);
 void ktfs_close(struct io* io);
 long ktfs_readat(struct io* io, unsigned long long pos, void * buf, long len);
+long ktfs_readvat(struct io* io, unsigned long long pos, const struct iovec * iov, int iovcnt);
+long ktfs_splice(struct io* io, unsigned long long pos, struct io * out, long len);
 int ktfs_cntl(struct io *io, int cmd, void *arg);
 
 int ktfs_getblksz(struct ktfs_file *fd);
 int ktfs_getend(struct ktfs_file *fd, void *arg);
 
 long ktfs_writeat(struct io * io, unsigned long long pos, const void * buf, long len );    
+long ktfs_writevat(struct io * io, unsigned long long pos, const struct iovec * iov, int iovcnt);
 
 int ktfs_flush(void);
 
@@ -67,6 +70,15 @@ int set_file_size(struct io * io, const unsigned long long * arg);
 int ktfs_create	(const char * name);
 int ktfs_delete	(const char * name);
 
+static long ktfs_writevat_unlocked(struct io * io, unsigned long long pos, const struct iovec * iov, int iovcnt);
+static int ktfs_create_unlocked(const char * name);
+static int ktfs_delete_unlocked(const char * name);
+
+static long ktfs_read_blocks(struct io* io, unsigned long long pos, long len,
+    long (*put)(void * aux, size_t off, const void * src, size_t n), void * aux);
+static long ktfs_put_iov(void * aux, size_t off, const void * src, size_t n);
+static long ktfs_put_io(void * aux, size_t off, const void * src, size_t n);
+
 uint32_t find_available_block();
 int clear_data_block(uint32_t b);
 
@@ -109,6 +121,12 @@ static struct ktfs_superblock superblock;
 
 static struct ktfs_inode root_directory_inode;
 
+// Writes, create, delete and resize change the bitmap, inodes and directory,
+// so they are serialized by ktfs_lock. Reads do not take it; concurrent
+// readers (for example, AIO workers) only contend for cache blocks.
+
+static struct lock ktfs_lock;
+
 // static struct ktfs_dir_entry * dentry_datablock;
 
 // int ktfs_mount(struct io * io)
@@ -126,8 +144,9 @@ int ktfs_mount(struct io * io)
     struct ktfs_data_block blockbuf;
     int ret;
 
+    lock_init(&ktfs_lock);
     diskio = ioaddref(io);
-    kprintf("ktfs_mount: Added ref to diskio, diskio=%p\n", diskio);
+    debug("ktfs_mount: Added ref to diskio, diskio=%p", diskio);
 
     // Read superblock data
     ret = ioreadat(io, 0, &blockbuf, KTFS_BLKSZ);
@@ -136,7 +155,7 @@ int ktfs_mount(struct io * io)
         return -EMFILE;
     }
     memcpy(&superblock, &blockbuf, sizeof(superblock));
-    kprintf("ktfs_mount: Superblock read. bitmap_block_count=%u, inode_block_count=%u, root_directory_inode=%u\n",
+    debug("ktfs_mount: Superblock read. bitmap_block_count=%u, inode_block_count=%u, root_directory_inode=%u",
             superblock.bitmap_block_count, superblock.inode_block_count, superblock.root_directory_inode);
 
     // Read the inode block that contains the root directory inode.
@@ -151,7 +170,7 @@ int ktfs_mount(struct io * io)
     uint32_t inode_offset = superblock.root_directory_inode % (KTFS_BLKSZ / sizeof(struct ktfs_inode));
     memcpy(&root_directory_inode, ((char *)&blockbuf) + inode_offset * sizeof(struct ktfs_inode),
            sizeof(struct ktfs_inode));
-    kprintf("ktfs_mount: Root directory inode read. size=%u, first direct block=%u\n",
+    debug("ktfs_mount: Root directory inode read. size=%u, first direct block=%u",
             root_directory_inode.size, root_directory_inode.block[0]);
 
     if(create_cache(diskio, &c)){
@@ -159,7 +178,7 @@ int ktfs_mount(struct io * io)
         return -1;
     }
 
-    kprintf("ktfs_mount: Completed successfully.\n");
+    debug("ktfs_mount: Completed successfully.");
     return 0;
 }
 
@@ -167,6 +186,9 @@ static const struct iointf intf = {     // interface for new io in open
     .close = &ktfs_close,
     .readat = &ktfs_readat,
     .writeat = &ktfs_writeat,
+    .readvat = &ktfs_readvat,
+    .writevat = &ktfs_writevat,
+    .splice = &ktfs_splice,
     .cntl = &ktfs_cntl
 };
 
@@ -328,7 +350,64 @@ void ktfs_close(struct io* io)
 
 long ktfs_readat(struct io* io, unsigned long long pos, void * buf, long len)
 {
-    kprintf("reading from file \n");
+    const struct iovec iov = { .base = buf, .len = len };
+    return ktfs_readvat(io, pos, &iov, 1);
+}
+
+// long ktfs_readvat(struct io* io, unsigned long long pos, const struct iovec * iov, int iovcnt)
+//
+//  Description: Same as ktfs_readat, but scatters the data across the iovcnt
+//  segments of iov. Each data block is looked up in the cache once no matter
+//  how many segments it is copied into.
+
+struct ktfs_iov_aux {
+    const struct iovec * iov;
+    int iovcnt;
+};
+
+long ktfs_readvat(struct io* io, unsigned long long pos, const struct iovec * iov, int iovcnt)
+{
+    struct ktfs_iov_aux aux = { .iov = iov, .iovcnt = iovcnt };
+    return ktfs_read_blocks(io, pos, iov_length(iov, iovcnt), &ktfs_put_iov, &aux);
+}
+
+// long ktfs_splice(struct io* io, unsigned long long pos, struct io * out, long len)
+//
+//  Description: Writes up to len bytes of the file starting at pos to out,
+//  straight from the cached data blocks, so the data is copied only once. The
+//  block is held in the cache while out is written, so out must not be
+//  waiting on a reader of the same file.
+//
+//  Returns:  the number of bytes written to out or a negative value if nothing
+//  was written because of an error.
+
+long ktfs_splice(struct io* io, unsigned long long pos, struct io * out, long len)
+{
+    return ktfs_read_blocks(io, pos, len, &ktfs_put_io, out);
+}
+
+long ktfs_put_iov(void * aux, size_t off, const void * src, size_t n) {
+    const struct ktfs_iov_aux * const a = aux;
+    iov_copy_to(a->iov, a->iovcnt, off, src, n);
+    return n;
+}
+
+long ktfs_put_io(void * aux, size_t off, const void * src, size_t n) {
+    return iowrite((struct io *)aux, src, n);
+}
+
+// long ktfs_read_blocks(io, pos, len, put, aux)
+//
+//  Description: Walks the data blocks holding len bytes of the file starting at
+//  pos and hands each piece to put, along with the piece's offset in the read.
+//  Stops early if put returns a short count or an error.
+
+long ktfs_read_blocks(struct io* io, unsigned long long pos, long len,
+    long (*put)(void * aux, size_t off, const void * src, size_t n), void * aux)
+{
+    long wcnt;
+
+    debug("reading from file");
     struct ktfs_file * file;
     struct open_files * list = open_files;
     while(list != NULL){
@@ -442,9 +521,13 @@ long ktfs_readat(struct io* io, unsigned long long pos, void * buf, long len)
             }
         }
        // kprintf("ktfs_readat: Block %ld, blkoff=%u, cpycnt=%zu\n", i, blkoff, cpycnt);
-        memcpy((char *)buf + bytes, blkbuf->data + blkoff, cpycnt);
-        bytes += cpycnt;
+        wcnt = put(aux, bytes, blkbuf->data + blkoff, cpycnt);
         cache_release_block(c, blkbuf, CACHE_CLEAN);
+        if (wcnt < 0)
+            return (bytes > 0) ? (long)bytes : wcnt;
+        bytes += wcnt;
+        if (wcnt < cpycnt)
+            return bytes;
     }   
 
    // kprintf("ktfs_readat: Completed, total bytes copied = %zu\n", bytes);
@@ -472,8 +555,13 @@ int ktfs_cntl(struct io *io, int cmd, void *arg)
             *(uint32_t *)arg = file->size;
             return 0;
         }
-        case IOCTL_SETEND:
-            return set_file_size(io, arg);
+        case IOCTL_SETEND: {
+            int result;
+            lock_acquire(&ktfs_lock);
+            result = set_file_size(io, arg);
+            lock_release(&ktfs_lock);
+            return result;
+        }
 
         default: 
             return -ENOTSUP;
@@ -492,10 +580,42 @@ int ktfs_cntl(struct io *io, int cmd, void *arg)
 int ktfs_flush(void)
 {
     int ret = cache_flush(c);
-    kprintf("ktfs_flush: cache_flush returned %d\n", ret);
+    debug("ktfs_flush: cache_flush returned %d", ret);
     return ret;
 }
 
+long ktfs_writeat(struct io * io, unsigned long long pos, const void * buf, long len) {
+    const struct iovec iov = { .base = (void *)buf, .len = len };
+    return ktfs_writevat(io, pos, &iov, 1);
+}
+
+long ktfs_writevat(struct io * io, unsigned long long pos, const struct iovec * iov, int iovcnt) {
+    long result;
+
+    lock_acquire(&ktfs_lock);
+    result = ktfs_writevat_unlocked(io, pos, iov, iovcnt);
+    lock_release(&ktfs_lock);
+    return result;
+}
+
+int ktfs_create(const char * name) {
+    int result;
+
+    lock_acquire(&ktfs_lock);
+    result = ktfs_create_unlocked(name);
+    lock_release(&ktfs_lock);
+    return result;
+}
+
+int ktfs_delete(const char * name) {
+    int result;
+
+    lock_acquire(&ktfs_lock);
+    result = ktfs_delete_unlocked(name);
+    lock_release(&ktfs_lock);
+    return result;
+}
+
 // long ktfs_writeat(struct io * io, unsigned long long pos, const void * buf, long len )
 // parameters:
 //                                               
@@ -507,9 +627,12 @@ int ktfs_flush(void)
 //  Description: Write len bytes starting at pos to the file associated with io
 //    
 //  Returns:  long that indicates the number of bytes written or a negative value if there's an error.
+//  The data is gathered from the iovcnt segments of iov.
+
+long ktfs_writevat_unlocked(struct io * io, unsigned long long pos, const struct iovec * iov, int iovcnt){
+    long len = iov_length(iov, iovcnt);
 
-long ktfs_writeat(struct io * io, unsigned long long pos, const void * buf, long len ){
-    kprintf("writing to file \n");
+    debug("writing to file");
     struct ktfs_file * file;
     struct open_files * list = open_files;
     while(list != NULL){
@@ -569,7 +692,7 @@ long ktfs_writeat(struct io * io, unsigned long long pos, const void * buf, long
             numblks +=1;
         }
     }
-    kprintf("ktfs_writeat: pos=%llu, len=%ld, blkno=%u, numblks=%ld, blkoff=%u\n", pos, len, blkno, numblks, blkoff);
+    debug("ktfs_writeat: pos=%llu, len=%ld, blkno=%u, numblks=%ld, blkoff=%u", pos, len, blkno, numblks, blkoff);
 
     cache_get_block(c,
         KTFS_BLKSZ*(1 + superblock.bitmap_block_count + file->dentry.inode / (KTFS_BLKSZ/sizeof(struct ktfs_inode))),
@@ -582,7 +705,7 @@ long ktfs_writeat(struct io * io, unsigned long long pos, const void * buf, long
     for(long i = 0; i < numblks; i++){
         if(i + blkno < KTFS_NUM_DIRECT_DATA_BLOCKS){   // direct blocks
             blockidx = in.block[i + blkno];
-            kprintf("ktfs_writeat: [Direct] Block %ld, blockidx=%u\n", i, blockidx);
+            debug("ktfs_writeat: [Direct] Block %ld, blockidx=%u", i, blockidx);
         }
         else if((i + blkno) < (KTFS_NUM_DIRECT_DATA_BLOCKS + (KTFS_BLKSZ/sizeof(uint32_t)))){ // indirect blocks
             cache_get_block(c,
@@ -590,7 +713,7 @@ long ktfs_writeat(struct io * io, unsigned long long pos, const void * buf, long
                 (void**)&blkbuf);
             memcpy(&blockidx, blkbuf->data + (sizeof(uint32_t) * (i + blkno - KTFS_NUM_DIRECT_DATA_BLOCKS)), sizeof(blockidx));
             cache_release_block(c, blkbuf, CACHE_CLEAN);
-            kprintf("ktfs_writeat: [Indirect] Block %ld, blockidx=%u\n", i, blockidx);
+            debug("ktfs_writeat: [Indirect] Block %ld, blockidx=%u", i, blockidx);
         }
         else { // double indirect blocks
             uint32_t idx_dind = ((i + blkno) - (KTFS_NUM_DIRECT_DATA_BLOCKS + (KTFS_BLKSZ/sizeof(uint32_t))));
@@ -604,7 +727,7 @@ long ktfs_writeat(struct io * io, unsigned long long pos, const void * buf, long
                 (void**)&blkbuf);
             memcpy(&blockidx, blkbuf->data + sizeof(blockidx) * (idx_dind % (KTFS_BLKSZ/sizeof(uint32_t))), sizeof(blockidx));
             cache_release_block(c, blkbuf, CACHE_CLEAN);
-            kprintf("ktfs_writeat: [Double Indirect] Block %ld, blockidx=%u\n", i, blockidx);
+            debug("ktfs_writeat: [Double Indirect] Block %ld, blockidx=%u", i, blockidx);
         }
         cache_get_block(c, KTFS_BLKSZ *(1 + superblock.bitmap_block_count + superblock.inode_block_count + blockidx), (void **)&blkbuf);
         if(numblks == 1){
@@ -624,13 +747,13 @@ long ktfs_writeat(struct io * io, unsigned long long pos, const void * buf, long
                 cpycnt = KTFS_BLKSZ;
             }
         }
-        kprintf("ktfs_writeat: Block %ld, blkoff=%u, cpycnt=%zu\n", i, blkoff, cpycnt);
-        memcpy(blkbuf->data + blkoff,(char *)buf + bytes,cpycnt);
+        debug("ktfs_writeat: Block %ld, blkoff=%u, cpycnt=%zu", i, blkoff, cpycnt);
+        iov_copy_from(blkbuf->data + blkoff, iov, iovcnt, bytes, cpycnt);
         bytes += cpycnt;
         cache_release_block(c, blkbuf, CACHE_DIRTY);
     }   
 
-    kprintf("ktfs_writeat: Completed, total bytes copied = %zu\n", bytes);
+    debug("ktfs_writeat: Completed, total bytes copied = %zu", bytes);
     return len;
 }
 
@@ -643,9 +766,9 @@ long ktfs_writeat(struct io * io, unsigned long long pos, const void * buf, long
 //    
 //  Returns:  0 on success, negative value on error
 
-int ktfs_create	(const char * name){
+int ktfs_create_unlocked(const char * name){
 
-    kprintf("creating new file \n");
+    debug("creating new file");
     if (name == NULL || *name == '\0')
         return -ENOTSUP; // need valid name
 
@@ -779,9 +902,9 @@ int ktfs_create	(const char * name){
 //    
 //  Returns:  0 on success, negative value on error
 
-int ktfs_delete	(const char *name){
+int ktfs_delete_unlocked(const char *name){
 
-    kprintf("deleting file file \n");
+    debug("deleting file file");
     if (name == NULL || *name == '\0')
     return -ENOENT; // file not found
 
@@ -967,7 +1090,7 @@ int ktfs_delete	(const char *name){
 
 int set_file_size(struct io * io, const unsigned long long * arg){
 
-    kprintf("resizing file \n");
+    debug("resizing file");
     struct ktfs_data_block block;
     struct ktfs_data_block * blockbuf = &block;
     struct ktfs_inode in;
@@ -1007,7 +1130,7 @@ int set_file_size(struct io * io, const unsigned long long * arg){
     //if new blocks required, allocate new data blocks
     for(unsigned i = old_numblks; i < new_numblks; i++){
         if(i < KTFS_NUM_DIRECT_DATA_BLOCKS){                //allocate direct data block
-            kprintf("allocating direct data block:\n");
+            debug("allocating direct data block");
             in.block[i] = find_available_block();
             if(in.block[i] == 0){
                 return -EACCESS;
@@ -1016,7 +1139,7 @@ int set_file_size(struct io * io, const unsigned long long * arg){
         }
         else if(i < (KTFS_NUM_DIRECT_DATA_BLOCKS + (KTFS_BLKSZ/sizeof(uint32_t)))){
             if(i == KTFS_NUM_DIRECT_DATA_BLOCKS){       //allocate new indirect data block
-                kprintf("allocating indirect data block:\n");
+                debug("allocating indirect data block");
                 in.indirect = find_available_block();
                 if(in.indirect == 0){
                     return -EACCESS;
@@ -1024,7 +1147,7 @@ int set_file_size(struct io * io, const unsigned long long * arg){
                 in.indirect -= (1 + superblock.bitmap_block_count + superblock.inode_block_count);
             }
             offset = KTFS_BLKSZ*(1 + superblock.bitmap_block_count + superblock.inode_block_count + in.indirect);
-            kprintf("allocating direct data block:\n");
+            debug("allocating direct data block");
             newblock = find_available_block();
             if(newblock == 0){
                 return -EACCESS;
@@ -1038,7 +1161,7 @@ int set_file_size(struct io * io, const unsigned long long * arg){
             idx_dind = i - (KTFS_NUM_DIRECT_DATA_BLOCKS + (KTFS_BLKSZ/sizeof(uint32_t)));   //block relative to indirect
 
             if(idx_dind % BLOCKS_PER_DIND == 0){        //allocate new double indirect block
-                kprintf("allocating double indirect data block:\n");
+                debug("allocating double indirect data block");
                 in.dindirect[idx_dind/BLOCKS_PER_DIND] = find_available_block();
                 if(in.dindirect[idx_dind/BLOCKS_PER_DIND] == 0){
                     return -EACCESS;
@@ -1049,7 +1172,7 @@ int set_file_size(struct io * io, const unsigned long long * arg){
             //access double indirect data block
             offset = KTFS_BLKSZ*(1 + superblock.bitmap_block_count + superblock.inode_block_count + in.dindirect[idx_dind/BLOCKS_PER_DIND]);
             if(idx_dind%(KTFS_BLKSZ/sizeof(uint32_t)) == 0){        //if new indirect block needed, allocate
-                kprintf("allocating indirect data block:\n");
+                debug("allocating indirect data block");
                 newblock = find_available_block();
                 if(newblock == 0){
                     return -EACCESS;
@@ -1066,7 +1189,7 @@ int set_file_size(struct io * io, const unsigned long long * arg){
 
             offset = KTFS_BLKSZ*(1 + superblock.bitmap_block_count + superblock.inode_block_count + ind_blk_idx);
             //access indirect data block
-            kprintf("allocating direct data block:\n");
+            debug("allocating direct data block");
             newblock = find_available_block();
             if(newblock == 0){
                 return -EACCESS;
@@ -1112,7 +1235,7 @@ uint32_t find_available_block(){                //returns block index of availab
                 b->bytes[j/8] |= (1 << (j%8));          //8 bits per byte
                 cache_release_block(c, &bitmap, CACHE_DIRTY);
                 uint32_t ret = ((i*KTFS_BLKSZ*8) + j);// - 1 - superblock.bitmap_block_count - superblock.inode_block_count;
-                kprintf("allocating data block %d \n",(ret- 1 - superblock.bitmap_block_count - superblock.inode_block_count));
+                debug("allocating data block %d",(ret- 1 - superblock.bitmap_block_count - superblock.inode_block_count));
                 return ret;
             }
         }
@@ -1142,7 +1265,7 @@ int clear_data_block(uint32_t b){
     
     cache_get_block(c, KTFS_BLKSZ*(1 + (b/(KTFS_BLKSZ*8))), (void **)&bit); //get bitmap block that block is located in
     bit->bytes[b/8] &= ~(1 << (b%8));            //8 bits per byte
-    kprintf("clearing block %d \n", b);
+    debug("clearing block %d", b);
     cache_release_block(c,bit,CACHE_DIRTY);
 
     return 0;
@@ -0,0 +1,119 @@
+// ktrace.c - Kernel trace ring buffer
+//
+// Copyright (c) 2024-2025 University of Illinois
+// SPDX-License-identifier: NCSA
+//
+
+#include "ktrace.h"
+#include "device.h"
+#include "ioimpl.h"
+#include "thread.h"
+#include "intr.h"
+#include "riscv.h"
+#include "error.h"
+#include "console.h"
+
+#include <stddef.h>
+
+// COMPILE-TIME PARAMETERS
+//
+
+// KTRACE_NREC is the number of records the ring holds. Without KTRACE nothing
+// is ever recorded, so the ring is kept to one record.
+
+#ifndef KTRACE_NREC
+#ifdef KTRACE
+#define KTRACE_NREC 1024
+#else
+#define KTRACE_NREC 1
+#endif
+#endif
+
+// INTERNAL FUNCTION DECLARATIONS
+//
+
+static int ktrace_open(struct io ** ioptr, void * aux);
+static void ktrace_close(struct io * io);
+static long ktrace_read(struct io * io, void * buf, long bufsz);
+
+// INTERNAL GLOBAL VARIABLES
+//
+
+// The indices are free-running. When the writer laps the reader, the reader
+// skips ahead and the skipped records are counted in _lost_.
+
+static struct {
+    unsigned long head;
+    unsigned long tail;
+    unsigned long lost;
+    struct ktrace_rec rec[KTRACE_NREC];
+} ring;
+
+static struct io ktrace_io;
+
+// EXPORTED FUNCTION DEFINITIONS
+//
+
+void ktrace_record(int type, uint32_t a0, uint64_t a1) {
+    struct ktrace_rec * r;
+    int pie;
+
+    pie = disable_interrupts();
+
+    r = &ring.rec[ring.head++ % KTRACE_NREC];
+    r->time = rdtime();
+    r->type = type;
+    r->tid = running_thread();
+    r->a0 = a0;
+    r->a1 = a1;
+
+    restore_interrupts(pie);
+}
+
+void ktrace_attach(void) {
+    static const struct iointf ktrace_iointf = {
+        .close = &ktrace_close,
+        .read = &ktrace_read
+    };
+
+    ioinit0(&ktrace_io, &ktrace_iointf);
+    register_device("ktrace", &ktrace_open, NULL);
+}
+
+// INTERNAL FUNCTION DEFINITIONS
+//
+
+int ktrace_open(struct io ** ioptr, void * aux) {
+    *ioptr = ioaddref(&ktrace_io);
+    return 0;
+}
+
+void ktrace_close(struct io * io) {
+    if (ring.lost != 0)
+        kprintf("ktrace: %lu records overwritten before being read\n",
+            ring.lost);
+    ring.lost = 0;
+}
+
+long ktrace_read(struct io * io, void * buf, long bufsz) {
+    struct ktrace_rec * const out = buf;
+    long cnt = 0;
+    int pie;
+
+    if (bufsz < sizeof(struct ktrace_rec))
+        return -EINVAL;
+
+    pie = disable_interrupts();
+
+    if (KTRACE_NREC < ring.head - ring.tail) {
+        ring.lost += ring.head - ring.tail - KTRACE_NREC;
+        ring.tail = ring.head - KTRACE_NREC;
+    }
+
+    while (ring.tail != ring.head && (cnt + 1) * sizeof(*out) <= bufsz)
+        out[cnt++] = ring.rec[ring.tail++ % KTRACE_NREC];
+
+    restore_interrupts(pie);
+
+    return cnt * sizeof(*out);
+}
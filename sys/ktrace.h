@@ -0,0 +1,57 @@
+// ktrace.h - Kernel trace ring buffer
+//
+// Copyright (c) 2024-2025 University of Illinois
+// SPDX-License-identifier: NCSA
+//
+
+#ifndef _KTRACE_H_
+#define _KTRACE_H_
+
+#include <stdint.h>
+
+// Tracepoints record fixed-size binary events, stamped with rdtime(), into a
+// ring buffer in memory. They are compiled in only when the kernel is built
+// with -DKTRACE; otherwise ktrace() expands to nothing and its arguments are
+// not evaluated. The ring keeps the most recent KTRACE_NREC events and is read
+// out through the "ktrace" device (see usr/ktdump.c and util/ktrace).
+//
+// The record layout and event numbers are also used by util/ktrace/ktdecode.c.
+
+#define KT_SYSCALL_ENTER    1 // a0 = syscall number, a1 = first argument
+#define KT_SYSCALL_EXIT     2 // a0 = syscall number, a1 = result
+#define KT_SWITCH           3 // a0 = tid switched from, a1 = tid switched to
+#define KT_CACHE_HIT        4 // a1 = block position
+#define KT_CACHE_MISS       5 // a1 = block position
+#define KT_VIOBLK_SUBMIT    6 // a0 = request slot, a1 = disk position
+#define KT_VIOBLK_DONE      7 // a0 = request slot, a1 = bytes transferred
+#define KT_PAGE_FAULT       8 // a0 = 1 if copy-on-write, a1 = address
+
+struct ktrace_rec {
+    uint64_t time; // rdtime() when recorded
+    uint16_t type; // KT_*
+    uint16_t tid; // running thread
+    uint32_t a0;
+    uint64_t a1;
+};
+
+#ifdef KTRACE
+#define ktrace(type, a0, a1) ktrace_record((type), (a0), (a1))
+#else
+#define ktrace(type, a0, a1) do {} while(0)
+#endif
+
+// EXPORTED FUNCTION DECLARATIONS
+//
+
+// Appends an event to the ring, overwriting the oldest one if it is full. May
+// be called from an ISR.
+
+extern void ktrace_record(int type, uint32_t a0, uint64_t a1);
+
+// Registers the "ktrace" device. Each read takes the oldest events still in
+// the ring, as whole struct ktrace_rec records, and returns 0 once the ring is
+// empty.
+
+extern void ktrace_attach(void);
+
+#endif // _KTRACE_H_
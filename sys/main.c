@@ -13,7 +13,13 @@
 #include "intr.h"
 #include "dev/virtio.h"
 #include "heap.h"
+#include "work.h"
 #include "string.h"
+#include "ktrace.h"
+
+#ifdef RVV
+#include "vec.h"
+#endif
 
 #define VIRTIO_MMIO_STEP (VIRTIO1_MMIO_BASE-VIRTIO0_MMIO_BASE)
 extern char _kimg_end[]; 
@@ -29,11 +35,15 @@ void main(void) {
 
     
     console_init();
+#ifdef RVV
+    vec_init();
+#endif
     devmgr_init();
     intrmgr_init();
     thrmgr_init();
     memory_init();
     procmgr_init();
+    workmgr_init();
 
 
     
@@ -42,6 +52,7 @@ void main(void) {
         uart_attach((void*)UART_MMIO_BASE(i), UART0_INTR_SRCNO+i);
         
     rtc_attach((void*)RTC_MMIO_BASE);
+    ktrace_attach();
 
     for (i = 0; i < 8; i++) {
         virtio_attach ((void*)VIRTIO0_MMIO_BASE + i*VIRTIO_MMIO_STEP, VIRTIO0_INTR_SRCNO + i);
@@ -0,0 +1,356 @@
+// main_bench.c - Kernel microbenchmarks (make bench)
+//
+// Copyright (c) 2024-2025 University of Illinois
+// SPDX-License-identifier: NCSA
+//
+
+// Boots the kernel far enough to have threads, memory, the block device and
+// the block cache, times a set of hot kernel paths, and halts. Each result is
+// printed as one line of the form
+//
+//     BENCH name=<name> ops=<n> cycles_per_op=<c> ns_per_op=<t> ops_per_sec=<r>
+//
+// so that runs can be compared with grep and diff. The block device tests
+// write back exactly the data they read, so the disk image is left unchanged.
+
+#include "conf.h"
+#include "console.h"
+#include "assert.h"
+#include "thread.h"
+#include "process.h"
+#include "memory.h"
+#include "heap.h"
+#include "cache.h"
+#include "io.h"
+#include "device.h"
+#include "intr.h"
+#include "riscv.h"
+#include "string.h"
+#include "work.h"
+#include "see.h"
+#include "dev/rtc.h"
+#include "dev/uart.h"
+#include "dev/virtio.h"
+
+// COMPILE-TIME PARAMETERS
+//
+
+#ifndef BENCH_NITER
+#define BENCH_NITER 1000
+#endif
+
+// Number of blocks the cache-miss test cycles through. It must be larger than
+// the cache so that every access misses.
+
+#ifndef BENCH_MISS_NBLKS
+#define BENCH_MISS_NBLKS 256
+#endif
+
+#ifndef BENCH_NPAGES
+#define BENCH_NPAGES 64
+#endif
+
+// INTERNAL CONSTANT DEFINITIONS
+//
+
+#define VIRTIO_MMIO_STEP (VIRTIO1_MMIO_BASE-VIRTIO0_MMIO_BASE)
+#define NUM_UARTS 3
+
+#define BLKBUF_SIZE (64*1024)
+
+// INTERNAL TYPE DEFINITIONS
+//
+
+struct bench_timer {
+    unsigned long long cycle;
+    unsigned long long time;
+};
+
+// INTERNAL FUNCTION DECLARATIONS
+//
+
+static void bench_start(struct bench_timer * t);
+static void bench_stop(struct bench_timer * t, const char * name, long ops);
+
+static void bench_switch(void);
+static void bench_lock(void);
+static void bench_kmalloc(void);
+static void bench_phys_page(void);
+static void bench_map_page(void);
+static void bench_cache(struct io * blkio);
+static void bench_vioblk(struct io * blkio);
+static void bench_pipe(void);
+
+static void yielder(void);
+static void pipe_echo(struct io * rio, struct io * wio);
+
+// INTERNAL GLOBAL VARIABLES
+//
+
+static char blkbuf[BLKBUF_SIZE];
+
+// EXPORTED FUNCTION DEFINITIONS
+//
+
+void main(void) {
+    struct io * blkio;
+    int result;
+    int i;
+
+    console_init();
+    devmgr_init();
+    intrmgr_init();
+    thrmgr_init();
+    memory_init();
+    procmgr_init();
+    workmgr_init();
+
+    for (i = 0; i < NUM_UARTS; i++)
+        uart_attach((void*)UART_MMIO_BASE(i), UART0_INTR_SRCNO+i);
+
+    rtc_attach((void*)RTC_MMIO_BASE);
+
+    for (i = 0; i < 8; i++)
+        virtio_attach ((void*)VIRTIO0_MMIO_BASE + i*VIRTIO_MMIO_STEP, VIRTIO0_INTR_SRCNO + i);
+
+    enable_interrupts();
+
+    result = open_device("vioblk", 0, &blkio);
+    if (result < 0) {
+        kprintf("Error: %d\n", result);
+        panic("Failed to open vioblk\n");
+    }
+
+    kprintf("BENCH start niter=%d timer_freq=%lu\n", BENCH_NITER, TIMER_FREQ);
+
+    bench_switch();
+    bench_lock();
+    bench_kmalloc();
+    bench_phys_page();
+    bench_map_page();
+    bench_cache(blkio);
+    bench_vioblk(blkio);
+    bench_pipe();
+
+    kprintf("BENCH done\n");
+    ioclose(blkio);
+    console_flush();
+    halt_success();
+}
+
+// INTERNAL FUNCTION DEFINITIONS
+//
+
+void bench_start(struct bench_timer * t) {
+    t->time = rdtime();
+    t->cycle = rdcycle();
+}
+
+void bench_stop(struct bench_timer * t, const char * name, long ops) {
+    const unsigned long long cycles = rdcycle() - t->cycle;
+    const unsigned long long ticks = rdtime() - t->time;
+
+    kprintf("BENCH name=%s ops=%ld cycles_per_op=%llu ns_per_op=%llu "
+        "ops_per_sec=%llu\n", name, ops, cycles / ops,
+        ticks * (1000000000UL / TIMER_FREQ) / ops,
+        (ticks != 0) ? ops * TIMER_FREQ / ticks : 0ULL);
+}
+
+// Two threads yield to each other, so each yield is one switch.
+
+void bench_switch(void) {
+    struct bench_timer t;
+    int tid;
+    int i;
+
+    tid = thread_spawn("yielder", &yielder);
+    assert (0 < tid);
+    thread_yield(); // let it start
+
+    bench_start(&t);
+    for (i = 0; i < BENCH_NITER; i++)
+        thread_yield();
+    bench_stop(&t, "ctxswitch", 2 * BENCH_NITER);
+
+    thread_join(tid);
+}
+
+void bench_lock(void) {
+    struct bench_timer t;
+    struct lock lock;
+    int i;
+
+    lock_init(&lock);
+
+    bench_start(&t);
+    for (i = 0; i < BENCH_NITER; i++) {
+        lock_acquire(&lock);
+        lock_release(&lock);
+    }
+    bench_stop(&t, "lock", BENCH_NITER);
+}
+
+void bench_kmalloc(void) {
+    struct bench_timer t;
+    void * p;
+    int i;
+
+    bench_start(&t);
+    for (i = 0; i < BENCH_NITER; i++) {
+        p = kmalloc(64);
+        assert (p != NULL);
+        kfree(p);
+    }
+    bench_stop(&t, "kmalloc_kfree", BENCH_NITER);
+}
+
+void bench_phys_page(void) {
+    struct bench_timer t;
+    void * pp;
+    int i;
+
+    bench_start(&t);
+    for (i = 0; i < BENCH_NITER; i++) {
+        pp = alloc_phys_page();
+        assert (pp != NULL);
+        free_phys_page(pp);
+    }
+    bench_stop(&t, "phys_page", BENCH_NITER);
+}
+
+// Maps BENCH_NPAGES fresh pages at consecutive user addresses. The first
+// mapping also allocates the page tables.
+
+void bench_map_page(void) {
+    static void * pages[BENCH_NPAGES];
+    struct bench_timer t;
+    int i;
+
+    for (i = 0; i < BENCH_NPAGES; i++) {
+        pages[i] = alloc_phys_page();
+        assert (pages[i] != NULL);
+    }
+
+    bench_start(&t);
+    for (i = 0; i < BENCH_NPAGES; i++)
+        map_page(UMEM_START_VMA + i * PAGE_SIZE, pages[i], MAP_RWUG);
+    bench_stop(&t, "map_page", BENCH_NPAGES);
+
+    unmap_and_free_range((void*)UMEM_START_VMA, BENCH_NPAGES * PAGE_SIZE);
+}
+
+void bench_cache(struct io * blkio) {
+    struct bench_timer t;
+    struct cache * cache;
+    void * blk;
+    int result;
+    int i;
+
+    result = create_cache(blkio, &cache);
+    assert (result == 0);
+
+    cache_get_block(cache, 0, &blk);
+    cache_release_block(cache, blk, CACHE_CLEAN);
+
+    bench_start(&t);
+    for (i = 0; i < BENCH_NITER; i++) {
+        cache_get_block(cache, 0, &blk);
+        cache_release_block(cache, blk, CACHE_CLEAN);
+    }
+    bench_stop(&t, "cache_hit", BENCH_NITER);
+
+    bench_start(&t);
+    for (i = 0; i < BENCH_MISS_NBLKS; i++) {
+        cache_get_block(cache, (i + 1) * CACHE_BLKSZ, &blk);
+        cache_release_block(cache, blk, CACHE_CLEAN);
+    }
+    bench_stop(&t, "cache_miss", BENCH_MISS_NBLKS);
+}
+
+// Each size is read and then written back at the same, size-aligned positions
+// within the first BLKBUF_SIZE bytes of the disk.
+
+void bench_vioblk(struct io * blkio) {
+    static const struct {
+        const char * rdname;
+        const char * wrname;
+        long size;
+        int niter;
+    } sizes[] = {
+        { "vioblk_read_512", "vioblk_write_512", 512, 256 },
+        { "vioblk_read_4k", "vioblk_write_4k", 4096, 64 },
+        { "vioblk_read_64k", "vioblk_write_64k", 64*1024, 16 }
+    };
+
+    struct bench_timer t;
+    unsigned long long pos;
+    long result;
+    int s, i;
+
+    result = ioreadat(blkio, 0, blkbuf, BLKBUF_SIZE);
+    assert (result == BLKBUF_SIZE);
+
+    for (s = 0; s < sizeof(sizes)/sizeof(sizes[0]); s++) {
+        bench_start(&t);
+        for (i = 0; i < sizes[s].niter; i++) {
+            pos = (i * sizes[s].size) % BLKBUF_SIZE;
+            result = ioreadat(blkio, pos, blkbuf + pos, sizes[s].size);
+            assert (result == sizes[s].size);
+        }
+        bench_stop(&t, sizes[s].rdname, sizes[s].niter);
+
+        bench_start(&t);
+        for (i = 0; i < sizes[s].niter; i++) {
+            pos = (i * sizes[s].size) % BLKBUF_SIZE;
+            result = iowriteat(blkio, pos, blkbuf + pos, sizes[s].size);
+            assert (result == sizes[s].size);
+        }
+        bench_stop(&t, sizes[s].wrname, sizes[s].niter);
+    }
+}
+
+// One byte goes to an echo thread through one pipe and comes back through
+// another; each round trip includes two switches.
+
+void bench_pipe(void) {
+    struct io * wio[2];
+    struct io * rio[2];
+    struct bench_timer t;
+    char c = 'x';
+    int tid;
+    int i;
+
+    create_pipe(&wio[0], &rio[0]);
+    create_pipe(&wio[1], &rio[1]);
+
+    tid = thread_spawn("pipe_echo",
+        (void (*)(void))&pipe_echo, rio[0], wio[1]);
+    assert (0 < tid);
+
+    bench_start(&t);
+    for (i = 0; i < BENCH_NITER; i++) {
+        iowrite(wio[0], &c, 1);
+        ioread(rio[1], &c, 1);
+    }
+    bench_stop(&t, "pipe_roundtrip", BENCH_NITER);
+
+    ioclose(wio[0]); // echo thread sees end of file and exits
+    thread_join(tid);
+    ioclose(rio[0]);
+    ioclose(wio[1]);
+    ioclose(rio[1]);
+}
+
+void yielder(void) {
+    int i;
+
+    for (i = 0; i < BENCH_NITER; i++)
+        thread_yield();
+}
+
+void pipe_echo(struct io * rio, struct io * wio) {
+    char c;
+
+    while (ioread(rio, &c, 1) == 1)
+        iowrite(wio, &c, 1);
+}
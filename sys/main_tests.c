@@ -74,6 +74,8 @@
 #include "intr.h"
 #include "dev/virtio.h"
 #include "ktfs.h"
+#include "memory.h"
+#include "shm.h"
 
 
 // Basic memio test
@@ -298,12 +300,48 @@ void test_elf(){
     thread_join(0);
 }
 
+// Attaches a shared memory segment in a fresh memory space, then closes the
+// descriptor and discards the space the way process_free does when a process
+// exits. Every page (segment, page tables and root) must come back.
+
+void test_shm_teardown(){
+    unsigned long before;
+    struct io * shmio;
+    mtag_t prev, mtag;
+
+    if (!memory_initialized)
+        memory_init();
+
+    before = free_phys_page_count();
+
+    mtag = create_mspace();
+    assert(mtag != 0);
+    prev = switch_mspace(mtag);
+
+    if (shm_create(3 * PAGE_SIZE, &shmio) < 0)
+        panic("shm_create failed");
+    if (shm_attach(shmio, UMEM_START_VMA) < 0)
+        panic("shm_attach failed");
+
+    *(volatile int *)UMEM_START_VMA = 1; // touch the segment
+
+    ioclose(shmio);
+    discard_mspace(mtag);
+    switch_mspace(prev);
+
+    if (free_phys_page_count() != before)
+        panic("shm pages leaked");
+
+    kprintf("test_shm_teardown: PASSED\n");
+}
+
 
 int main() {
     //console_init();
     //heap_init(_kimg_end, UMEM_START); 
 
     test_ktfs_create();
+    test_shm_teardown();
     //test_elf();
 
     return 0;
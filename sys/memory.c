@@ -23,6 +23,11 @@
 #include "thread.h"
 #include "process.h"
 #include "error.h"
+#include "ktrace.h"
+
+#ifdef RVV
+#include "vec.h"
+#endif
 
 // COMPILE-TIME CONFIGURATION
 //
@@ -33,12 +38,36 @@
 #define HEAP_INIT_MIN 256
 #endif
 
+// zero_page and copy_page work through a page one cache line of
+// PAGE_LINE_SIZE bytes at a time. With ZICBOZ (see Makefile), zero_page uses
+// cbo.zero instead, which clears a whole cache block without fetching it;
+// ZICBOZ_BLOCK_SIZE must then match the hart's block size.
+
+#ifndef PAGE_LINE_SIZE
+#define PAGE_LINE_SIZE 64
+#endif
+
+#ifndef ZICBOZ_BLOCK_SIZE
+#define ZICBOZ_BLOCK_SIZE 64
+#endif
+
 // INTERNAL CONSTANT DEFINITIONS
 //
 
 #define MEGA_SIZE ((1UL << 9) * PAGE_SIZE) // megapage size
 #define GIGA_SIZE ((1UL << 9) * MEGA_SIZE) // gigapage size
 
+// The two RSW bits of a PTE are available to the kernel. PTE_RSW_COW marks a
+// user page that was writable but has been made read-only because it is
+// shared; the first write to it makes a private copy.
+
+#define PTE_RSW_COW 1
+
+// PTE_RSW_SHARED marks a user page mapped by map_shared_range. Fork shares such
+// pages writable instead of making them copy-on-write.
+
+#define PTE_RSW_SHARED 2
+
 #define PTE_ORDER 3
 #define PTE_CNT (1U << (PAGE_ORDER - PTE_ORDER))
 
@@ -142,6 +171,7 @@ static inline uint16_t vpn_l2(uintptr_t v) { return (v >> 30) & 0x1FF; }
 static inline uint16_t vpn_l1(uintptr_t v) { return (v >> 21) & 0x1FF; }
 static inline uint16_t vpn_l0(uintptr_t v) { return (v >> 12) & 0x1FF; }
 static inline struct pte *walk_create(uintptr_t vma, int alloc);
+static void free_user_ptabs(struct pte *pt2);
 
 
 // INTERNAL GLOBAL VARIABLES
@@ -160,6 +190,11 @@ static struct pte main_pt0_0x80000[PTE_CNT]
 
 static struct page_chunk * free_chunk_list;
 
+// Extra references for each page of RAM, indexed by page number from
+// RAM_START. Zero means the page has a single owner (or is free).
+
+static uint16_t * page_extra_refs;
+
 // EXPORTED FUNCTION DECLARATIONS
 // 
 
@@ -266,6 +301,12 @@ void memory_init(void) {
     uintptr_t free_start = ROUND_UP((uintptr_t)heap_end, PAGE_SIZE);
     uintptr_t free_end   = (uintptr_t)RAM_END;
 
+    // The page reference counts come off the front of the free pool.
+
+    page_extra_refs = (uint16_t *)free_start;
+    memset(page_extra_refs, 0, (RAM_SIZE / PAGE_SIZE) * sizeof(uint16_t));
+    free_start += ROUND_UP((RAM_SIZE / PAGE_SIZE) * sizeof(uint16_t), PAGE_SIZE);
+
     if (free_end <= free_start)
         panic("no free RAM for page allocator");
 
@@ -300,47 +341,73 @@ void memory_init(void) {
 //     return new_pt2;
 // }
 
+// Clones the active space for fork. Everything outside user memory is shared
+// with the main space. User memory gets its own page tables, but the pages
+// themselves are shared: writable pages become copy-on-write in both spaces
+// and read-only pages are simply shared, each with an extra reference. If a
+// page table cannot be allocated, the partial clone is torn down and NULL is
+// returned. Pages already made copy-on-write in the active space stay so; the
+// next write simply takes them back.
+
 static struct pte *clone_root(void) {
     struct pte *old_l2 = active_space_ptab();
     struct pte *new_l2 = alloc_phys_page();
     if (!new_l2) return NULL;
-    memset(new_l2, 0, PAGE_SIZE);
-
-    int kern_idx = vpn_l2((uintptr_t)RAM_START);
-    // Copy kernel half of L2 table
-    memcpy(&new_l2[kern_idx],
-           &old_l2[kern_idx],
-           (PTE_CNT - kern_idx) * sizeof(struct pte));
-
-    // Clone user half
-    for (int i = 0; i < kern_idx; i++) {
-        struct pte e = old_l2[i];
-        if (!PTE_VALID(e) || PTE_LEAF(e))
-            continue;
 
-        struct pte *old_l1 = pageptr(e.ppn);
-        struct pte *new_l1 = alloc_phys_page();
-        if (!new_l1) continue;
-        memset(new_l1, 0, PAGE_SIZE);
+    // Fill in every top-level entry first, so that a partial clone can be
+    // walked by free_user_ptabs.
 
-        for (int j = 0; j < PTE_CNT; j++) {
-            struct pte le = old_l1[j];
-            if (!PTE_VALID(le) || !PTE_LEAF(le)) continue;
+    for (int i = 0; i < PTE_CNT; i++) {
+        if (i < vpn_l2(UMEM_START_VMA) || vpn_l2(UMEM_END_VMA - 1) < i)
+            new_l2[i] = old_l2[i];
+        else
+            new_l2[i] = null_pte();
+    }
 
-            void *old_page = pageptr(le.ppn);
-            void *new_page = alloc_phys_page();
-            if (!new_page) continue;
+    for (int i = vpn_l2(UMEM_START_VMA); i <= vpn_l2(UMEM_END_VMA - 1); i++) {
+        if (!PTE_VALID(old_l2[i]) || PTE_LEAF(old_l2[i]))
+            continue;
 
-            memcpy(new_page, old_page, PAGE_SIZE);
+        struct pte *old_l1 = pageptr(old_l2[i].ppn);
+        struct pte *new_l1 = alloc_phys_page();
+        if (!new_l1) goto fail;
+        zero_page(new_l1);
+        new_l2[i] = ptab_pte(new_l1, old_l2[i].flags & PTE_G);
 
-            new_l1[j] = leaf_pte(new_page,
-                                 le.flags & (PTE_R|PTE_W|PTE_X|PTE_U|PTE_G));
+        for (int j = 0; j < PTE_CNT; j++) {
+            if (!PTE_VALID(old_l1[j]) || PTE_LEAF(old_l1[j]))
+                continue;
+
+            struct pte *old_l0 = pageptr(old_l1[j].ppn);
+            struct pte *new_l0 = alloc_phys_page();
+            if (!new_l0) goto fail;
+            zero_page(new_l0);
+            new_l1[j] = ptab_pte(new_l0, old_l1[j].flags & PTE_G);
+
+            for (int k = 0; k < PTE_CNT; k++) {
+                if (!PTE_VALID(old_l0[k]) || !PTE_LEAF(old_l0[k]))
+                    continue;
+
+                if ((old_l0[k].flags & PTE_W) &&
+                    !(old_l0[k].rsw & PTE_RSW_SHARED))
+                {
+                    old_l0[k].flags &= ~PTE_W;
+                    old_l0[k].rsw |= PTE_RSW_COW;
+                }
+
+                new_l0[k] = old_l0[k];
+                page_addref(pageptr(old_l0[k].ppn));
+            }
         }
-
-        new_l2[i] = ptab_pte(new_l1, e.flags & PTE_G);
     }
 
+    sfence_vma();
     return new_l2;
+
+fail:
+    sfence_vma();
+    free_user_ptabs(new_l2);
+    return NULL;
 }
 
 
@@ -367,31 +434,67 @@ mtag_t clone_active_mspace(void) {
     return root ? ptab_to_satp(root) : 0;
 }
 
+mtag_t create_mspace(void) {
+    struct pte *new_l2 = alloc_phys_page();
+    int i;
+
+    if (!new_l2) return 0;
+
+    // Share every top-level entry of the main space except those that cover
+    // user memory, which start out empty and get their own subtables on the
+    // first map_page.
+
+    for (i = 0; i < PTE_CNT; i++) {
+        if (vpn_l2(UMEM_START_VMA) <= i && i <= vpn_l2(UMEM_END_VMA - 1))
+            new_l2[i] = null_pte();
+        else
+            new_l2[i] = main_pt2[i];
+    }
+
+    return ptab_to_satp(new_l2);
+}
+
 void reset_active_mspace(void) {
     csrw_satp(main_mtag);
     sfence_vma();
 }
 
 mtag_t discard_active_mspace(void) {
-    mtag_t cur = active_space_mtag();
-    if (cur == main_mtag) return cur;           /* kernel space */
+    return discard_mspace(active_space_mtag());
+}
+
+mtag_t discard_mspace(mtag_t mtag) {
+    if (mtag == main_mtag) return mtag;         /* kernel space */
+
+    struct pte *pt2 = mtag_to_ptab(mtag);
 
-    struct pte *pt2 = mtag_to_ptab(cur);
+    if (mtag == active_space_mtag())
+        reset_active_mspace();
+    free_user_ptabs(pt2);
+    return main_mtag;
+}
 
-    /* Walk user half and free subtables + leaves */
-    for (int i = 0; i < 256; ++i) {
+/* Walk user memory and free subtables + leaves. Leaves are released rather
+   than freed, since they may be shared with another space. The other
+   top-level entries are shared with the main space. The space must not be
+   active. */
+
+static void free_user_ptabs(struct pte *pt2) {
+    for (int i = vpn_l2(UMEM_START_VMA); i <= vpn_l2(UMEM_END_VMA - 1); ++i) {
         if (!PTE_VALID(pt2[i]) || PTE_LEAF(pt2[i])) continue;
         struct pte *pt1 = pageptr(pt2[i].ppn);
         for (int j = 0; j < PTE_CNT; ++j) {
             if (!PTE_VALID(pt1[j]) || PTE_LEAF(pt1[j])) continue;
-            free_phys_page(pageptr(pt1[j].ppn));
+            struct pte *pt0 = pageptr(pt1[j].ppn);
+            for (int k = 0; k < PTE_CNT; ++k) {
+                if (PTE_VALID(pt0[k]) && PTE_LEAF(pt0[k]))
+                    page_release(pageptr(pt0[k].ppn));
+            }
+            free_phys_page(pt0);
         }
         free_phys_page(pt1);
     }
     free_phys_page(pt2);
-
-    reset_active_mspace();
-    return main_mtag;
 }
 
 // The map_page() function maps a single page into the active address space at
@@ -427,7 +530,7 @@ static inline struct pte *walk_create(uintptr_t vma, int alloc) {
             if (!alloc) return NULL;
             void *new_pt = alloc_phys_page();
             if (!new_pt) return NULL;
-            memset(new_pt, 0, PAGE_SIZE);
+            zero_page(new_pt);
             *pte2 = ptab_pte((struct pte *)new_pt, PTE_G);  /* global   */
             sfence_vma();                                   /* flush tlb */
         }
@@ -445,7 +548,7 @@ static inline struct pte *walk_create(uintptr_t vma, int alloc) {
             if (!alloc) return NULL;
             void *new_pt = alloc_phys_page();
             if (!new_pt) return NULL;
-            memset(new_pt, 0, PAGE_SIZE);
+            zero_page(new_pt);
             *pte1 = ptab_pte((struct pte *)new_pt, PTE_G);
             sfence_vma();
         }
@@ -525,11 +628,20 @@ void unmap_and_free_range(void * vp, size_t size) {
             continue;
         void *pp = pageptr(leaf->ppn);
         *leaf = null_pte();
-        free_phys_page(pp);
+        page_release(pp);
     }
     sfence_vma();
 }
 
+uintptr_t vma_to_pma(uintptr_t vma) {
+    struct pte *leaf = walk_create(vma, 0);
+
+    if (!leaf || !PTE_VALID(*leaf) || !(leaf->flags & PTE_U))
+        return 0;
+
+    return (uintptr_t)pageptr(leaf->ppn) | (vma & (PAGE_SIZE - 1));
+}
+
 void * alloc_phys_page(void) {
     return alloc_phys_pages(1);
 }
@@ -537,6 +649,60 @@ void * alloc_phys_page(void) {
 void free_phys_page(void * pp) {
     free_phys_pages(pp, 1);
 }
+
+void zero_page(void * pp) {
+    unsigned long * p = pp;
+    unsigned long * const end = pp + PAGE_SIZE;
+
+    assert (((uintptr_t)pp & (PAGE_SIZE - 1)) == 0);
+
+#ifdef ZICBOZ
+    // cbo.zero (p), spelled out so that the assembler need not know Zicboz
+
+    for (; p < end; p += ZICBOZ_BLOCK_SIZE / sizeof(*p))
+        asm volatile (".insn i 0x0f, 2, x0, %0, 4" :: "r" (p) : "memory");
+#else
+#ifdef RVV
+    if (vec_usable(PAGE_SIZE)) {
+        vec_memset(pp, 0, PAGE_SIZE);
+        return;
+    }
+#endif
+
+    for (; p < end; p += PAGE_LINE_SIZE / sizeof(*p)) {
+        p[0] = 0; p[1] = 0; p[2] = 0; p[3] = 0;
+        p[4] = 0; p[5] = 0; p[6] = 0; p[7] = 0;
+    }
+#endif
+}
+
+// Each iteration loads a whole line before storing any of it, so the loads
+// of one line are not held up behind the stores to the other page.
+
+void copy_page(void * dst, const void * src) {
+    unsigned long * d = dst;
+    const unsigned long * s = src;
+    unsigned long * const end = dst + PAGE_SIZE;
+    unsigned long w0, w1, w2, w3, w4, w5, w6, w7;
+
+    assert ((((uintptr_t)dst | (uintptr_t)src) & (PAGE_SIZE - 1)) == 0);
+
+#ifdef RVV
+    if (vec_usable(PAGE_SIZE)) {
+        vec_memcpy(dst, src, PAGE_SIZE);
+        return;
+    }
+#endif
+
+    for (; d < end; d += PAGE_LINE_SIZE / sizeof(*d),
+        s += PAGE_LINE_SIZE / sizeof(*s))
+    {
+        w0 = s[0]; w1 = s[1]; w2 = s[2]; w3 = s[3];
+        w4 = s[4]; w5 = s[5]; w6 = s[6]; w7 = s[7];
+        d[0] = w0; d[1] = w1; d[2] = w2; d[3] = w3;
+        d[4] = w4; d[5] = w5; d[6] = w6; d[7] = w7;
+    }
+}
 // TODO: heap_free(best) needs to be done
 void * alloc_phys_pages(unsigned int cnt) {
     if (cnt == 0) return NULL;
@@ -595,16 +761,196 @@ unsigned long free_phys_page_count(void) {
     return total;
 }
 
+void page_addref(void * pp) {
+    uintptr_t const idx = pagenum(pp) - pagenum(RAM_START);
+
+    assert (RAM_START <= pp && pp < RAM_END);
+    assert (page_extra_refs[idx] < UINT16_MAX);
+    page_extra_refs[idx] += 1;
+}
+
+void page_release(void * pp) {
+    uintptr_t const idx = pagenum(pp) - pagenum(RAM_START);
+
+    assert (RAM_START <= pp && pp < RAM_END);
+
+    if (page_extra_refs[idx] != 0)
+        page_extra_refs[idx] -= 1;
+    else
+        free_phys_page(pp);
+}
+
+unsigned int page_refcnt(const void * pp) {
+    return page_extra_refs[pagenum(pp) - pagenum(RAM_START)] + 1;
+}
+
+void * cow_share_page(uintptr_t vma) {
+    struct pte * const leaf = walk_create(vma, 0);
+    void * pp;
+
+    if (!leaf || !PTE_VALID(*leaf) || !(leaf->flags & PTE_U))
+        return NULL;
+
+    if (!(leaf->flags & PTE_W) && !(leaf->rsw & PTE_RSW_COW))
+        return NULL;
+
+    // A page of a shared segment must stay writable for the other sharers.
+
+    if (leaf->rsw & PTE_RSW_SHARED)
+        return NULL;
+
+    pp = pageptr(leaf->ppn);
+    leaf->flags &= ~PTE_W;
+    leaf->rsw |= PTE_RSW_COW;
+    page_addref(pp);
+    sfence_vma();
+    return pp;
+}
+
+int cow_map_page(uintptr_t vma, void * pp) {
+    struct pte * leaf;
+
+    if (vma < UMEM_START_VMA || UMEM_END_VMA - PAGE_SIZE < vma)
+        return -EINVAL;
+
+    // Only a private, writable (or copy-on-write) data page may be replaced.
+    // Anything else, including pages of a shared segment, is left to the
+    // caller to copy into.
+
+    leaf = walk_create(vma, 0);
+
+    if (!leaf || !PTE_VALID(*leaf) || !(leaf->flags & PTE_U) ||
+        (leaf->flags & PTE_X) || (leaf->rsw & PTE_RSW_SHARED))
+        return -EINVAL;
+
+    if (!(leaf->flags & PTE_W) && !(leaf->rsw & PTE_RSW_COW))
+        return -EINVAL;
+
+    page_release(pageptr(leaf->ppn));
+
+    if (page_refcnt(pp) == 1)
+        *leaf = leaf_pte(pp, MAP_RWUG);
+    else {
+        *leaf = leaf_pte(pp, MAP_RWUG & ~PTE_W);
+        leaf->rsw = PTE_RSW_COW;
+    }
+
+    sfence_vma();
+    return 0;
+}
+
+int cow_fault(uintptr_t vma) {
+    struct pte * const leaf = walk_create(ROUND_DOWN(vma, PAGE_SIZE), 0);
+    void * pp;
+    void * copy;
+
+    if (!leaf || !PTE_VALID(*leaf) || !(leaf->rsw & PTE_RSW_COW))
+        return 0;
+
+    ktrace(KT_PAGE_FAULT, 1, vma);
+    pp = pageptr(leaf->ppn);
+
+    // If the other owners have let go, the page can simply be made writable
+    // again. Otherwise, make a private copy.
+
+    if (page_refcnt(pp) != 1) {
+        copy = alloc_phys_page();
+        if (copy == NULL)
+            return 0;
+        copy_page(copy, pp);
+        page_release(pp);
+        leaf->ppn = pagenum(copy);
+    }
+
+    leaf->flags |= PTE_W;
+    leaf->rsw &= ~PTE_RSW_COW;
+    sfence_vma();
+    return 1;
+}
+
+int map_shared_range (
+    uintptr_t vma, size_t size, void * pp, int rwxug_flags)
+{
+    struct pte * leaf;
+    size_t off;
+
+    size = ROUND_UP(size, PAGE_SIZE);
+
+    if ((vma & (PAGE_SIZE - 1)) || ((uintptr_t)pp & (PAGE_SIZE - 1)))
+        return -EINVAL;
+
+    for (off = 0; off < size; off += PAGE_SIZE) {
+        leaf = walk_create(vma + off, 0);
+        if (leaf && PTE_VALID(*leaf))
+            return -EBUSY;
+    }
+
+    for (off = 0; off < size; off += PAGE_SIZE) {
+        leaf = walk_create(vma + off, 1);
+        if (!leaf) {
+            unmap_shared_range(vma, off, pp);
+            return -ENOMEM;
+        }
+
+        *leaf = leaf_pte(pp + off, rwxug_flags);
+        leaf->rsw = PTE_RSW_SHARED;
+        page_addref(pp + off);
+    }
+
+    sfence_vma();
+    return 0;
+}
+
+int unmap_shared_range(uintptr_t vma, size_t size, const void * pp) {
+    struct pte * leaf;
+    size_t off;
+
+    size = ROUND_UP(size, PAGE_SIZE);
+
+    for (off = 0; off < size; off += PAGE_SIZE) {
+        leaf = walk_create(vma + off, 0);
+        if (!leaf || !PTE_VALID(*leaf) || !(leaf->rsw & PTE_RSW_SHARED) ||
+            pageptr(leaf->ppn) != pp + off)
+        {
+            return -EINVAL;
+        }
+    }
+
+    for (off = 0; off < size; off += PAGE_SIZE) {
+        leaf = walk_create(vma + off, 0);
+        *leaf = null_pte();
+        page_release((void *)pp + off);
+    }
+
+    sfence_vma();
+    return 0;
+}
+
+int vma_is_shared(uintptr_t vma) {
+    struct pte * const leaf = walk_create(ROUND_DOWN(vma, PAGE_SIZE), 0);
+
+    return (leaf && PTE_VALID(*leaf) && (leaf->rsw & PTE_RSW_SHARED));
+}
+
 int handle_umode_page_fault(struct trap_frame * tfr, uintptr_t vma) {
+    struct pte * leaf;
+
     /* Only handle faults below the kernel base and 4‑KiB aligned */
     if (!wellformed(vma) || vma >= 0x400000000000UL)
         return 0;
 
     vma = ROUND_DOWN(vma, PAGE_SIZE);
+    ktrace(KT_PAGE_FAULT, 0, vma);
+
+    /* A fault on a mapped page is either a write to a copy-on-write page
+       or a genuine protection fault. */
+    leaf = walk_create(vma, 0);
+    if (leaf && PTE_VALID(*leaf))
+        return cow_fault(vma);
 
     void *pp = alloc_phys_page();
     if (!pp) return 0;
-    memset(pp, 0, PAGE_SIZE);
+    zero_page(pp);
 
     void *ret = map_page(vma, pp, MAP_RWUG);
     if ((intptr_t)ret < 0) {
@@ -54,10 +54,21 @@ extern mtag_t switch_mspace(mtag_t mtag);
 
 extern mtag_t clone_active_mspace(void);
 
+// Creates a memory space with the kernel mappings of the main memory space and
+// an empty user region. Returns 0 if out of memory.
+
+extern mtag_t create_mspace(void);
+
 extern void reset_active_mspace(void);
 
 extern mtag_t discard_active_mspace(void);
 
+// Frees the user part of the memory space _mtag_, releasing every page mapped
+// there, and returns the tag of the main memory space. If _mtag_ is the active
+// space, the main space is made active first.
+
+extern mtag_t discard_mspace(mtag_t mtag);
+
 extern void * map_page(uintptr_t vma, void * pp, int rwxug_flags);
 
 extern void * map_range (
@@ -70,6 +81,11 @@ extern void set_range_flags(const void * vp, size_t size, int rwxug_flags);
 
 extern void unmap_and_free_range(void * vp, size_t size);
 
+// Returns the physical address that _vma_ maps to in the active memory space,
+// or 0 if it is not mapped with user access.
+
+extern uintptr_t vma_to_pma(uintptr_t vma);
+
 extern void * alloc_phys_page(void);
 
 extern void free_phys_page(void * pp);
@@ -80,6 +96,55 @@ extern void free_phys_pages(void * pp, unsigned int cnt);
 
 extern unsigned long free_phys_page_count(void);
 
+// zero_page clears and copy_page copies one whole page. Both pointers must be
+// page-aligned. They are faster than memset and memcpy for this case and are
+// used by every page-granular path.
+
+extern void zero_page(void * pp);
+extern void copy_page(void * dst, const void * src);
+
+// A physical page from the free pool starts out with one owner. A page that is
+// mapped in more than one place (for example, a page handed from one process
+// to another through a pipe) gets an extra reference per additional owner.
+// page_release drops one reference and returns the page to the free pool when
+// the last one is gone. page_refcnt returns the number of owners.
+
+extern void page_addref(void * pp);
+extern void page_release(void * pp);
+extern unsigned int page_refcnt(const void * pp);
+
+// Copy-on-write sharing of user pages in the active memory space.
+//
+// cow_share_page makes the user page at _vma_ read-only and copy-on-write and
+// returns it with an extra reference for the caller, or returns NULL if _vma_
+// is not a mapped, writable user page.
+//
+// cow_map_page maps _pp_ at _vma_, taking over one of its references and
+// releasing the page mapped there before. The page is mapped writable only if
+// the caller holds the only reference. Fails with -EINVAL unless _vma_ is a
+// private, writable user data page, in which case the caller should copy.
+//
+// cow_fault resolves a write to a copy-on-write page at _vma_, copying the
+// page if it is still shared. Returns 1 if the fault was handled and 0 if
+// _vma_ is not a copy-on-write page.
+
+extern void * cow_share_page(uintptr_t vma);
+extern int cow_map_page(uintptr_t vma, void * pp);
+extern int cow_fault(uintptr_t vma);
+
+// map_shared_range maps the physically contiguous pages at _pp_ at _vma_ in the
+// active space, adding a reference to each. Shared mappings stay shared
+// (rather than becoming copy-on-write) across fork. Fails with -EBUSY if any
+// page in the range is already mapped. unmap_shared_range undoes it, after
+// checking that the range really maps those pages. vma_is_shared returns 1 if
+// _vma_ lies in such a mapping and 0 otherwise.
+
+extern int map_shared_range (
+    uintptr_t vma, size_t size, void * pp, int rwxug_flags);
+
+extern int unmap_shared_range(uintptr_t vma, size_t size, const void * pp);
+extern int vma_is_shared(uintptr_t vma);
+
 extern int handle_umode_page_fault (
     struct trap_frame * tfr, uintptr_t vma);
 
@@ -71,6 +71,7 @@ static void plic_disable_source_for_context (
 	uint_fast32_t ctxno, uint_fast32_t srcno);
 static void plic_set_context_threshold (
 	uint_fast32_t ctxno, uint_fast32_t level);
+static uint_fast32_t plic_get_context_threshold(uint_fast32_t ctxno);
 static uint_fast32_t plic_claim_context_interrupt (
 	uint_fast32_t ctxno);
 static void plic_complete_context_interrupt (
@@ -84,6 +85,15 @@ static void plic_disable_all_sources_for_context(uint_fast32_t ctxno);
 // contexts, so we only need to modify the high-level functions (plit_init,
 // plic_claim_request, plic_finish_request)to add support for multiple harts.
 
+// INTERNAL GLOBAL VARIABLE DEFINITIONS
+//
+
+// Context threshold in effect before each source was claimed. A claimed source
+// cannot be claimed again until it is completed, so one slot per source is
+// enough to unwind any nesting order.
+
+static uint8_t saved_threshold[PLIC_SRC_CNT];
+
 // EXPORTED FUNCTION DEFINITIONS
 // 
 
@@ -118,16 +128,46 @@ extern void plic_disable_source(int irqno) {
 		debug("plic_disable_irq called with irqno = %d", irqno);
 }
 
+////////////////////////////////////////////////////////////////////////////////
+// int plic_claim_interrupt(void)
+// Inputs: None
+// Outputs: int - srcno of the claimed interrupt, or 0 if none
+// Desc: claims the highest prio pending intr and raises the context threshold
+//       to that source's priority, so while its ISR runs only sources with a
+//       strictly higher prio can preempt it. The old threshold is remembered
+//       and put back by plic_finish_interrupt.
+// Side Effects: Modifies PLIC.ctx[ctxno].threshold
+////////////////////////////////////////////////////////////////////////////////
 extern int plic_claim_interrupt(void) {
+	uint_fast32_t srcno;
+
 	// FIXME: Hardwired S-mode hart 0
 	//trace("%s()", __func__);
-	return plic_claim_context_interrupt(CTX(0,1));
+	srcno = plic_claim_context_interrupt(CTX(0,1));
+
+	if (0 < srcno && srcno < PLIC_SRC_CNT) {
+		saved_threshold[srcno] = plic_get_context_threshold(CTX(0,1));
+		plic_set_context_threshold(CTX(0,1), PLIC.priority[srcno]);
+	}
+
+	return srcno;
 }
 
+////////////////////////////////////////////////////////////////////////////////
+// void plic_finish_interrupt(int irqno)
+// Inputs: int irqno - interrupt src that was just handled
+// Outputs: None
+// Desc: completes the intr and drops the context threshold back to what it
+//       was before the matching plic_claim_interrupt
+// Side Effects: Modifies PLIC.ctx[ctxno].threshold
+////////////////////////////////////////////////////////////////////////////////
 extern void plic_finish_interrupt(int irqno) {
 	// FIXME: Hardwired S-mode hart 0
 	//trace("%s(irqno=%d)", __func__, irqno);
 	plic_complete_context_interrupt(CTX(0,1), irqno);
+
+	if (0 < irqno && irqno < PLIC_SRC_CNT)
+		plic_set_context_threshold(CTX(0,1), saved_threshold[irqno]);
 }
 
 // INTERNAL FUNCTION DEFINITIONS
@@ -197,6 +237,18 @@ static inline void plic_set_context_threshold(uint_fast32_t ctxno, uint_fast32_t
 	if (ctxno >= PLIC_CTX_CNT || level > PLIC_PRIO_MAX) return;
 	PLIC.ctx[ctxno].threshold = level;//set level
 }
+
+////////////////////////////////////////////////////////////////////////////////
+// uint_fast32_t plic_get_context_threshold(uint_fast32_t ctxno)
+// Inputs: uint_fast32_t ctxno - which CPU/core context to read threshold for
+// Outputs: uint_fast32_t - current threshold, or 0 if ctxno is invalid
+// Desc: reads back PLIC.ctx[ctxno].threshold
+// Side Effects: None
+////////////////////////////////////////////////////////////////////////////////
+static inline uint_fast32_t plic_get_context_threshold(uint_fast32_t ctxno) {
+	if (ctxno >= PLIC_CTX_CNT) return 0;
+	return PLIC.ctx[ctxno].threshold;
+}
 ////////////////////////////////////////////////////////////////////////////////
 // uint_fast32_t plic_claim_context_interrupt(uint_fast32_t ctxno)
 // Inputs: uint_fast32_t ctxno - CPU/core context trying to claim an interrupt
@@ -18,6 +18,10 @@ extern void plic_init(void);
 extern void plic_enable_source(int srcno, int prio);
 extern void plic_disable_source(int srcno);
 
+// plic_claim_interrupt raises the context threshold to the priority of the
+// claimed source and plic_finish_interrupt restores it. In between, only
+// sources with a higher priority are delivered.
+
 extern int plic_claim_interrupt(void);
 extern void plic_finish_interrupt(int srcno);
 
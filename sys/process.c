@@ -43,9 +43,37 @@
 
 static int build_stack(void * stack, int argc, char ** argv);
 
+static char ** copy_args(int argc, char ** argv);
+
 
 static void fork_func(struct condition * forked, struct trap_frame * tfr);
 
+static void uthread_func(struct trap_frame * tfr);
+
+struct spawn_args;
+static void spawn_func(struct spawn_args * sa);
+
+static struct process * process_alloc(void);
+
+static void process_teardown(struct process * proc);
+
+static void process_free(struct process * proc);
+
+// INTERNAL TYPE DEFINITIONS
+//
+
+// Handed from process_spawn to the child's first thread. The parent waits on
+// _loaded_ until the child has finished with everything in here.
+
+struct spawn_args {
+    struct io * exeio;
+    int argc;
+    char ** argv; // kernel copy of the argument strings
+    struct condition loaded;
+    char done;
+    int result;
+};
+
 // INTERNAL GLOBAL VARIABLES
 //
 
@@ -70,7 +98,9 @@ void procmgr_init(void) {
     assert (!procmgr_initialized);
     main_proc.idx = 0;
     main_proc.tid = running_thread();
+    main_proc.ptid = -1; // nobody waits for the main process
     main_proc.mtag = active_mspace();
+    main_proc.thrcnt = 1;
     thread_set_process(main_proc.tid, &main_proc);
     procmgr_initialized = 1;
 
@@ -83,12 +113,42 @@ int process_exec(struct io *exeio, int argc, char **argv) {
     struct trap_frame *tfr;
     struct process *proc = running_thread_process();
  
+    char **kargv;
+    int stksz;
+
+    if (argc < 0 || (argc > 0 && !argv))
+        return -EINVAL;
+
+    // Other threads would keep running in the memory we're about to discard.
+    // Only AIO workers, which aio_shutdown stops, may be left.
+
+    if (proc->thrcnt - (proc->aio ? aio_nworkers(proc->aio) : 0) != 1)
+        return -EBUSY;
+
+    // The argument strings usually live on the user stack, whose page is
+    // about to be discarded and replaced, so copy them out first.
+
+    kargv = copy_args(argc, argv);
+    if (!kargv) return -ENOMEM;
+
+    // AIO workers use the ring and buffers in the memory we're about to
+    // discard, so they must be finished first.
+
+    aio_shutdown(proc);
+
     //reset_active_mspace();            //cp2
     discard_active_mspace();            //cp3
-    if (elf_load(exeio, &entry) != 0)return -EINVAL;
+    if (elf_load(exeio, &entry) != 0) {
+        kfree(kargv);
+        return -EINVAL;
+    }
     stack = alloc_and_map_range(UMEM_END_VMA - PAGE_SIZE, PAGE_SIZE, MAP_RWUG);
-    if (!stack) return -ENOMEM;
-    int stksz = build_stack(stack, argc, argv);
+    if (!stack) {
+        kfree(kargv);
+        return -ENOMEM;
+    }
+    stksz = build_stack(stack, argc, kargv);
+    kfree(kargv);
     if (stksz < 0)return stksz;
 
     tfr = kmalloc(sizeof(struct trap_frame));
@@ -103,9 +163,9 @@ int process_exec(struct io *exeio, int argc, char **argv) {
     tfr->sstatus = csrr_sstatus();   // enable user mode
     tfr->sstatus &= ~RISCV_SSTATUS_SPP;
     tfr->sstatus |= RISCV_SSTATUS_SPIE;
+    tfr->sstatus &= ~RISCV_SSTATUS_VS; // vector unit off until first use
     tfr->tp = running_thread_ptr();
     proc->mtag = active_mspace();
-    proc->tid = running_thread();
     trap_frame_jump(tfr, running_thread_ktp_anchor());
 }
 
@@ -113,17 +173,174 @@ int process_exec(struct io *exeio, int argc, char **argv) {
 void process_exit(void) {
     struct process *proc = running_thread_process();
     //if (!proc) panic("process_exit: no current process");
-    if (proc->tid == 0)
-        panic("Main process exited");
-    for (int i = 0; i < PROCESS_IOMAX; i++) {
-        if (proc->iotab[i]) {
-            ioclose(proc->iotab[i]);
-            proc->iotab[i] = NULL;
+
+    // Other threads of the process notice _exiting_ the next time they enter
+    // the kernel and end themselves; the last one out frees the process. Those
+    // already blocked in the kernel on something that may never happen are
+    // woken so they can do the same.
+
+    proc->exiting = 1;
+    thread_interrupt_process(proc);
+    aio_shutdown(proc);
+    process_thread_exit();
+}
+
+int process_spawn (
+    struct io * exeio, int argc, char ** argv, const int * fdmap)
+{
+    struct process *parent = running_thread_process();
+    struct process *child;
+    struct spawn_args sa;
+    int tid;
+    int i;
+
+    if (argc < 0 || (argc > 0 && !argv))
+        return -EINVAL;
+
+    // The child runs in a different memory space, so the argument strings have
+    // to be copied out of ours first.
+
+    sa.argv = copy_args(argc, argv);
+    if (!sa.argv) return -ENOMEM;
+
+    sa.exeio = exeio;
+    sa.argc = argc;
+    sa.done = 0;
+    sa.result = 0;
+    condition_init(&sa.loaded, "spawn_loaded");
+
+    child = process_alloc();
+    if (!child) {
+        kfree(sa.argv);
+        return -EMPROC;
+    }
+
+    child->mtag = create_mspace();
+    if (!child->mtag) {
+        proctab[child->idx] = NULL;
+        kfree(child);
+        kfree(sa.argv);
+        return -ENOMEM;
+    }
+
+    for (i = 0; i < PROCESS_IOMAX; i++) {
+        int pfd = fdmap ? fdmap[i] : i;
+        if (0 <= pfd && pfd < PROCESS_IOMAX && parent->iotab[pfd])
+            child->iotab[i] = ioaddref(parent->iotab[pfd]);
+    }
+
+    tid = thread_spawn("spawned", (void (*)(void))spawn_func, &sa);
+    if (tid < 0) {
+        process_teardown(child);
+        process_free(child);
+        kfree(sa.argv);
+        return tid;
+    }
+
+    child->tid = tid;
+    thread_set_process(tid, child);
+
+    // Wait for the child to load the image. If that fails, the child tears
+    // itself down; reap it and report the error.
+
+    while (!sa.done)
+        condition_wait(&sa.loaded);
+
+    kfree(sa.argv);
+
+    if (sa.result < 0) {
+        process_wait(tid);
+        return sa.result;
+    }
+
+    return tid;
+}
+
+int process_thread_create(uintptr_t entry, uintptr_t arg, uintptr_t stack) {
+    struct process *proc = running_thread_process();
+    struct trap_frame *tfr;
+    int tid;
+
+    if (entry < UMEM_START_VMA || UMEM_END_VMA <= entry)
+        return -EINVAL;
+    if (stack <= UMEM_START_VMA || UMEM_END_VMA < stack || (stack & 15))
+        return -EINVAL;
+
+    tfr = kmalloc(sizeof(struct trap_frame));
+    if (!tfr) return -ENOMEM;
+
+    memset(tfr, 0, sizeof(struct trap_frame));
+    tfr->a0 = arg;
+    tfr->sp = (void*)stack;
+    tfr->sepc = (void*)entry;
+    tfr->sstatus = csrr_sstatus();
+    tfr->sstatus &= ~RISCV_SSTATUS_SPP;
+    tfr->sstatus |= RISCV_SSTATUS_SPIE;
+    tfr->sstatus &= ~RISCV_SSTATUS_VS; // vector unit off until first use
+
+    tid = thread_spawn("uthread", (void (*)(void))uthread_func, tfr);
+    if (tid < 0) {
+        kfree(tfr);
+        return tid;
+    }
+
+    // The new thread shares our memory space and I/O table. It does not run
+    // until we yield, so this is set before it first switches in.
+
+    thread_set_process(tid, proc);
+    proc->thrcnt += 1;
+    return tid;
+}
+
+void process_thread_exit(void) {
+    struct process *proc = running_thread_process();
+
+    proc->thrcnt -= 1;
+    if (proc->thrcnt == 0)
+        process_teardown(proc);
+    else if (proc->aio && proc->thrcnt == aio_nworkers(proc->aio))
+        aio_stop(proc->aio); // only AIO workers are left
+    thread_exit();
+}
+
+int process_wait(int tid) {
+    struct process * child = NULL;
+    int result;
+    int i;
+
+    for (i = 0; i < NPROC; i++) {
+        if (proctab[i] && proctab[i]->ptid == running_thread() &&
+            (tid == 0 || proctab[i]->tid == tid))
+        {
+            child = proctab[i];
+            break;
         }
     }
-    proctab[proc->idx] = NULL;
-    kfree(proc);
-    thread_exit();  // 
+
+    if (!child)
+        return -EINVAL;
+
+    // The first thread may exit well before the rest of the process, so wait
+    // for the teardown rather than for that thread. Once torn down, the child
+    // has no threads left but the last one finishing thread_exit.
+
+    while (!child->exited) {
+        if (condition_wait_intr(&child->exited_cv) < 0)
+            return -EINTR;
+    }
+
+    result = thread_join(child->tid);
+    if (result < 0)
+        return result;
+
+    process_free(child);
+    return result;
+}
+
+int process_thread_join(int tid) {
+    if (tid <= 0 || thread_process(tid) != running_thread_process())
+        return -EINVAL;
+    return thread_join(tid);
 }
 
 // INTERNAL FUNCTION DEFINITIONS
@@ -141,7 +358,12 @@ int build_stack(void * stack, int argc, char ** argv) {
 
     if (PAGE_SIZE / sizeof(char*) - 1 < argc)
         return -ENOMEM;
-    
+
+    // The stack page comes straight from the free pool, so clear it first to
+    // keep old data from showing through to the new program.
+
+    zero_page(stack);
+
     stksz = (argc+1) * sizeof(char*);
 
     // Add the sizes of the null-terminated strings that argv[] points to.
@@ -180,6 +402,39 @@ int build_stack(void * stack, int argc, char ** argv) {
     return stksz;
 }
 
+// Returns a kernel copy of _argv_ (array and strings in one allocation, freed
+// with kfree), or NULL if it would not fit on a one-page initial stack or
+// memory is short.
+
+char ** copy_args(int argc, char ** argv) {
+    size_t argsz;
+    char ** kargv;
+    char * p;
+    int i;
+
+    if (PAGE_SIZE / sizeof(char*) - 1 < argc)
+        return NULL;
+
+    argsz = (argc + 1) * sizeof(char*);
+    for (i = 0; i < argc; i++) {
+        argsz += strlen(argv[i]) + 1;
+        if (PAGE_SIZE < argsz)
+            return NULL;
+    }
+
+    kargv = kmalloc(argsz);
+    if (!kargv) return NULL;
+    p = (char*)(kargv + argc + 1);
+    for (i = 0; i < argc; i++) {
+        argsz = strlen(argv[i]) + 1;
+        kargv[i] = p;
+        memcpy(p, argv[i], argsz);
+        p += argsz;
+    }
+    kargv[argc] = NULL;
+    return kargv;
+}
+
 // Forks a child process.
 
 // Creates a new process struct for the child, copies the parent's I/O objects and spawns a new thread for the child. 
@@ -202,9 +457,17 @@ int process_fork(const struct trap_frame * tfr) {
     }
     if (idx < 0) return -EMPROC;  // No available process slot
 
+    child->thrcnt = 1;
+    child->ptid = running_thread();
+    condition_init(&child->exited_cv, "process_exited");
+
     // Clone the current memory space for the child
     child->mtag = clone_active_mspace();
-    if (!child->mtag) return -ENOMEM;
+    if (!child->mtag) {
+        proctab[idx] = NULL;
+        kfree(child);
+        return -ENOMEM;
+    }
 
     // Copy I/O table from parent
     struct process *parent = running_thread_process();
@@ -216,13 +479,19 @@ int process_fork(const struct trap_frame * tfr) {
 
     // Allocate a condition variable on the heap for parent-child sync
     struct condition *done = kmalloc(sizeof(struct condition));
-    if (!done) return -ENOMEM;
+    if (!done) {
+        process_teardown(child);
+        process_free(child);
+        return -ENOMEM;
+    }
     condition_init(done, "fork_done");
 
     // Spawn the child thread with fork_func
     int tid = thread_spawn("forked", (void (*)(void))fork_func, done, tfr);
     if (tid < 0) {
         kfree(done);
+        process_teardown(child);
+        process_free(child);
         return tid;
     }
     // Link the thread to its process before it runs
@@ -236,11 +505,114 @@ int process_fork(const struct trap_frame * tfr) {
     return tid;
 }
 
+// Releases everything the process holds but its struct and proctab slot, and
+// wakes up its creator if it is waiting in process_wait.
+
+static void process_teardown(struct process * proc) {
+    if (proc == &main_proc)
+        panic("Main process exited");
+    for (int i = 0; i < PROCESS_IOMAX; i++) {
+        if (proc->iotab[i]) {
+            ioclose(proc->iotab[i]);
+            proc->iotab[i] = NULL;
+        }
+    }
+    if (proc->aio)
+        kfree(proc->aio); // workers have all exited
+
+    // Dropping our references to the user pages makes pages still shared
+    // copy-on-write with another process private to it again, and frees pages
+    // flipped to us through a pipe and our share of any attached segment.
+
+    proc->mtag = discard_mspace(proc->mtag);
+    proc->exited = 1;
+    condition_broadcast(&proc->exited_cv);
+}
+
+static void process_free(struct process * proc) {
+    proctab[proc->idx] = NULL;
+    kfree(proc);
+}
+
+static struct process * process_alloc(void) {
+    struct process *proc;
+    int i;
+
+    proc = kcalloc(1, sizeof(struct process));
+    if (!proc) return NULL;
+
+    for (i = 0; i < NPROC; i++) {
+        if (proctab[i] == NULL) {
+            proctab[i] = proc;
+            proc->idx = i;
+            proc->thrcnt = 1;
+            proc->ptid = running_thread();
+            condition_init(&proc->exited_cv, "process_exited");
+            return proc;
+        }
+    }
+
+    kfree(proc);
+    return NULL;
+}
+
+// Runs as the first thread of a spawned process, already in the child's memory
+// space. Loads the executable and drops into U mode like process_exec.
+
+static void spawn_func(struct spawn_args * sa) {
+    struct trap_frame tfr;
+    void (*entry)(void);
+    void * stack;
+    int result;
+    int argc;
+
+    result = elf_load(sa->exeio, &entry);
+    if (result == 0) {
+        stack = alloc_and_map_range(UMEM_END_VMA - PAGE_SIZE, PAGE_SIZE, MAP_RWUG);
+        if (stack)
+            result = build_stack(stack, sa->argc, sa->argv);
+        else
+            result = -ENOMEM;
+    }
+
+    // _sa_ lives on the parent's stack and must not be touched once the
+    // parent has been told we are done with it.
+
+    argc = sa->argc;
+    sa->result = (result < 0) ? result : 0;
+    sa->done = 1;
+    condition_broadcast(&sa->loaded);
+
+    if (result < 0)
+        process_thread_exit();
+
+    memset(&tfr, 0, sizeof(struct trap_frame));
+    tfr.a0 = argc;
+    tfr.a1 = UMEM_END_VMA - result; // argv pointer for user (result is stksz)
+    tfr.sp = (void*)tfr.a1;
+    tfr.sepc = (void *)entry;
+    tfr.sstatus = csrr_sstatus();
+    tfr.sstatus &= ~RISCV_SSTATUS_SPP;
+    tfr.sstatus |= RISCV_SSTATUS_SPIE;
+    tfr.sstatus &= ~RISCV_SSTATUS_VS;
+    tfr.tp = running_thread_ptr();
+    trap_frame_jump(&tfr, running_thread_ktp_anchor());
+}
+
+static void uthread_func(struct trap_frame * tfr) {
+    struct trap_frame thr_tfr = *tfr;
+    kfree(tfr);
+    thr_tfr.tp = running_thread_ptr();
+    thr_tfr.sstatus &= ~RISCV_SSTATUS_VS; // vector state is not shared
+    trap_frame_jump(&thr_tfr, running_thread_ktp_anchor());
+}
+
 static void fork_func(struct condition *done, struct trap_frame *tfr) {
     if (!done || !tfr) halt_failure();
     struct trap_frame child_tfr = *tfr;
     child_tfr.a0 = 0;  // fork returns 0 in the child
     child_tfr.tp = running_thread_ptr();  // update tp for the child thread
+    child_tfr.sstatus &= ~RISCV_SSTATUS_VS; // child starts without vector state
     condition_broadcast(done);  // Notify parent that copy is done
     trap_frame_jump(&child_tfr, running_thread_ktp_anchor());
 }
\ No newline at end of file
@@ -19,6 +19,7 @@
 #include "thread.h"
 #include "trap.h"
 #include "memory.h"
+#include "aio.h"
 
 // EXPORTED TYPE DEFINITIONS
 //
@@ -26,9 +27,15 @@
 
 struct process {
     int idx; // index into proctab
-    int tid; // thread id of our thread
+    int tid; // thread id of our first thread, which identifies us to _wait_
+    int ptid; // thread that created us, the only one that may wait for us
     mtag_t mtag; // memory space
     struct io * iotab[PROCESS_IOMAX]; // IO objects associated with current process
+    int thrcnt; // number of live threads sharing mtag and iotab
+    char exiting; // set by process_exit; other threads exit on next kernel entry
+    struct aioctx * aio; // asynchronous I/O state (aio.c), if set up
+    char exited; // torn down by the last thread; freed by process_wait
+    struct condition exited_cv; // signalled when _exited_ is set
 };
 
 // EXPORTED FUNCTION DECLARATIONS
@@ -44,10 +51,42 @@ extern int process_exec(struct io * exeio, int argc, char ** argv);
 
 
 extern int process_fork(const struct trap_frame * tfr);
+
+// Creates a new process running the executable _exeio_ in a fresh memory space,
+// without copying the caller's. Child descriptor i is a new reference to the
+// caller's descriptor fdmap[i], or closed if fdmap[i] is negative. If _fdmap_
+// is NULL, the child inherits all of the caller's descriptors. Returns the tid
+// of the child's thread (for _wait_) or a negative error code.
+
+extern int process_spawn (
+    struct io * exeio, int argc, char ** argv, const int * fdmap);
  
 
 extern void __attribute__ ((noreturn)) process_exit(void);
 
+// Starts a new thread in the current process. The thread enters U mode at
+// _entry_ with _arg_ in a0 and its stack pointer set to _stack_. Returns the
+// new thread's tid or a negative error code.
+
+extern int process_thread_create(uintptr_t entry, uintptr_t arg, uintptr_t stack);
+
+// Ends the calling thread. The process is torn down (I/O objects closed, memory
+// space discarded) when its last thread exits, and its struct and slot are
+// freed when its creator waits for it with process_wait.
+
+extern void __attribute__ ((noreturn)) process_thread_exit(void);
+
+// Waits for the process whose first thread is _tid_ (or for any process, if
+// _tid_ is 0) created by the calling thread to be torn down, that is, for all
+// of its threads to have exited and its descriptors and memory to have been
+// released, then frees it. Returns the child's tid or a negative error code.
+
+extern int process_wait(int tid);
+
+// Waits for a thread of the current process created by the caller to exit.
+
+extern int process_thread_join(int tid);
+
 
 
 static inline struct process * current_process(void);
@@ -123,6 +123,9 @@ static inline void csrc_sip(unsigned long mask) {
 #define RISCV_SSTATUS_SIE (1UL << 1)
 #define RISCV_SSTATUS_SPIE (1UL << 3)
 #define RISCV_SSTATUS_SPP (1UL << 8)
+#define RISCV_SSTATUS_VS_INITIAL (1UL << 9)
+#define RISCV_SSTATUS_VS_DIRTY (3UL << 9)
+#define RISCV_SSTATUS_VS (3UL << 9)
 #define RISCV_SSTATUS_SUM (1UL << 18)
 
 static inline unsigned long csrr_sstatus(void) {
@@ -190,13 +193,23 @@ static inline void sfence_vma(void) {
 static inline unsigned long long rdtime(void) {
 #if __riscv_xlen == 64
     unsigned long long time;
-    asm ("rdtime %0" : "=r"(time));
+    asm volatile ("rdtime %0" : "=r"(time));
     return time;
 #elif __riscv_xlen == 32
 #error "rdtime() nto defined for RV32"
 #endif
 }
 
+static inline unsigned long long rdcycle(void) {
+#if __riscv_xlen == 64
+    unsigned long long cycle;
+    asm volatile ("rdcycle %0" : "=r"(cycle));
+    return cycle;
+#elif __riscv_xlen == 32
+#error "rdcycle() not defined for RV32"
+#endif
+}
+
 // csrrsi_sstatus_SIE() and csrrci_sstatus_SIE() set and clear sstatus.SIE. They
 // return the previous value of the sstatus CSR.
 static inline long csrrsi_sstatus_SIE(void) {
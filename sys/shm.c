@@ -0,0 +1,151 @@
+// shm.c - Shared memory segments
+//
+// Copyright (c) 2024-2025 University of Illinois
+// SPDX-License-identifier: NCSA
+//
+
+#ifdef SHM_TRACE
+#define TRACE
+#endif
+
+#ifdef SHM_DEBUG
+#define DEBUG
+#endif
+
+#include "shm.h"
+#include "ioimpl.h"
+#include "conf.h"
+#include "memory.h"
+#include "heap.h"
+#include "string.h"
+#include "error.h"
+#include "console.h"
+#include "assert.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+// INTERNAL TYPE DEFINITIONS
+//
+
+struct shm {
+    struct io io;
+    void * pages; // physically contiguous
+    size_t size;  // multiple of PAGE_SIZE
+};
+
+// INTERNAL FUNCTION DECLARATIONS
+//
+
+static void shm_close(struct io * io);
+static int shm_cntl(struct io * io, int cmd, void * arg);
+static int shm_range_ok(const struct shm * shm, uintptr_t vma);
+
+// INTERNAL GLOBAL CONSTANTS
+//
+
+static const struct iointf shm_iointf = {
+    .close = &shm_close,
+    .cntl = &shm_cntl
+};
+
+// EXPORTED FUNCTION DEFINITIONS
+//
+
+int shm_create(size_t size, struct io ** ioptr) {
+    struct shm * shm;
+    size_t npages;
+    size_t i;
+
+    trace("%s(%zu)", __func__, size);
+
+    if (size == 0 || UMEM_END_VMA - UMEM_START_VMA < size)
+        return -EINVAL;
+
+    npages = ROUND_UP(size, PAGE_SIZE) / PAGE_SIZE;
+
+    shm = kcalloc(1, sizeof(struct shm));
+    if (shm == NULL)
+        return -ENOMEM;
+
+    shm->pages = alloc_phys_pages(npages);
+    if (shm->pages == NULL) {
+        kfree(shm);
+        return -ENOMEM;
+    }
+
+    shm->size = npages * PAGE_SIZE;
+    for (i = 0; i < npages; i++)
+        zero_page(shm->pages + i * PAGE_SIZE);
+
+    *ioptr = ioinit1(&shm->io, &shm_iointf);
+    return 0;
+}
+
+int shm_attach(struct io * io, uintptr_t vma) {
+    struct shm * const shm = (void*)io - offsetof(struct shm, io);
+
+    trace("%s(%p,%p)", __func__, io, (void*)vma);
+
+    if (io->intf != &shm_iointf)
+        return -ENOTSUP;
+
+    if (!shm_range_ok(shm, vma))
+        return -EINVAL;
+
+    return map_shared_range(vma, shm->size, shm->pages, MAP_RWUG);
+}
+
+int shm_detach(struct io * io, uintptr_t vma) {
+    struct shm * const shm = (void*)io - offsetof(struct shm, io);
+
+    trace("%s(%p,%p)", __func__, io, (void*)vma);
+
+    if (io->intf != &shm_iointf)
+        return -ENOTSUP;
+
+    if (!shm_range_ok(shm, vma))
+        return -EINVAL;
+
+    return unmap_shared_range(vma, shm->size, shm->pages);
+}
+
+// INTERNAL FUNCTION DEFINITIONS
+//
+
+// The endpoint's own reference to each page is dropped here; pages still
+// attached somewhere stay allocated until they are unmapped, by shm_detach or
+// when the attaching process execs or exits and its memory space is discarded
+// (free_user_ptabs releases shared pages like any other).
+
+void shm_close(struct io * io) {
+    struct shm * const shm = (void*)io - offsetof(struct shm, io);
+    size_t off;
+
+    debug("shm: closing %zu byte segment at %p", shm->size, shm->pages);
+
+    for (off = 0; off < shm->size; off += PAGE_SIZE)
+        page_release(shm->pages + off);
+
+    kfree(shm);
+}
+
+int shm_cntl(struct io * io, int cmd, void * arg) {
+    struct shm * const shm = (void*)io - offsetof(struct shm, io);
+
+    switch (cmd) {
+    case IOCTL_GETBLKSZ:
+        return PAGE_SIZE;
+    case IOCTL_GETEND:
+        *(unsigned long long *)arg = shm->size;
+        return 0;
+    default:
+        return -ENOTSUP;
+    }
+}
+
+int shm_range_ok(const struct shm * shm, uintptr_t vma) {
+    return (vma & (PAGE_SIZE - 1)) == 0 &&
+        UMEM_START_VMA <= vma && vma < UMEM_END_VMA &&
+        shm->size <= UMEM_END_VMA - vma;
+}
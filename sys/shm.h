@@ -0,0 +1,41 @@
+// shm.h - Shared memory segments
+//
+// Copyright (c) 2024-2025 University of Illinois
+// SPDX-License-identifier: NCSA
+//
+
+#ifndef _SHM_H_
+#define _SHM_H_
+
+#include "io.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+// A shared memory segment is a run of physical pages behind an I/O endpoint.
+// Any process holding the endpoint (through fork, spawn or iodup) can attach
+// the segment at an address of its choosing, and every attachment maps the
+// same pages. Each attachment and the endpoint itself hold a reference to the
+// pages, so they are freed only when the last of them goes away, whether by
+// detach, close, exec or exit. Attachments survive fork as shared mappings.
+
+// EXPORTED FUNCTION DECLARATIONS
+//
+
+// Creates a zero-filled segment of _size_ bytes (rounded up to a whole number
+// of pages). Returns 0 and sets *_ioptr_ on success, or a negative error code.
+
+extern int shm_create(size_t size, struct io ** ioptr);
+
+// Maps the segment at the page-aligned user address _vma_ in the active
+// memory space. Returns -EBUSY if part of the range is already mapped and
+// -ENOTSUP if _io_ is not a segment.
+
+extern int shm_attach(struct io * io, uintptr_t vma);
+
+// Unmaps an attachment made by shm_attach. Returns -EINVAL if the segment is
+// not attached at _vma_.
+
+extern int shm_detach(struct io * io, uintptr_t vma);
+
+#endif // _SHM_H_
@@ -60,6 +60,14 @@ mmode_start:
 
         csrs    mcounteren, 7
 
+        # With ZICBOZ (see Makefile), let S mode use cbo.zero (menvcfg.CBZE).
+        # menvcfg is CSR 0x30a.
+
+        .ifdef ZICBOZ
+        li      t0, 0x80
+        csrs    0x30a, t0
+        .endif
+
         # Switch to S mode with M mode interrupts now enabled
 
         li      t0, 0x1002 # bits to clear in mstatus (MPP=0b01,SIE=0)
@@ -6,9 +6,25 @@
 
 #include "string.h"
 #include "console.h"
+
+#ifdef RVV
+#include "vec.h"
+#endif
+
 #include <stdint.h>
 #include <limits.h>
 
+// INTERNAL CONSTANT DEFINITIONS
+//
+
+// WORD_HAS_ZERO(w) is nonzero exactly when some byte of _w_ is zero: only a
+// zero byte can borrow into its own high bit while that bit is clear in _w_.
+
+#define WORD_SIZE sizeof(unsigned long)
+#define WORD_ONES 0x0101010101010101UL
+#define WORD_HIGHS 0x8080808080808080UL
+#define WORD_HAS_ZERO(w) (((w) - WORD_ONES) & ~(w) & WORD_HIGHS)
+
 // INTERNAL STRUCTURE DEFINITIONS
 // 
 
@@ -63,6 +79,34 @@ int strcmp(const char * s1, const char * s2) {
 }
 
 int strncmp(const char * s1, const char * s2, size_t n) {
+  const unsigned long * w1;
+  const unsigned long * w2;
+
+  // If both strings have the same alignment, skip whole words that match and
+  // have no null byte, then finish byte by byte.
+
+  if ((((uintptr_t)s1 ^ (uintptr_t)s2) & (WORD_SIZE-1)) == 0) {
+    while (n != 0 && ((uintptr_t)s1 & (WORD_SIZE-1)) != 0 &&
+      *s1 != '\0' && *s1 == *s2)
+    {
+      s1 += 1;
+      s2 += 1;
+      n -= 1;
+    }
+
+    if (((uintptr_t)s1 & (WORD_SIZE-1)) == 0) {
+      w1 = (const unsigned long *)s1;
+      w2 = (const unsigned long *)s2;
+      while (WORD_SIZE <= n && *w1 == *w2 && !WORD_HAS_ZERO(*w1)) {
+        w1 += 1;
+        w2 += 1;
+        n -= WORD_SIZE;
+      }
+      s1 = (const char *)w1;
+      s2 = (const char *)w2;
+    }
+  }
+
   while (n != 0 && *s1 != '\0' && *s1 == *s2) {
     s1 += 1;
     s2 += 1;
@@ -76,11 +120,27 @@ int strncmp(const char * s1, const char * s2, size_t n) {
 }
 
 size_t strlen(const char * s) {
+    const unsigned long * w;
     const char * p = s;
 
     if (s == NULL)
         return 0;
 
+    // Bytes up to a word boundary, then whole words until one has a null
+    // byte. An aligned word never crosses a page boundary, so reading past
+    // the end of the string this way cannot fault.
+
+    while (((uintptr_t)p & (WORD_SIZE-1)) != 0) {
+        if (*p == '\0')
+            return (p - s);
+        p += 1;
+    }
+
+    w = (const unsigned long *)p;
+    while (!WORD_HAS_ZERO(*w))
+        w += 1;
+
+    p = (const char *)w;
     while (*p != '\0')
         p += 1;
     
@@ -125,9 +185,43 @@ char * strrchr(const char * s, int c) {
     return p;
 }
 
+// The memory functions below move bytes only up to the first word boundary
+// and after the last one; in between they use 64-bit loads and stores, eight
+// at a time while possible. When the two pointers of memcpy or memcmp are not
+// equally aligned, they fall back to bytes, since misaligned word accesses
+// trap on many rv64 cores.
+
 void * memset(void * s, int c, size_t n) {
-  char * p = s;
+  unsigned char * p = s;
+  unsigned long * w;
+  unsigned long v;
+
+#ifdef RVV
+    if (vec_usable(n))
+        return vec_memset(s, c, n);
+#endif
+
+  while (n != 0 && ((uintptr_t)p & (WORD_SIZE-1)) != 0) {
+    *p++ = c;
+    n -= 1;
+  }
+
+  v = (unsigned char)c * WORD_ONES;
+  w = (unsigned long *)p;
+
+  while (8*WORD_SIZE <= n) {
+    w[0] = v; w[1] = v; w[2] = v; w[3] = v;
+    w[4] = v; w[5] = v; w[6] = v; w[7] = v;
+    w += 8;
+    n -= 8*WORD_SIZE;
+  }
+
+  while (WORD_SIZE <= n) {
+    *w++ = v;
+    n -= WORD_SIZE;
+  }
 
+  p = (unsigned char *)w;
   while (n != 0) {
     *p++ = c;
     n -= 1;
@@ -138,10 +232,42 @@ void * memset(void * s, int c, size_t n) {
 
 void * memcpy(void * restrict dst, const void * restrict src, size_t n) {
     const char * q = src;
-    char *p = dst;
+    char * p = dst;
+    const unsigned long * wq;
+    unsigned long * wp;
+
+#ifdef RVV
+    if (vec_usable(n))
+        return vec_memcpy(dst, src, n);
+#endif
+
+    if ((((uintptr_t)p ^ (uintptr_t)q) & (WORD_SIZE-1)) == 0) {
+        while (n != 0 && ((uintptr_t)p & (WORD_SIZE-1)) != 0) {
+            *p++ = *q++;
+            n -= 1;
+        }
+
+        wp = (unsigned long *)p;
+        wq = (const unsigned long *)q;
+
+        while (8*WORD_SIZE <= n) {
+            wp[0] = wq[0]; wp[1] = wq[1]; wp[2] = wq[2]; wp[3] = wq[3];
+            wp[4] = wq[4]; wp[5] = wq[5]; wp[6] = wq[6]; wp[7] = wq[7];
+            wp += 8;
+            wq += 8;
+            n -= 8*WORD_SIZE;
+        }
+
+        while (WORD_SIZE <= n) {
+            *wp++ = *wq++;
+            n -= WORD_SIZE;
+        }
+
+        p = (char *)wp;
+        q = (const char *)wq;
+    }
+
     while (n != 0) {
-        // kprintf("buf_address_dst: %p\n", p);
-        // kprintf("buf_address_src: %p\n", q);
         *p = *q;
         p += 1;
         q += 1;
@@ -154,6 +280,38 @@ void * memcpy(void * restrict dst, const void * restrict src, size_t n) {
 int memcmp(const void * p1, const void * p2, size_t n) {
     const uint8_t * u = p1;
     const uint8_t * v = p2;
+    const unsigned long * wu;
+    const unsigned long * wv;
+
+#ifdef RVV
+    if (vec_usable(n))
+        return vec_memcmp(p1, p2, n);
+#endif
+
+    // Skip equal words; the bytes of the first differing word (if any) are
+    // compared below to find the sign.
+
+    if ((((uintptr_t)u ^ (uintptr_t)v) & (WORD_SIZE-1)) == 0) {
+        while (n != 0 && ((uintptr_t)u & (WORD_SIZE-1)) != 0) {
+            if (*u != *v)
+                return (*u - *v);
+            u += 1;
+            v += 1;
+            n -= 1;
+        }
+
+        wu = (const unsigned long *)u;
+        wv = (const unsigned long *)v;
+
+        while (WORD_SIZE <= n && *wu == *wv) {
+            wu += 1;
+            wv += 1;
+            n -= WORD_SIZE;
+        }
+
+        u = (const uint8_t *)wu;
+        v = (const uint8_t *)wv;
+    }
 
     while (n != 0) {
         if (*u != *v)
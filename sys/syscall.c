@@ -24,6 +24,11 @@
 #include "timer.h"
 #include "error.h"
 #include "thread.h"
+#include "futex.h"
+#include "aio.h"
+#include "shm.h"
+#include "ktrace.h"
+#include "string.h"
 
 extern void handle_syscall(struct trap_frame * tfr);
 
@@ -44,35 +49,175 @@ static int sysfscreate(const char* name);
 static int sysfsdelete(const char* name);
 int sysiodup (int oldfd, int newfd);
 int sysfork	(const struct trap_frame * tfr);	
+static int sysfutex(int * uaddr, int op, int val);
+static int systhrcreate(uintptr_t entry, uintptr_t arg, uintptr_t stack);
+static int systhrexit(void);
+static int systhrjoin(int tid);
+static int sysspawn(int fd, int argc, char ** argv, const int * fdmap);
+static int sysmulticall(struct syscall_desc * descs, int cnt, int flags);
+static int sysaiosetup(struct aio_ring * ring);
+static int sysaioenter(unsigned int min_complete);
+static long sysreadv(int fd, const struct iovec * iov, int iovcnt);
+static long syswritev(int fd, const struct iovec * iov, int iovcnt);
+static long syspreadv(int fd, const struct iovec * iov, int iovcnt, unsigned long long pos);
+static long syspwritev(int fd, const struct iovec * iov, int iovcnt, unsigned long long pos);
+static long syssplice(int infd, int outfd, long len, long long offset);
+static int sysshmcreate(int fd, size_t size);
+static int sysshmattach(int fd, void * addr);
+static int sysshmdetach(int fd, void * addr);
+static int syspoll(struct pollfd * fds, int nfds, long timeout_us);
 
+static int64_t sc_exit(const struct trap_frame * tfr);
+static int64_t sc_exec(const struct trap_frame * tfr);
+static int64_t sc_fork(const struct trap_frame * tfr);
+static int64_t sc_wait(const struct trap_frame * tfr);
+static int64_t sc_print(const struct trap_frame * tfr);
+static int64_t sc_usleep(const struct trap_frame * tfr);
+static int64_t sc_thrcreate(const struct trap_frame * tfr);
+static int64_t sc_threxit(const struct trap_frame * tfr);
+static int64_t sc_thrjoin(const struct trap_frame * tfr);
+static int64_t sc_spawn(const struct trap_frame * tfr);
+static int64_t sc_devopen(const struct trap_frame * tfr);
+static int64_t sc_fsopen(const struct trap_frame * tfr);
+static int64_t sc_fscreate(const struct trap_frame * tfr);
+static int64_t sc_fsdelete(const struct trap_frame * tfr);
+static int64_t sc_close(const struct trap_frame * tfr);
+static int64_t sc_read(const struct trap_frame * tfr);
+static int64_t sc_write(const struct trap_frame * tfr);
+static int64_t sc_ioctl(const struct trap_frame * tfr);
+static int64_t sc_pipe(const struct trap_frame * tfr);
+static int64_t sc_iodup(const struct trap_frame * tfr);
+static int64_t sc_futex(const struct trap_frame * tfr);
+static int64_t sc_multicall(const struct trap_frame * tfr);
+static int64_t sc_aiosetup(const struct trap_frame * tfr);
+static int64_t sc_aioenter(const struct trap_frame * tfr);
+static int64_t sc_readv(const struct trap_frame * tfr);
+static int64_t sc_writev(const struct trap_frame * tfr);
+static int64_t sc_preadv(const struct trap_frame * tfr);
+static int64_t sc_pwritev(const struct trap_frame * tfr);
+static int64_t sc_splice(const struct trap_frame * tfr);
+static int64_t sc_shmcreate(const struct trap_frame * tfr);
+static int64_t sc_shmattach(const struct trap_frame * tfr);
+static int64_t sc_shmdetach(const struct trap_frame * tfr);
+static int64_t sc_poll(const struct trap_frame * tfr);
+
+static int copy_iov(struct iovec * dst, const struct iovec * uiov, int iovcnt);
+
+// INTERNAL GLOBAL VARIABLES
+//
+
+// The syscall table is indexed by the system call number in _a7_. Each entry
+// unpacks its arguments from the trap frame and calls the matching sys*
+// function below. The fast ecall path in trap.s only saves _a0_ through _a7_
+// (plus _s1_ to _s11_ for fork), so entries must not look at other registers.
+
+static int64_t (* const syscall_table[])(const struct trap_frame * tfr) = {
+    [SYSCALL_EXIT]      = sc_exit,
+    [SYSCALL_EXEC]      = sc_exec,
+    [SYSCALL_FORK]      = sc_fork,
+    [SYSCALL_WAIT]      = sc_wait,
+    [SYSCALL_PRINT]     = sc_print,
+    [SYSCALL_USLEEP]    = sc_usleep,
+    [SYSCALL_THRCREATE] = sc_thrcreate,
+    [SYSCALL_THREXIT]   = sc_threxit,
+    [SYSCALL_THRJOIN]   = sc_thrjoin,
+    [SYSCALL_SPAWN]     = sc_spawn,
+    [SYSCALL_DEVOPEN]   = sc_devopen,
+    [SYSCALL_FSOPEN]    = sc_fsopen,
+    [SYSCALL_FSCREATE]  = sc_fscreate,
+    [SYSCALL_FSDELETE]  = sc_fsdelete,
+    [SYSCALL_CLOSE]     = sc_close,
+    [SYSCALL_READ]      = sc_read,
+    [SYSCALL_WRITE]     = sc_write,
+    [SYSCALL_IOCTL]     = sc_ioctl,
+    [SYSCALL_PIPE]      = sc_pipe,
+    [SYSCALL_IODUP]     = sc_iodup,
+    [SYSCALL_FUTEX]     = sc_futex,
+    [SYSCALL_MULTICALL] = sc_multicall,
+    [SYSCALL_AIOSETUP]  = sc_aiosetup,
+    [SYSCALL_AIOENTER]  = sc_aioenter,
+    [SYSCALL_READV]     = sc_readv,
+    [SYSCALL_WRITEV]    = sc_writev,
+    [SYSCALL_PREADV]    = sc_preadv,
+    [SYSCALL_PWRITEV]   = sc_pwritev,
+    [SYSCALL_SPLICE]    = sc_splice,
+    [SYSCALL_SHMCREATE] = sc_shmcreate,
+    [SYSCALL_SHMATTACH] = sc_shmattach,
+    [SYSCALL_SHMDETACH] = sc_shmdetach,
+    [SYSCALL_POLL]      = sc_poll
+};
+
+#define NSYSCALL (sizeof(syscall_table) / sizeof(syscall_table[0]))
+
+// EXPORTED FUNCTION DEFINITIONS
+//
+
+// Called from the ecall fast path in trap.s. A negative return value from a
+// system call terminates the process, and a thread whose process is exiting
+// stops here instead of returning to U mode.
 
 void handle_syscall(struct trap_frame * tfr) {
     tfr->sepc += 4;
+    ktrace(KT_SYSCALL_ENTER, tfr->a7, tfr->a0);
     tfr->a0 = syscall(tfr);
+    ktrace(KT_SYSCALL_EXIT, tfr->a7, tfr->a0);
+
+    // A non-blocking call that would have waited is not a fault, and neither
+    // is a wait cut short because another thread is ending the process.
+
+    if (tfr->a0 < 0 && tfr->a0 != -EAGAIN && tfr->a0 != -EINTR)
+        process_exit();
+
+    if (current_process()->exiting)
+        process_thread_exit();
 }
 
+// INTERNAL FUNCTION DEFINITIONS
+//
+
 int64_t syscall(const struct trap_frame * tfr) {
-    switch(tfr->a7){
-        case SYSCALL_EXIT:      return sysexit();
-        case SYSCALL_EXEC:      return sysexec((int)tfr->a0, (int)tfr->a1, (char**)tfr->a2);
-        case SYSCALL_WAIT:      return syswait((int)tfr->a0);
-        case SYSCALL_PRINT:     return sysprint((const char*)tfr->a0);
-        case SYSCALL_USLEEP:    return sysusleep((unsigned long)tfr->a0);
-        case SYSCALL_DEVOPEN:   return sysdevopen((int)tfr->a0, (char*)tfr->a1, (int)tfr->a2);
-        case SYSCALL_FSOPEN:    return sysfsopen((int)tfr->a0, (char*)tfr->a1);
-        case SYSCALL_FSCREATE:  return sysfscreate((char*)tfr->a0);
-        case SYSCALL_FSDELETE:  return sysfsdelete((char*)tfr->a0);
-        case SYSCALL_CLOSE:     return sysclose((int)tfr->a0);
-        case SYSCALL_READ:      return sysread((int)tfr->a0, (void*)tfr->a1, (size_t)tfr->a2);
-        case SYSCALL_WRITE:     return syswrite((int)tfr->a0, (void*)tfr->a1, (size_t)tfr->a2);
-        case SYSCALL_IOCTL:     return sysioctl((int)tfr->a0, (int)tfr->a1, (void*)tfr->a2);
-        case SYSCALL_PIPE:      return syspipe((int*)tfr->a0, (int*)tfr->a1);
-        case SYSCALL_IODUP:     return sysiodup((int)tfr->a0, (int)tfr->a1);
-        case SYSCALL_FORK:      return sysfork(tfr);
-        default:                return -ENOTSUP;
-    }
+    unsigned long scnum = tfr->a7;
+
+    if (scnum < NSYSCALL && syscall_table[scnum] != NULL)
+        return syscall_table[scnum](tfr);
+    else
+        return -ENOTSUP;
 }
 
+static int64_t sc_exit(const struct trap_frame * tfr) { return sysexit(); }
+static int64_t sc_exec(const struct trap_frame * tfr) { return sysexec((int)tfr->a0, (int)tfr->a1, (char**)tfr->a2); }
+static int64_t sc_fork(const struct trap_frame * tfr) { return sysfork(tfr); }
+static int64_t sc_wait(const struct trap_frame * tfr) { return syswait((int)tfr->a0); }
+static int64_t sc_print(const struct trap_frame * tfr) { return sysprint((const char*)tfr->a0); }
+static int64_t sc_usleep(const struct trap_frame * tfr) { return sysusleep((unsigned long)tfr->a0); }
+static int64_t sc_thrcreate(const struct trap_frame * tfr) { return systhrcreate(tfr->a0, tfr->a1, tfr->a2); }
+static int64_t sc_threxit(const struct trap_frame * tfr) { return systhrexit(); }
+static int64_t sc_thrjoin(const struct trap_frame * tfr) { return systhrjoin((int)tfr->a0); }
+static int64_t sc_spawn(const struct trap_frame * tfr) { return sysspawn((int)tfr->a0, (int)tfr->a1, (char**)tfr->a2, (const int*)tfr->a3); }
+static int64_t sc_devopen(const struct trap_frame * tfr) { return sysdevopen((int)tfr->a0, (char*)tfr->a1, (int)tfr->a2); }
+static int64_t sc_fsopen(const struct trap_frame * tfr) { return sysfsopen((int)tfr->a0, (char*)tfr->a1); }
+static int64_t sc_fscreate(const struct trap_frame * tfr) { return sysfscreate((char*)tfr->a0); }
+static int64_t sc_fsdelete(const struct trap_frame * tfr) { return sysfsdelete((char*)tfr->a0); }
+static int64_t sc_close(const struct trap_frame * tfr) { return sysclose((int)tfr->a0); }
+static int64_t sc_read(const struct trap_frame * tfr) { return sysread((int)tfr->a0, (void*)tfr->a1, (size_t)tfr->a2); }
+static int64_t sc_write(const struct trap_frame * tfr) { return syswrite((int)tfr->a0, (void*)tfr->a1, (size_t)tfr->a2); }
+static int64_t sc_ioctl(const struct trap_frame * tfr) { return sysioctl((int)tfr->a0, (int)tfr->a1, (void*)tfr->a2); }
+static int64_t sc_pipe(const struct trap_frame * tfr) { return syspipe((int*)tfr->a0, (int*)tfr->a1); }
+static int64_t sc_iodup(const struct trap_frame * tfr) { return sysiodup((int)tfr->a0, (int)tfr->a1); }
+static int64_t sc_futex(const struct trap_frame * tfr) { return sysfutex((int*)tfr->a0, (int)tfr->a1, (int)tfr->a2); }
+static int64_t sc_multicall(const struct trap_frame * tfr) { return sysmulticall((struct syscall_desc*)tfr->a0, (int)tfr->a1, (int)tfr->a2); }
+static int64_t sc_aiosetup(const struct trap_frame * tfr) { return sysaiosetup((struct aio_ring*)tfr->a0); }
+static int64_t sc_aioenter(const struct trap_frame * tfr) { return sysaioenter((unsigned int)tfr->a0); }
+static int64_t sc_readv(const struct trap_frame * tfr) { return sysreadv((int)tfr->a0, (struct iovec*)tfr->a1, (int)tfr->a2); }
+static int64_t sc_writev(const struct trap_frame * tfr) { return syswritev((int)tfr->a0, (struct iovec*)tfr->a1, (int)tfr->a2); }
+static int64_t sc_preadv(const struct trap_frame * tfr) { return syspreadv((int)tfr->a0, (struct iovec*)tfr->a1, (int)tfr->a2, tfr->a3); }
+static int64_t sc_pwritev(const struct trap_frame * tfr) { return syspwritev((int)tfr->a0, (struct iovec*)tfr->a1, (int)tfr->a2, tfr->a3); }
+static int64_t sc_splice(const struct trap_frame * tfr) { return syssplice((int)tfr->a0, (int)tfr->a1, (long)tfr->a2, (long long)tfr->a3); }
+static int64_t sc_shmcreate(const struct trap_frame * tfr) { return sysshmcreate((int)tfr->a0, (size_t)tfr->a1); }
+static int64_t sc_shmattach(const struct trap_frame * tfr) { return sysshmattach((int)tfr->a0, (void*)tfr->a1); }
+static int64_t sc_shmdetach(const struct trap_frame * tfr) { return sysshmdetach((int)tfr->a0, (void*)tfr->a1); }
+static int64_t sc_poll(const struct trap_frame * tfr) { return syspoll((struct pollfd*)tfr->a0, (int)tfr->a1, (long)tfr->a2); }
+
 int sysexit(void) { process_exit(); return 0; }
 
 int sysexec(int fd, int argc, char ** argv) {
@@ -82,7 +227,7 @@ int sysexec(int fd, int argc, char ** argv) {
     return process_exec(current_process()->iotab[fd], argc, argv);
 }
 
-int syswait(int tid) { kprintf("wait\n"); return (tid >= 0) ? thread_join(tid) : -EINVAL; }
+int syswait(int tid) { return (tid >= 0) ? process_wait(tid) : -EINVAL; }
 
 int sysprint(const char * msg) {
    // kprintf("print\n");
@@ -171,9 +316,9 @@ int syspipe(int * wfdptr, int * rfdptr) {
     return 0;
 }
 
-int sysfscreate(const char* name) { kprintf("create\n"); return fscreate(name); }
+int sysfscreate(const char* name) { return fscreate(name); }
 
-int sysfsdelete(const char* name) { kprintf("delete\n"); return fsdelete(name); }
+int sysfsdelete(const char* name) { return fsdelete(name); }
 
 int sysiodup (int oldfd, int newfd){
     if(oldfd < 0 || oldfd >= PROCESS_IOMAX){
@@ -197,4 +342,177 @@ int sysiodup (int oldfd, int newfd){
     }
     current_process()->iotab[newfd] = ioaddref(current_process()->iotab[oldfd]);        //add io reference to newfd
     return 0;
-}
\ No newline at end of file
+}
+int sysfutex(int * uaddr, int op, int val) {
+    switch (op) {
+    case FUTEX_WAIT:
+        return futex_wait(uaddr, val);
+    case FUTEX_WAKE:
+        return (val > 0) ? futex_wake(uaddr, val) : 0;
+    default:
+        return -EINVAL;
+    }
+}
+
+int systhrcreate(uintptr_t entry, uintptr_t arg, uintptr_t stack) {
+    return process_thread_create(entry, arg, stack);
+}
+
+int systhrexit(void) { process_thread_exit(); return 0; }
+
+int systhrjoin(int tid) { return process_thread_join(tid); }
+
+int sysspawn(int fd, int argc, char ** argv, const int * fdmap) {
+    if (fd < 0 || fd >= PROCESS_IOMAX || !current_process()->iotab[fd]) return -EBADFD;
+    return process_spawn(current_process()->iotab[fd], argc, argv, fdmap);
+}
+
+int sysaiosetup(struct aio_ring * ring) { return aio_setup(ring); }
+
+int sysaioenter(unsigned int min_complete) { return aio_enter(min_complete); }
+
+// The vectored calls copy the segment array out of user memory first, so the
+// driver sees a list that cannot change under it while the transfer runs.
+
+long sysreadv(int fd, const struct iovec * iov, int iovcnt) {
+    struct iovec kiov[IOV_MAX];
+    if (fd < 0 || fd >= PROCESS_IOMAX || !current_process()->iotab[fd]) return -EBADFD;
+    if (copy_iov(kiov, iov, iovcnt) < 0) return -EINVAL;
+    return ioreadv(current_process()->iotab[fd], kiov, iovcnt);
+}
+
+long syswritev(int fd, const struct iovec * iov, int iovcnt) {
+    struct iovec kiov[IOV_MAX];
+    if (fd < 0 || fd >= PROCESS_IOMAX || !current_process()->iotab[fd]) return -EBADFD;
+    if (copy_iov(kiov, iov, iovcnt) < 0) return -EINVAL;
+    return iowritev(current_process()->iotab[fd], kiov, iovcnt);
+}
+
+long syspreadv(int fd, const struct iovec * iov, int iovcnt, unsigned long long pos) {
+    struct iovec kiov[IOV_MAX];
+    if (fd < 0 || fd >= PROCESS_IOMAX || !current_process()->iotab[fd]) return -EBADFD;
+    if (copy_iov(kiov, iov, iovcnt) < 0) return -EINVAL;
+    return ioreadvat(current_process()->iotab[fd], pos, kiov, iovcnt);
+}
+
+long syspwritev(int fd, const struct iovec * iov, int iovcnt, unsigned long long pos) {
+    struct iovec kiov[IOV_MAX];
+    if (fd < 0 || fd >= PROCESS_IOMAX || !current_process()->iotab[fd]) return -EBADFD;
+    if (copy_iov(kiov, iov, iovcnt) < 0) return -EINVAL;
+    return iowritevat(current_process()->iotab[fd], pos, kiov, iovcnt);
+}
+
+// Moves _len_ bytes from _infd_ to _outfd_ inside the kernel. A non-negative
+// _offset_ reads _infd_ at that position and leaves its file position alone; a
+// negative one reads from (and advances) the current position.
+
+long syssplice(int infd, int outfd, long len, long long offset) {
+    struct io * const * const iotab = current_process()->iotab;
+    if (infd < 0 || infd >= PROCESS_IOMAX || !iotab[infd]) return -EBADFD;
+    if (outfd < 0 || outfd >= PROCESS_IOMAX || !iotab[outfd]) return -EBADFD;
+    if (offset < 0)
+        return iosplice(iotab[infd], iotab[outfd], len);
+    else
+        return iospliceat(iotab[infd], offset, iotab[outfd], len);
+}
+
+int sysshmcreate(int fd, size_t size) {
+    int desc = (fd < 0) ? ({ for (desc = 0; desc < PROCESS_IOMAX && current_process()->iotab[desc]; ++desc); desc; }) : fd;
+    int result;
+    if (desc >= PROCESS_IOMAX || (fd >= 0 && current_process()->iotab[fd])) return -EBADFD;
+    result = shm_create(size, &current_process()->iotab[desc]);
+    return (result < 0) ? result : desc;
+}
+
+int sysshmattach(int fd, void * addr) {
+    if (fd < 0 || fd >= PROCESS_IOMAX || !current_process()->iotab[fd]) return -EBADFD;
+    return shm_attach(current_process()->iotab[fd], (uintptr_t)addr);
+}
+
+int sysshmdetach(int fd, void * addr) {
+    if (fd < 0 || fd >= PROCESS_IOMAX || !current_process()->iotab[fd]) return -EBADFD;
+    return shm_detach(current_process()->iotab[fd], (uintptr_t)addr);
+}
+
+// Waits until one of the _nfds_ descriptors in _fds_ is ready for the events it
+// asks for, or until _timeout_us_ microseconds pass (never if negative). An
+// invalid descriptor is skipped and reports no events. Returns the number of
+// entries with a non-zero _revents_.
+
+int syspoll(struct pollfd * fds, int nfds, long timeout_us) {
+    struct io * const * const iotab = current_process()->iotab;
+    struct io * ios[PROCESS_IOMAX];
+    int events[PROCESS_IOMAX];
+    int revents[PROCESS_IOMAX];
+    int result;
+    int i;
+
+    if (nfds < 0 || PROCESS_IOMAX < nfds || (nfds > 0 && fds == NULL))
+        return -EINVAL;
+
+    for (i = 0; i < nfds; i++) {
+        if (0 <= fds[i].fd && fds[i].fd < PROCESS_IOMAX)
+            ios[i] = iotab[fds[i].fd];
+        else
+            ios[i] = NULL;
+        events[i] = fds[i].events;
+    }
+
+    result = iopoll(ios, events, revents, nfds, timeout_us);
+
+    for (i = 0; i < nfds; i++)
+        fds[i].revents = revents[i];
+
+    return result;
+}
+
+int copy_iov(struct iovec * dst, const struct iovec * uiov, int iovcnt) {
+    if (iovcnt < 0 || IOV_MAX < iovcnt || (iovcnt > 0 && uiov == NULL))
+        return -EINVAL;
+    memcpy(dst, uiov, iovcnt * sizeof(struct iovec));
+    return 0;
+}
+
+// Runs _cnt_ system calls from the _descs_ array in order and stores each
+// result in its descriptor. Returns the number of entries processed, which is
+// less than _cnt_ only if MULTICALL_STOPERR is set and an entry failed. A
+// failing entry does not terminate the process; its error is only reported in
+// its result field.
+//
+// Calls that replace or end the calling thread's U mode context (exit, exec,
+// fork, thread exit) cannot be batched, nor can multicall itself. They fail
+// with -ENOTSUP.
+
+int sysmulticall(struct syscall_desc * descs, int cnt, int flags) {
+    struct trap_frame tfr;
+    int i;
+
+    if (cnt < 0 || (cnt > 0 && !descs))
+        return -EINVAL;
+
+    for (i = 0; i < cnt; i++) {
+        switch (descs[i].num) {
+        case SYSCALL_EXIT:
+        case SYSCALL_EXEC:
+        case SYSCALL_FORK:
+        case SYSCALL_THREXIT:
+        case SYSCALL_MULTICALL:
+            descs[i].result = -ENOTSUP;
+            break;
+        default:
+            tfr.a0 = descs[i].args[0];
+            tfr.a1 = descs[i].args[1];
+            tfr.a2 = descs[i].args[2];
+            tfr.a3 = descs[i].args[3];
+            tfr.a4 = descs[i].args[4];
+            tfr.a5 = descs[i].args[5];
+            tfr.a7 = descs[i].num;
+            descs[i].result = syscall(&tfr);
+        }
+
+        if (descs[i].result < 0 && (flags & MULTICALL_STOPERR))
+            return i + 1;
+    }
+
+    return cnt;
+}
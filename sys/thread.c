@@ -24,8 +24,13 @@
 #include "intr.h"
 #include "memory.h"
 #include "error.h"
+#include "ktrace.h"
 #include "process.h" 
 
+#ifdef RVV
+#include "vec.h"
+#endif
+
 #include <stdarg.h>
 
 // COMPILE-TIME PARAMETERS
@@ -84,7 +89,8 @@ struct thread {
     struct condition child_exit;
     struct lock *lock_list; //lst of locks acquired by this particular thrd (mp3)
     struct process *proc;
-    
+    char detached; // reclaimed on exit instead of by thread_join
+    char interruptible; // waiting in condition_wait_intr
 };
 
 // INTERNAL MACRO DEFINITIONS
@@ -161,6 +167,7 @@ static void tlclear(struct thread_list * list);
 static int tlempty(const struct thread_list * list);
 static void tlinsert(struct thread_list * list, struct thread * thr);
 static struct thread * tlremove(struct thread_list * list);
+static void tlunlink(struct thread_list * list, struct thread * thr);
 //static void tlappend(struct thread_list * l0, struct thread_list * l1);
 
 static void idle_thread_func(void);
@@ -319,7 +326,10 @@ void thread_exit(void) {
         l->count = 0;
         condition_broadcast(&l->cv);  // Wake all waiters
     }
-    if (TP->id == MAIN_TID) halt_success(); 
+    if (TP->id == MAIN_TID) {
+        console_flush();
+        halt_success();
+    }
     set_thread_state(TP, THREAD_EXITED); //mark exit
     // condition_broadcast(&TP->parent->child_exit);//change tp->child to tp->parent->child
     condition_broadcast(&TP->child_exit); 
@@ -350,14 +360,14 @@ int thread_join(int tid) {
 
 
     // Validate 'tid': Ensure it is within the valid range and is actually a child.
-    if (tid > 0 && tid < NTHR && (child = thrtab[tid]) && child->parent != TP) {
+    if (tid > 0 && tid < NTHR && (child = thrtab[tid]) && (child->parent != TP || child->detached)) {
         return -EINVAL;
     }
 
     // If tid == 0, find ANY child thread of the calling thread.
     if (tid == 0) {
         for (int i = 0; i < NTHR; i++) {
-            if (thrtab[i] && thrtab[i]->parent == TP) {
+            if (thrtab[i] && thrtab[i]->parent == TP && !thrtab[i]->detached) {
                 child = thrtab[i];
                 break; // Stop at the first found child
             }
@@ -368,9 +378,10 @@ int thread_join(int tid) {
         tid = child->id;  // Update 'tid' to the found child's ID
     }
 
-    // Wait for the child to exit.
+    // Wait for the child to exit. A thread of an exiting process gives up.
     while(child->state != THREAD_EXITED) {
-        condition_wait(&(child->child_exit));
+        if (condition_wait_intr(&(child->child_exit)) < 0)
+            return -EINTR;
     }
 
     // Reclaim resources safely with interrupts disabled.
@@ -382,6 +393,22 @@ int thread_join(int tid) {
 }
 
 
+void thread_detach(int tid) {
+    struct thread * thr;
+    int pie;
+
+    assert (0 < tid && tid < NTHR);
+    thr = thrtab[tid];
+    assert (thr != NULL && thr->parent == TP);
+
+    pie = disable_interrupts();
+    if (thr->state == THREAD_EXITED)
+        thread_reclaim(tid);
+    else
+        thr->detached = 1;
+    restore_interrupts(pie);
+}
+
 const char * thread_name(int tid) {
     assert (0 <= tid && tid < NTHR);
     assert (thrtab[tid] != NULL);
@@ -414,6 +441,44 @@ void condition_wait(struct condition * cond) {
     running_thread_suspend();
 }
 
+// A process is exiting once process_exit has been called by any of its threads.
+// thread_interrupt_process wakes its other threads out of condition_wait_intr.
+
+int condition_wait_intr(struct condition * cond) {
+    struct process * const proc = TP->proc;
+
+    if (proc != NULL && proc->exiting)
+        return -EINTR;
+
+    TP->interruptible = 1;
+    condition_wait(cond);
+    TP->interruptible = 0;
+
+    return (proc != NULL && proc->exiting) ? -EINTR : 0;
+}
+
+void thread_interrupt_process(struct process * proc) {
+    struct thread * thr;
+    int pie;
+    int i;
+
+    pie = disable_interrupts();
+
+    for (i = 0; i < NTHR; i++) {
+        thr = thrtab[i];
+        if (thr == NULL || thr == TP || thr->proc != proc ||
+            thr->state != THREAD_WAITING || !thr->interruptible)
+            continue;
+
+        tlunlink(&thr->wait_cond->wait_list, thr);
+        set_thread_state(thr, THREAD_READY);
+        thr->wait_cond = NULL;
+        tlinsert(&ready_list, thr);
+    }
+
+    restore_interrupts(pie);
+}
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 // condition_broadcast(struct condition *cond): wakes up all threads waiting on a condition var
 // - loops thru wait list and moves all threads to ready queue
@@ -434,6 +499,26 @@ void condition_broadcast(struct condition * cond) {
     restore_interrupts(pie);
 }
 
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// condition_signal(struct condition *cond): wakes up one thread waiting on a condition var
+// - takes the thread at the head of the wait list (the one waiting longest) and readies it
+// - returns 1 if someone was woken, 0 if nobody was waiting
+////////////////////////////////////////////////////////////////////////////////////////////////////
+int condition_signal(struct condition * cond) {
+    struct thread *thr;
+    int pie = disable_interrupts();
+
+    thr = tlremove(&cond->wait_list);
+    if (thr != NULL) {
+        set_thread_state(thr, THREAD_READY);
+        thr->wait_cond = NULL;
+        tlinsert(&ready_list, thr);
+    }
+
+    restore_interrupts(pie);
+    return (thr != NULL);
+}
+
 // INTERNAL FUNCTION DEFINITIONS
 //
 
@@ -482,6 +567,10 @@ void thread_reclaim(int tid) {
             thrtab[ctid]->parent = thr->parent;
     }
 
+#ifdef RVV
+    vec_thread_exit(tid);
+#endif
+
     thrtab[tid] = NULL;
     kfree(thr);
 }
@@ -555,11 +644,14 @@ void running_thread_suspend(void) {
     } else {
         switch_mspace(nextthrd->proc->mtag);// -> csrrw_satp(child_mtag) + sfence
     }
+    ktrace(KT_SWITCH, currthrd->id, nextthrd->id);
     struct thread* old_thr = _thread_swtch(nextthrd); // Switch context.
     restore_interrupts(pie);
     if (old_thr->state == THREAD_EXITED) {
         // kfree(old_thr->stack_lowest); // Free its stack & resources.
         free_phys_page(old_thr->stack_lowest);
+        if (old_thr->detached)
+            thread_reclaim(old_thr->id);
     }
 }
 
@@ -611,6 +703,24 @@ struct thread * tlremove(struct thread_list * list) {
 
 // Appends elements of l1 to the end of l0 and clears l1.
 
+// Removes _thr_ from anywhere in _list_.
+
+void tlunlink(struct thread_list * list, struct thread * thr) {
+    struct thread ** pp;
+    struct thread * prev = NULL;
+
+    for (pp = &list->head; *pp != NULL; pp = &(*pp)->list_next) {
+        if (*pp == thr) {
+            *pp = thr->list_next;
+            if (list->tail == thr)
+                list->tail = prev;
+            thr->list_next = NULL;
+            return;
+        }
+        prev = *pp;
+    }
+}
+
 // void tlappend(struct thread_list * l0, struct thread_list * l1) {
 //     if (l0->head != NULL) {
 //         assert(l0->tail != NULL);
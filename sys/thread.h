@@ -73,6 +73,13 @@ extern void thread_yield(void);
 
 extern int thread_join(int tid);
 
+// void thread_detach(int tid)
+//
+// Marks a child of the running thread as detached: nobody will join it, and
+// its thread slot is reclaimed as soon as it exits.
+
+extern void thread_detach(int tid);
+
 // void thread_exit(void)
 //
 // Terminates the currently running thread. This function does not return.
@@ -117,6 +124,32 @@ extern void condition_wait(struct condition * cond);
 
 extern void condition_broadcast(struct condition * cond);
 
+// int condition_signal(struct condition * cond)
+
+// Wakes up the thread that has been waiting longest on a condition, if any.
+// Returns 1 if a thread was woken and 0 if the wait list was empty. Like
+// condition_broadcast(), it may be called from an ISR and does not cause a
+// context switch.
+
+extern int condition_signal(struct condition * cond);
+
+// int condition_wait_intr(struct condition * cond)
+
+// Like condition_wait(), but for waits that may last indefinitely on behalf of
+// a user process. Returns -EINTR without waiting, or after waking, if the
+// running thread's process is exiting, and 0 otherwise. Callers loop on their
+// condition as with condition_wait() and give up on -EINTR.
+
+extern int condition_wait_intr(struct condition * cond);
+
+// void thread_interrupt_process(struct process * proc)
+
+// Wakes every thread of _proc_ other than the caller that is blocked in
+// condition_wait_intr(). Called by process_exit after setting _exiting_.
+
+struct process;
+extern void thread_interrupt_process(struct process * proc);
+
 //////
 struct process *thread_process(int tid);
 struct process *running_thread_process(void);
@@ -94,6 +94,37 @@ void alarm_sleep(struct alarm *al, unsigned long long tcnt) {
     csrs_sie(RISCV_SIE_STIE); // enable timer intr again
 }
 
+void alarm_arm(struct alarm * al, unsigned long long tcnt) {
+    struct alarm **curr;
+    int pie;
+
+    al->twake = (UINT64_MAX - al->twake < tcnt) ? UINT64_MAX : al->twake + tcnt;
+
+    pie = disable_interrupts();
+    curr = &sleep_list;
+    while (*curr && (*curr)->twake < al->twake) curr = &(*curr)->next;
+    al->next = *curr;
+    *curr = al;
+    if (sleep_list == al) set_stcmp(al->twake);
+    csrs_sie(RISCV_SIE_STIE);
+    restore_interrupts(pie);
+}
+
+void alarm_cancel(struct alarm * al) {
+    struct alarm **curr;
+    int pie;
+
+    pie = disable_interrupts();
+    for (curr = &sleep_list; *curr != NULL; curr = &(*curr)->next) {
+        if (*curr == al) {
+            *curr = al->next;
+            break;
+        }
+    }
+    al->next = NULL;
+    restore_interrupts(pie);
+}
+
 // Resets the alarm so that the next sleep increment is relative to the time
 // alarm_reset is called.
 
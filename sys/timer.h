@@ -40,6 +40,14 @@ extern void alarm_sleep(struct alarm * al, unsigned long long tcnt);
 
 extern void alarm_reset(struct alarm * al);
 
+// Arms an alarm without sleeping: _tcnt_ ticks after the most recent alarm
+// event, the alarm's condition is broadcast. A thread can then wait on
+// _al->cond_ for either the alarm or something else that broadcasts it.
+// alarm_cancel disarms an alarm that may or may not have gone off.
+
+extern void alarm_arm(struct alarm * al, unsigned long long tcnt);
+extern void alarm_cancel(struct alarm * al);
+
 extern void alarm_sleep_sec(struct alarm * al, unsigned int sec);
 extern void alarm_sleep_ms(struct alarm * al, unsigned long ms);
 extern void alarm_sleep_us(struct alarm * al, unsigned long us);
@@ -80,6 +80,12 @@
         .equ    KGP, 1*8
         .equ    KTP, 0*8
 
+        # Constants for the ecall fast path. These must match riscv.h and
+        # scnum.h, which we can't include here.
+
+        .equ    SCAUSE_ECALL_FROM_UMODE, 8
+        .equ    SYSCALL_FORK, 2
+
 _smode_trap_entry:
 
         # Swap _sp_ and _sscratch_. When we're in U mode, sscratch contains a
@@ -94,6 +100,15 @@ smode_trap_entry_from_umode:
 
         #on entry: sp is ptr to trap frame
 
+        # System calls take a separate, shorter path (below). Check _scause_
+        # using _t6_, which the full save below stores again anyway.
+
+        sd      t6, T6(sp)
+        csrr    t6, scause
+        addi    t6, t6, -SCAUSE_ECALL_FROM_UMODE
+        beqz    t6, umode_syscall_entry
+        ld      t6, T6(sp)
+
        # csrrw   sp, sscratch, sp      # Get kernel SP back from sscratch
         #addi    sp, sp, -TFRSZ          # Allocate trap frame
         # Save general purpose registers to trap frame
@@ -211,6 +226,100 @@ smode_trap_entry_from_umode:
 
         sret    # done!
 
+umode_syscall_entry:
+
+        # U mode code reaches ecall through a stub in usr/syscall.S, which is
+        # called like any C function, so the caller already treats _t0_-_t6_
+        # and _a0_-_a7_ as clobbered. The C handler preserves _s0_-_s11_ for
+        # us. We save only the arguments, the registers the kernel changes
+        # (_ra_, _sp_, _gp_, _tp_, _fp_) and the CSRs. The one exception is
+        # fork, which copies the whole trap frame into the child, so for it
+        # we also save _s1_-_s11_.
+        #
+        # This path has not been timed against the full save in
+        # smode_trap_entry_from_umode. Compare the null_syscall lines of
+        # usr/sysbench on both kernels before relying on it being faster.
+
+        sd      a0, A0(sp)
+        sd      a1, A1(sp)
+        sd      a2, A2(sp)
+        sd      a3, A3(sp)
+        sd      a4, A4(sp)
+        sd      a5, A5(sp)
+        sd      a6, A6(sp)
+        sd      a7, A7(sp)
+        sd      ra, RA(sp)
+        sd      fp, FP(sp)
+        sd      tp, TP(sp)
+        sd      gp, GP(sp)
+
+        csrrw   t6, sscratch, zero      # user sp; sscratch=0 means S mode
+        sd      t6, SP(sp)
+        csrr    t6, sstatus
+        sd      t6, SSTATUS(sp)
+        csrr    t6, sepc
+        sd      t6, SEPC(sp)
+
+        li      t6, SYSCALL_FORK
+        bne     a7, t6, 1f
+
+        sd      s1, S1(sp)
+        sd      s2, S2(sp)
+        sd      s3, S3(sp)
+        sd      s4, S4(sp)
+        sd      s5, S5(sp)
+        sd      s6, S6(sp)
+        sd      s7, S7(sp)
+        sd      s8, S8(sp)
+        sd      s9, S9(sp)
+        sd      s10, S10(sp)
+        sd      s11, S11(sp)
+1:
+        addi    fp, sp, TFRSZ
+        ld      tp, KTP(fp)
+        ld      gp, KGP(fp)
+
+        mv      a0, sp
+        call    handle_syscall  # in syscall.c
+
+        # Restore _sstatus_ first so interrupts are disabled while we put back
+        # the U mode registers. Only _a0_ carries a result; _sp_ is still the
+        # trap frame pointer because the C handler preserves it.
+
+        ld      t6, SSTATUS(sp)
+        csrw    sstatus, t6
+        ld      t6, SEPC(sp)
+        csrw    sepc, t6
+
+        # The registers we do not restore hold whatever the kernel left in
+        # them. Clear them so no kernel pointers or data reach U mode.
+
+        li      a1, 0
+        li      a2, 0
+        li      a3, 0
+        li      a4, 0
+        li      a5, 0
+        li      a6, 0
+        li      a7, 0
+        li      t0, 0
+        li      t1, 0
+        li      t2, 0
+        li      t3, 0
+        li      t4, 0
+        li      t5, 0
+        li      t6, 0
+
+        ld      a0, A0(sp)
+        ld      ra, RA(sp)
+        ld      fp, FP(sp)
+        ld      tp, TP(sp)
+        ld      gp, GP(sp)
+
+        csrw    sscratch, sp
+        ld      sp, SP(sp)
+
+        sret
+
 smode_trap_entry_from_smode:
 
         # When we're in S mode, we continue using the kernel _sp_, _tp_, and
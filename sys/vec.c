@@ -0,0 +1,230 @@
+// vec.c - RISC-V vector extension support
+//
+// Copyright (c) 2024-2025 University of Illinois
+// SPDX-License-identifier: NCSA
+//
+
+#include "vec.h"
+#include "conf.h"
+#include "riscv.h"
+#include "thread.h"
+#include "intr.h"
+#include "heap.h"
+#include "console.h"
+#include "assert.h"
+
+#include <stdint.h>
+
+// INTERNAL MACRO DEFINITIONS
+//
+
+// The rest of the kernel is compiled without V (and without F and D), so that
+// the compiler never emits vector instructions outside vec_begin/vec_end. The
+// few vector instructions here enable it just for themselves.
+
+#define VEC_ASM(s) ".option push\n.option arch, +v\n" s ".option pop\n"
+
+// INTERNAL TYPE DEFINITIONS
+//
+
+struct vstate {
+    unsigned long vl;
+    unsigned long vtype;
+    unsigned long vstart;
+    unsigned long vcsr;
+    char vregs[]; // 32*vlenb bytes
+};
+
+// INTERNAL FUNCTION DECLARATIONS
+//
+
+static int vec_begin(void);
+static void vec_end(int pie);
+static void vec_save_owner(void);
+
+// Defined in vecasm.s
+
+extern void _vec_save(void * area);
+extern void _vec_restore(const void * area);
+extern void _vec_memcpy(void * dst, const void * src, size_t n);
+extern void _vec_memset(void * s, int c, size_t n);
+extern size_t _vec_memdiff(const void * p1, const void * p2, size_t n);
+
+// EXPORTED GLOBAL VARIABLES
+//
+
+char vec_enabled = 0;
+char vec_busy = 0;
+
+// INTERNAL GLOBAL VARIABLES
+//
+
+static unsigned long vec_vlenb;
+
+// vstates[tid] is allocated on a thread's first vector instruction. The owner
+// is the thread whose state is in the vector registers; its trap frame is the
+// one at the top of its kernel stack, where its sstatus.VS is turned off
+// again when the registers are taken away from it.
+
+static struct vstate * vstates[NTHR];
+static int vec_owner = -1;
+static struct trap_frame * vec_owner_tfr;
+
+// EXPORTED FUNCTION DEFINITIONS
+//
+
+// sstatus.VS is WARL and stays zero on a hart without the vector unit, so
+// setting it and reading it back tells us whether we have one.
+
+void vec_init(void) {
+    csrs_sstatus(RISCV_SSTATUS_VS_INITIAL);
+
+    if ((csrr_sstatus() & RISCV_SSTATUS_VS) != 0) {
+        asm (VEC_ASM("csrr %0, vlenb\n") : "=r" (vec_vlenb));
+        vec_enabled = 1;
+        kprintf("vec: VLEN=%lu\n", 8 * vec_vlenb);
+    } else
+        kprintf("vec: no vector unit, using scalar code\n");
+
+    csrc_sstatus(RISCV_SSTATUS_VS);
+}
+
+int vec_fault(struct trap_frame * tfr) {
+    const int tid = running_thread();
+    int pie;
+
+    // We do not decode the instruction. If it was illegal for another reason,
+    // the thread traps again with VS on and is handled as before.
+
+    if (!vec_enabled || (tfr->sstatus & RISCV_SSTATUS_VS) != 0)
+        return 0;
+
+    // A kernel vector routine only gives up the unit if it blocks, which it
+    // does not.
+
+    assert (!vec_busy);
+
+    if (vstates[tid] == NULL) {
+        vstates[tid] = kcalloc(1, sizeof(struct vstate) + 32 * vec_vlenb);
+        if (vstates[tid] == NULL)
+            return 0;
+    }
+
+    pie = disable_interrupts();
+
+    if (vec_owner != tid) {
+        vec_save_owner();
+
+        csrs_sstatus(RISCV_SSTATUS_VS_DIRTY);
+        _vec_restore(vstates[tid]->vregs);
+        asm volatile (VEC_ASM(
+        "   vsetvl  zero, %0, %1    \n"
+        "   csrw    vstart, %2      \n"
+        "   csrw    vcsr, %3        \n")
+        :: "r" (vstates[tid]->vl), "r" (vstates[tid]->vtype),
+           "r" (vstates[tid]->vstart), "r" (vstates[tid]->vcsr));
+
+        vec_owner = tid;
+    }
+
+    vec_owner_tfr = tfr;
+    tfr->sstatus |= RISCV_SSTATUS_VS_DIRTY;
+
+    restore_interrupts(pie);
+    return 1;
+}
+
+void vec_thread_exit(int tid) {
+    int pie;
+
+    pie = disable_interrupts();
+    if (vec_owner == tid) {
+        vec_owner = -1;
+        vec_owner_tfr = NULL;
+    }
+    restore_interrupts(pie);
+
+    kfree(vstates[tid]);
+    vstates[tid] = NULL;
+}
+
+void * vec_memcpy(void * restrict dst, const void * restrict src, size_t n) {
+    int pie;
+
+    pie = vec_begin();
+    _vec_memcpy(dst, src, n);
+    vec_end(pie);
+
+    return dst;
+}
+
+void * vec_memset(void * s, int c, size_t n) {
+    int pie;
+
+    pie = vec_begin();
+    _vec_memset(s, c, n);
+    vec_end(pie);
+
+    return s;
+}
+
+int vec_memcmp(const void * p1, const void * p2, size_t n) {
+    const uint8_t * const u = p1;
+    const uint8_t * const v = p2;
+    size_t i;
+    int pie;
+
+    pie = vec_begin();
+    i = _vec_memdiff(p1, p2, n);
+    vec_end(pie);
+
+    return (i < n) ? (u[i] - v[i]) : 0;
+}
+
+// INTERNAL FUNCTION DEFINITIONS
+//
+
+// Kernel vector routines run with interrupts disabled, so an ISR cannot use
+// the unit underneath them. A page fault taken inside one (the kernel writing
+// to a copy-on-write user page) sees vec_busy and copies with scalar code.
+
+int vec_begin(void) {
+    int pie;
+
+    pie = disable_interrupts();
+    vec_busy = 1;
+    vec_save_owner();
+    csrs_sstatus(RISCV_SSTATUS_VS_DIRTY);
+    return pie;
+}
+
+void vec_end(int pie) {
+    csrc_sstatus(RISCV_SSTATUS_VS);
+    vec_busy = 0;
+    restore_interrupts(pie);
+}
+
+// Saves the owner's registers and takes the unit away from it, so that its
+// next vector instruction traps to vec_fault. Called with interrupts disabled.
+
+void vec_save_owner(void) {
+    struct vstate * vs;
+
+    if (vec_owner < 0)
+        return;
+
+    vs = vstates[vec_owner];
+
+    csrs_sstatus(RISCV_SSTATUS_VS_DIRTY);
+    asm volatile (VEC_ASM(
+    "   csrr    %0, vl          \n"
+    "   csrr    %1, vtype       \n"
+    "   csrr    %2, vstart      \n"
+    "   csrr    %3, vcsr        \n")
+    :   "=r" (vs->vl), "=r" (vs->vtype), "=r" (vs->vstart), "=r" (vs->vcsr));
+    _vec_save(vs->vregs);
+
+    vec_owner_tfr->sstatus &= ~RISCV_SSTATUS_VS;
+    vec_owner = -1;
+    vec_owner_tfr = NULL;
+}
@@ -0,0 +1,56 @@
+// vec.h - RISC-V vector extension support
+//
+// Copyright (c) 2024-2025 University of Illinois
+// SPDX-License-identifier: NCSA
+//
+
+#ifndef _VEC_H_
+#define _VEC_H_
+
+#include "trap.h"
+
+#include <stddef.h>
+
+// Only used in kernels built with RVV=1 (see Makefile), which compiles
+// vec.c and vecasm.s and defines RVV. vec_init checks at boot whether the
+// hart actually has the vector unit; if not, vec_enabled stays 0 and string.c
+// keeps using its scalar code.
+//
+// User threads start with the vector unit off (sstatus.VS = 0) and are given
+// it the first time they use it, through the illegal instruction trap. The
+// vector registers hold the state of one user thread at a time, the owner,
+// and are only saved when another thread, or the kernel, needs them.
+
+// Buffers shorter than VEC_MIN_BYTES are not worth saving the owner's
+// registers for.
+
+#ifndef VEC_MIN_BYTES
+#define VEC_MIN_BYTES 256
+#endif
+
+extern char vec_enabled;
+extern char vec_busy; // set while the kernel is using the vector unit
+
+static inline int vec_usable(size_t n) {
+    return (VEC_MIN_BYTES <= n && vec_enabled && !vec_busy);
+}
+
+extern void vec_init(void);
+
+// Called for an illegal instruction trap from U mode. Returns 1 if the trap
+// was (presumably) a first use of the vector unit and the thread was given
+// it, 0 if the trap should be handled as before.
+
+extern int vec_fault(struct trap_frame * tfr);
+
+// Releases the saved vector state of an exited thread.
+
+extern void vec_thread_exit(int tid);
+
+// Vector versions of the string.c functions. Callers check vec_usable first.
+
+extern void * vec_memcpy(void * restrict dst, const void * restrict src, size_t n);
+extern void * vec_memset(void * s, int c, size_t n);
+extern int vec_memcmp(const void * p1, const void * p2, size_t n);
+
+#endif // _VEC_H_
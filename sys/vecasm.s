@@ -0,0 +1,104 @@
+# vecasm.s - Vector routines called from vec.c
+#
+# Copyright (c) 2024-2025 University of Illinois
+# SPDX-License-identifier: NCSA
+#
+
+# All loops use e8 with LMUL=8, so each iteration moves 8*VLEN/8 bytes, and
+# leave vl and vtype changed. The callers in vec.c have already saved any user
+# state in the vector registers.
+
+        .text
+
+        # The kernel is assembled for rv64imazicsr; only this file uses V.
+
+        .option arch, +v
+
+# void _vec_save(void * area)
+# void _vec_restore(const void * area)
+
+# Store or load v0-v31 at _area_, which must hold 32*vlenb bytes. The CSRs
+# (vl, vtype, vstart, vcsr) are handled in vec.c.
+
+        .global _vec_save
+        .type   _vec_save, @function
+_vec_save:
+        vsetvli t0, zero, e8, m8, ta, ma
+        vs8r.v  v0, (a0)
+        add     a0, a0, t0
+        vs8r.v  v8, (a0)
+        add     a0, a0, t0
+        vs8r.v  v16, (a0)
+        add     a0, a0, t0
+        vs8r.v  v24, (a0)
+        ret
+
+        .global _vec_restore
+        .type   _vec_restore, @function
+_vec_restore:
+        vsetvli t0, zero, e8, m8, ta, ma
+        vl8re8.v v0, (a0)
+        add     a0, a0, t0
+        vl8re8.v v8, (a0)
+        add     a0, a0, t0
+        vl8re8.v v16, (a0)
+        add     a0, a0, t0
+        vl8re8.v v24, (a0)
+        ret
+
+# void _vec_memcpy(void * dst, const void * src, size_t n)
+
+        .global _vec_memcpy
+        .type   _vec_memcpy, @function
+_vec_memcpy:
+        beqz    a2, 2f
+1:      vsetvli t0, a2, e8, m8, ta, ma
+        vle8.v  v0, (a1)
+        vse8.v  v0, (a0)
+        add     a0, a0, t0
+        add     a1, a1, t0
+        sub     a2, a2, t0
+        bnez    a2, 1b
+2:      ret
+
+# void _vec_memset(void * s, int c, size_t n)
+
+        .global _vec_memset
+        .type   _vec_memset, @function
+_vec_memset:
+        beqz    a2, 2f
+        vsetvli t0, a2, e8, m8, ta, ma
+        vmv.v.x v0, a1
+1:      vsetvli t0, a2, e8, m8, ta, ma
+        vse8.v  v0, (a0)
+        add     a0, a0, t0
+        sub     a2, a2, t0
+        bnez    a2, 1b
+2:      ret
+
+# size_t _vec_memdiff(const void * p1, const void * p2, size_t n)
+
+# Returns the offset of the first byte that differs, or _n_ if none does.
+
+        .global _vec_memdiff
+        .type   _vec_memdiff, @function
+_vec_memdiff:
+        mv      t1, zero
+        beqz    a2, 2f
+1:      vsetvli t0, a2, e8, m8, ta, ma
+        vle8.v  v0, (a0)
+        vle8.v  v8, (a1)
+        vmsne.vv v16, v0, v8
+        vfirst.m t2, v16
+        bgez    t2, 3f
+        add     a0, a0, t0
+        add     a1, a1, t0
+        add     t1, t1, t0
+        sub     a2, a2, t0
+        bnez    a2, 1b
+2:      mv      a0, t1
+        ret
+3:      add     a0, t1, t2
+        ret
+
+        .end
@@ -0,0 +1,183 @@
+// work.c - Deferred interrupt work (tasklets) and kernel workqueues
+//
+// Copyright (c) 2024-2025 University of Illinois
+// SPDX-License-identifier: NCSA
+//
+
+#ifdef WORK_TRACE
+#define TRACE
+#endif
+
+#ifdef WORK_DEBUG
+#define DEBUG
+#endif
+
+#include "work.h"
+#include "thread.h"
+#include "intr.h"
+#include "console.h"
+#include "assert.h"
+
+#include <stddef.h>
+
+// EXPORTED GLOBAL VARIABLE DEFINITIONS
+//
+
+char workmgr_initialized = 0;
+struct workqueue system_wq;
+
+// INTERNAL GLOBAL VARIABLE DEFINITIONS
+//
+
+static struct {
+    struct tasklet * head;
+    struct tasklet * tail;
+    char running; // set while run_tasklets is draining the list
+} tasklet_list;
+
+// INTERNAL FUNCTION DECLARATIONS
+//
+
+static void worker(struct workqueue * wq);
+
+// EXPORTED FUNCTION DEFINITIONS
+//
+
+void workmgr_init(void) {
+    int result;
+
+    trace("%s()", __func__);
+
+    result = workqueue_init(&system_wq, "events");
+    assert (0 <= result);
+
+    workmgr_initialized = 1;
+}
+
+void tasklet_init(struct tasklet * t, void (*fn)(void * aux), void * aux) {
+    t->next = NULL;
+    t->fn = fn;
+    t->aux = aux;
+    t->pending = 0;
+}
+
+void tasklet_schedule(struct tasklet * t) {
+    int pie;
+
+    pie = disable_interrupts();
+
+    if (!t->pending) {
+        t->pending = 1;
+        t->next = NULL;
+
+        if (tasklet_list.tail != NULL)
+            tasklet_list.tail->next = t;
+        else
+            tasklet_list.head = t;
+
+        tasklet_list.tail = t;
+    }
+
+    restore_interrupts(pie);
+}
+
+void run_tasklets(void) {
+    struct tasklet * t;
+
+    // A nested interrupt taken while tasklets are running must not start a
+    // second drain; the outer loop will pick up anything it schedules.
+
+    if (tasklet_list.running)
+        return;
+
+    tasklet_list.running = 1;
+
+    while ((t = tasklet_list.head) != NULL) {
+        tasklet_list.head = t->next;
+        if (tasklet_list.head == NULL)
+            tasklet_list.tail = NULL;
+        t->next = NULL;
+        t->pending = 0;
+
+        enable_interrupts();
+        t->fn(t->aux);
+        disable_interrupts();
+    }
+
+    tasklet_list.running = 0;
+}
+
+void work_init(struct work * w, void (*fn)(void * aux), void * aux) {
+    w->next = NULL;
+    w->fn = fn;
+    w->aux = aux;
+    w->queued = 0;
+}
+
+int workqueue_init(struct workqueue * wq, const char * name) {
+    int tid;
+
+    wq->name = name;
+    wq->head = NULL;
+    wq->tail = NULL;
+    condition_init(&wq->ready, name);
+
+    tid = thread_spawn(name, (void (*)(void))&worker, wq);
+
+    if (tid < 0)
+        return tid;
+
+    wq->tid = tid;
+    return 0;
+}
+
+int queue_work(struct workqueue * wq, struct work * w) {
+    int pie;
+
+    pie = disable_interrupts();
+
+    if (w->queued) {
+        restore_interrupts(pie);
+        return 0;
+    }
+
+    w->queued = 1;
+    w->next = NULL;
+
+    if (wq->tail != NULL)
+        wq->tail->next = w;
+    else
+        wq->head = w;
+
+    wq->tail = w;
+    condition_broadcast(&wq->ready);
+    restore_interrupts(pie);
+    return 1;
+}
+
+// INTERNAL FUNCTION DEFINITIONS
+//
+
+void worker(struct workqueue * wq) {
+    struct work * w;
+    int pie;
+
+    for (;;) {
+        pie = disable_interrupts();
+
+        while (wq->head == NULL)
+            condition_wait(&wq->ready);
+
+        w = wq->head;
+        wq->head = w->next;
+        if (wq->head == NULL)
+            wq->tail = NULL;
+        w->next = NULL;
+        w->queued = 0;
+
+        restore_interrupts(pie);
+
+        debug("%s: running work %p", wq->name, w);
+        w->fn(w->aux);
+    }
+}
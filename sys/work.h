@@ -0,0 +1,85 @@
+// work.h - Deferred interrupt work (tasklets) and kernel workqueues
+//
+// Copyright (c) 2024-2025 University of Illinois
+// SPDX-License-identifier: NCSA
+//
+
+#ifndef _WORK_H_
+#define _WORK_H_
+
+#include "thread.h" // for struct condition
+
+// A tasklet is a bottom half: a short function an ISR schedules to run after
+// the interrupt has been acknowledged at the PLIC. Pending tasklets are run on
+// interrupt exit with interrupts enabled. Like an ISR, a tasklet function must
+// not block. A tasklet scheduled again while pending runs only once.
+
+struct tasklet {
+    struct tasklet * next;
+    void (*fn)(void * aux);
+    void * aux;
+    char pending;
+};
+
+// A work item is run by a workqueue's worker thread, so it may block (wait on a
+// condition, acquire a lock, perform I/O). Work items may be queued from an ISR
+// or a tasklet.
+
+struct work {
+    struct work * next;
+    void (*fn)(void * aux);
+    void * aux;
+    char queued;
+};
+
+struct workqueue {
+    const char * name;
+    struct work * head;
+    struct work * tail;
+    struct condition ready;
+    int tid;
+};
+
+// EXPORTED GLOBAL VARIABLE DECLARATIONS
+//
+
+extern char workmgr_initialized;
+extern struct workqueue system_wq;
+
+// EXPORTED FUNCTION DECLARATIONS
+//
+
+// Starts the worker thread for system_wq. Must be called after thrmgr_init()
+// and memory_init().
+
+extern void workmgr_init(void);
+
+extern void tasklet_init(struct tasklet * t, void (*fn)(void * aux), void * aux);
+
+// Marks a tasklet pending. May be called from an ISR.
+
+extern void tasklet_schedule(struct tasklet * t);
+
+// Runs all pending tasklets. Called from the interrupt handler on the way out
+// of an interrupt, with interrupts disabled. Interrupts are enabled while each
+// tasklet runs and disabled again on return.
+
+extern void run_tasklets(void);
+
+extern void work_init(struct work * w, void (*fn)(void * aux), void * aux);
+
+// Initializes a workqueue and spawns its worker thread. Returns 0 on success or
+// a negative error code if the worker thread could not be created.
+
+extern int workqueue_init(struct workqueue * wq, const char * name);
+
+// Appends a work item to a workqueue. Returns 1 if the item was queued and 0 if
+// it was already queued. May be called from an ISR.
+
+extern int queue_work(struct workqueue * wq, struct work * w);
+
+static inline int schedule_work(struct work * w) {
+    return queue_work(&system_wq, w);
+}
+
+#endif // _WORK_H_
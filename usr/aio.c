@@ -0,0 +1,55 @@
+// aio.c - Asynchronous I/O rings
+//
+// Copyright (c) 2024-2025 University of Illinois
+// SPDX-License-identifier: NCSA
+//
+
+#include "aio.h"
+#include "syscall.h"
+#include "string.h"
+
+int aio_init(struct aio_ring * ring) {
+    // Touch every page of the ring so it is mapped before the kernel checks.
+
+    memset(ring, 0, sizeof(struct aio_ring));
+    return _aio_setup(ring);
+}
+
+int aio_prep (
+    struct aio_ring * ring, int op, int fd,
+    unsigned long long pos, void * buf, long len, unsigned long tag)
+{
+    struct aio_sqe * sqe;
+
+    if (ring->sq_tail - ring->sq_head == AIO_NENT)
+        return -1;
+
+    sqe = &ring->sq[ring->sq_tail % AIO_NENT];
+    sqe->op = op;
+    sqe->fd = fd;
+    sqe->pos = pos;
+    sqe->buf = buf;
+    sqe->len = len;
+    sqe->tag = tag;
+
+    // The entry must be complete before the kernel can see the new tail.
+
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    ring->sq_tail += 1;
+    return 0;
+}
+
+int aio_submit(struct aio_ring * ring, unsigned int min_complete) {
+    return _aio_enter(min_complete);
+}
+
+int aio_reap(struct aio_ring * ring, struct aio_cqe * cqe) {
+    if (ring->cq_head == ring->cq_tail)
+        return 0;
+
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    *cqe = ring->cq[ring->cq_head % AIO_NENT];
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    ring->cq_head += 1;
+    return 1;
+}
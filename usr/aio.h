@@ -0,0 +1,70 @@
+// aio.h - Asynchronous I/O rings
+//
+// Copyright (c) 2024-2025 University of Illinois
+// SPDX-License-identifier: NCSA
+//
+
+#ifndef _AIO_H_
+#define _AIO_H_
+
+// The ring lives in our memory and is shared with the kernel's AIO workers
+// for this process. Queue requests with aio_prep(), start them with
+// aio_submit(), and pick up results with aio_reap(). Several requests may be
+// in progress at once, even from a single-threaded program. Completions can
+// arrive out of order; use the tag to match them to requests.
+//
+// The layout must match sys/aio.h.
+
+#define AIO_NENT 32 // entries per ring (power of two)
+
+#define AIO_OP_READ     0 // _read at the file position
+#define AIO_OP_WRITE    1 // _write at the file position
+#define AIO_OP_READAT   2 // read at _pos_
+#define AIO_OP_WRITEAT  3 // write at _pos_
+#define AIO_OP_FSYNC    4 // flush the filesystem
+
+struct aio_sqe {
+    int op;
+    int fd;
+    unsigned long long pos;
+    void * buf;
+    long len;
+    unsigned long tag; // copied to the completion entry
+};
+
+struct aio_cqe {
+    unsigned long tag;
+    long result; // byte count or negative error code
+};
+
+struct aio_ring {
+    volatile unsigned int sq_head; // advanced by kernel
+    volatile unsigned int sq_tail; // advanced by us
+    volatile unsigned int cq_head; // advanced by us
+    volatile unsigned int cq_tail; // advanced by kernel
+    struct aio_sqe sq[AIO_NENT];
+    struct aio_cqe cq[AIO_NENT];
+};
+
+// Registers _ring_ with the kernel. Returns 0 on success.
+
+extern int aio_init(struct aio_ring * ring);
+
+// Queues a request without entering the kernel. Returns 0 on success or -1 if
+// the submission ring is full.
+
+extern int aio_prep (
+    struct aio_ring * ring, int op, int fd,
+    unsigned long long pos, void * buf, long len, unsigned long tag);
+
+// Hands queued requests to the kernel and waits until at least _min_complete_
+// completions are available. Returns the number available.
+
+extern int aio_submit(struct aio_ring * ring, unsigned int min_complete);
+
+// Removes one completion and copies it to _cqe_. Returns 1 if there was one
+// and 0 otherwise. Does not enter the kernel.
+
+extern int aio_reap(struct aio_ring * ring, struct aio_cqe * cqe);
+
+#endif // _AIO_H_
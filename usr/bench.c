@@ -0,0 +1,34 @@
+// bench.c - Common timing and reporting for the benchmark programs
+//
+// Copyright (c) 2024-2025 University of Illinois
+// SPDX-License-identifier: NCSA
+//
+
+#include "bench.h"
+#include "string.h"
+
+void bench_start(struct bench * b) {
+    b->time = rdtime();
+    b->cycle = rdcycle();
+}
+
+void bench_stop(struct bench * b, const char * name,
+    unsigned long ops, unsigned long bytes)
+{
+    const unsigned long cycles = rdcycle() - b->cycle;
+    const unsigned long ticks = rdtime() - b->time;
+
+    if (ops == 0)
+        ops = 1;
+
+    printf("BENCH name=%s ops=%lu cycles_per_op=%lu ns_per_op=%lu "
+        "ops_per_sec=%lu", name, ops, cycles / ops,
+        ticks * (1000000000UL / BENCH_TIMER_FREQ) / ops,
+        (ticks != 0) ? ops * BENCH_TIMER_FREQ / ticks : 0UL);
+
+    if (bytes != 0)
+        printf(" kb_per_sec=%lu",
+            (ticks != 0) ? bytes / 1024 * BENCH_TIMER_FREQ / ticks : 0UL);
+
+    printf("\n");
+}
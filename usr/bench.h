@@ -0,0 +1,43 @@
+// bench.h - Common timing and reporting for the benchmark programs
+//
+// Copyright (c) 2024-2025 University of Illinois
+// SPDX-License-identifier: NCSA
+//
+
+// Every benchmark prints its results as lines of the form
+//
+//     BENCH name=<name> ops=<n> cycles_per_op=<c> ns_per_op=<t> ops_per_sec=<r>
+//
+// the same format sys/main_bench.c uses, with " kb_per_sec=<k>" appended for
+// tests that move data. Collect them with grep '^BENCH' and diff two runs.
+
+#ifndef _BENCH_H_
+#define _BENCH_H_
+
+#define BENCH_TIMER_FREQ 10000000UL // sys/conf.h
+
+struct bench {
+    unsigned long cycle;
+    unsigned long time;
+};
+
+static inline unsigned long rdcycle(void) {
+    unsigned long c;
+    asm volatile ("rdcycle %0" : "=r" (c));
+    return c;
+}
+
+static inline unsigned long rdtime(void) {
+    unsigned long t;
+    asm volatile ("rdtime %0" : "=r" (t));
+    return t;
+}
+
+// bench_stop() reports _ops_ operations timed since bench_start(). If _bytes_
+// is not zero, the throughput is reported as well.
+
+extern void bench_start(struct bench * b);
+extern void bench_stop(struct bench * b, const char * name,
+    unsigned long ops, unsigned long bytes);
+
+#endif // _BENCH_H_
@@ -0,0 +1,63 @@
+// faultbench.c - Page fault microbenchmark
+//
+// Copyright (c) 2024-2025 University of Illinois
+// SPDX-License-identifier: NCSA
+//
+
+// Times demand-zero faults by touching fresh pages in an unused part of the
+// user address space, then copy-on-write faults by writing to the same pages
+// after a fork. The child stays blocked on a pipe while the parent writes, so
+// every page is still shared and each write takes a full copy.
+
+#include "syscall.h"
+#include "string.h"
+#include "bench.h"
+
+#define PAGE_SIZE 4096
+#define NPAGES 256
+
+// Below the heap (see start.s) and above any program image.
+
+#define FAULT_BASE 0xD0000000UL
+
+static void fail(const char * what, int result) {
+    printf("faultbench: %s failed (%d)\n", what, result);
+    exit();
+}
+
+void main(void) {
+    volatile char * const base = (volatile char *)FAULT_BASE;
+    struct bench b;
+    int wfd, rfd;
+    int result;
+    char c;
+    int tid;
+    int i;
+
+    bench_start(&b);
+    for (i = 0; i < NPAGES; i++)
+        base[i * PAGE_SIZE] = 1;
+    bench_stop(&b, "fault_demand_zero", NPAGES, 0);
+
+    if ((result = _pipe(&wfd, &rfd)) < 0)
+        fail("pipe", result);
+
+    tid = _fork();
+
+    if (tid == 0) {
+        close(wfd);
+        _read(rfd, &c, 1); // returns at end of file
+        _exit();
+    } else if (tid < 0)
+        fail("fork", tid);
+
+    close(rfd);
+
+    bench_start(&b);
+    for (i = 0; i < NPAGES; i++)
+        base[i * PAGE_SIZE] = 2;
+    bench_stop(&b, "fault_cow", NPAGES, 0);
+
+    close(wfd);
+    _wait(tid);
+}
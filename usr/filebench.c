@@ -0,0 +1,98 @@
+// filebench.c - File read and write throughput microbenchmark
+//
+// Copyright (c) 2024-2025 University of Illinois
+// SPDX-License-identifier: NCSA
+//
+
+// Creates a scratch file, then times sequential and random positioned writes
+// and reads on it at several transfer sizes. Random transfers visit every
+// size-aligned position of the file once, in a fixed pseudo-random order, so
+// runs are comparable. The file is deleted at the end.
+
+#include "syscall.h"
+#include "string.h"
+#include "io.h"
+#include "bench.h"
+
+#define FILE_NAME "benchfile"
+#define FILE_SIZE (256*1024)
+#define MAX_XFER  (64*1024)
+
+static char buf[MAX_XFER];
+
+static void fail(const char * what, long result) {
+    printf("filebench: %s failed (%ld)\n", what, result);
+    _fsdelete(FILE_NAME);
+    exit();
+}
+
+// Returns the _i_th position of a permutation of 0..n-1, for n a power of two.
+// An odd multiplier and offset make i*a+c a bijection modulo n.
+
+static unsigned long permute(unsigned long i, unsigned long n) {
+    return (i * 2654435761UL + 12345) & (n - 1);
+}
+
+static void run(int fd, const char * name, size_t xfer, int rand, int wr) {
+    const unsigned long n = FILE_SIZE / xfer;
+    struct iovec iov = { .base = buf, .len = xfer };
+    unsigned long long pos;
+    struct bench b;
+    unsigned long i;
+    long result;
+
+    bench_start(&b);
+    for (i = 0; i < n; i++) {
+        pos = (rand ? permute(i, n) : i) * xfer;
+        if (wr)
+            result = _pwritev(fd, &iov, 1, pos);
+        else
+            result = _preadv(fd, &iov, 1, pos);
+        if (result != xfer)
+            fail(wr ? "write" : "read", result);
+    }
+    bench_stop(&b, name, n, FILE_SIZE);
+}
+
+void main(void) {
+    static const struct {
+        const char * names[4]; // seq write, seq read, rand write, rand read
+        size_t xfer;
+    } sizes[] = {
+        { { "file_seq_write_512", "file_seq_read_512",
+            "file_rand_write_512", "file_rand_read_512" }, 512 },
+        { { "file_seq_write_4k", "file_seq_read_4k",
+            "file_rand_write_4k", "file_rand_read_4k" }, 4096 },
+        { { "file_seq_write_64k", "file_seq_read_64k",
+            "file_rand_write_64k", "file_rand_read_64k" }, 64*1024 }
+    };
+
+    const unsigned long long end = FILE_SIZE;
+    int result;
+    int fd;
+    int s;
+
+    memset(buf, 'x', sizeof(buf));
+
+    result = _fscreate(FILE_NAME);
+    if (result < 0)
+        fail("create", result);
+
+    fd = _fsopen(-1, FILE_NAME);
+    if (fd < 0)
+        fail("open", fd);
+
+    result = _ioctl(fd, IOCTL_SETEND, (void *)&end);
+    if (result < 0)
+        fail("setend", result);
+
+    for (s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+        run(fd, sizes[s].names[0], sizes[s].xfer, 0, 1);
+        run(fd, sizes[s].names[1], sizes[s].xfer, 0, 0);
+        run(fd, sizes[s].names[2], sizes[s].xfer, 1, 1);
+        run(fd, sizes[s].names[3], sizes[s].xfer, 1, 0);
+    }
+
+    close(fd);
+    _fsdelete(FILE_NAME);
+}
@@ -0,0 +1,61 @@
+// forkbench.c - Process creation microbenchmark
+//
+// Copyright (c) 2024-2025 University of Illinois
+// SPDX-License-identifier: NCSA
+//
+
+// Times fork followed by wait for a child that exits at once, then fork, exec
+// and wait for a child that runs this program again with the argument -x,
+// which makes it exit at once. The second test reads forkbench from the file
+// system each time, so it includes loading the image.
+
+#include "syscall.h"
+#include "string.h"
+#include "bench.h"
+
+#define NITER_FORK 200
+#define NITER_EXEC 50
+
+static void fail(const char * what, int result) {
+    printf("forkbench: %s failed (%d)\n", what, result);
+    exit();
+}
+
+void main(int argc, char ** argv) {
+    char * xargv[] = { "-x", NULL };
+    struct bench b;
+    int self;
+    int tid;
+    int i;
+
+    if (0 < argc && strcmp(argv[0], "-x") == 0)
+        return;
+
+    bench_start(&b);
+    for (i = 0; i < NITER_FORK; i++) {
+        tid = _fork();
+        if (tid == 0)
+            _exit();
+        else if (tid < 0)
+            fail("fork", tid);
+        _wait(tid);
+    }
+    bench_stop(&b, "fork_wait", NITER_FORK, 0);
+
+    self = _fsopen(-1, "forkbench");
+    if (self < 0)
+        fail("open forkbench", self);
+
+    bench_start(&b);
+    for (i = 0; i < NITER_EXEC; i++) {
+        tid = _fork();
+        if (tid == 0)
+            fail("exec", _exec(self, 1, xargv));
+        else if (tid < 0)
+            fail("fork", tid);
+        _wait(tid);
+    }
+    bench_stop(&b, "fork_exec_wait", NITER_EXEC, 0);
+
+    close(self);
+}
@@ -0,0 +1,108 @@
+// futex_test.c - Mutex and condition variable test across fork
+//
+// Copyright (c) 2024-2025 University of Illinois
+// SPDX-License-identifier: NCSA
+//
+
+// Forks a child that stays alive (blocked on a pipe) so that all of the
+// parent's data pages are copy-on-write, then uses a mutex and a condition
+// variable from several threads in the parent. The condition variable has a
+// page of its own, so the waiter sleeps on it before anyone has written that
+// page and the signaler's store is what copies it. If futex waiters were keyed
+// by physical address, that wake-up would be lost and the test would hang.
+
+#include "syscall.h"
+#include "string.h"
+#include "thread.h"
+#include "sync.h"
+
+#define NWORKERS 4
+#define NITER 200
+
+static union {
+    struct condvar cv;
+    char page[4096];
+} __attribute__ ((aligned (4096))) ready_cv;
+
+static struct mutex mtx;
+static int ready;
+static int count;
+
+static void fail(const char * what, int result) {
+    printf("futex_test: %s failed (%d)\n", what, result);
+    exit();
+}
+
+static void waiter(void * arg) {
+    mutex_lock(&mtx);
+    while (!ready)
+        condvar_wait(&ready_cv.cv, &mtx);
+    count += 1;
+    mutex_unlock(&mtx);
+}
+
+static void worker(void * arg) {
+    int i;
+
+    for (i = 0; i < NITER; i++) {
+        mutex_lock(&mtx);
+        count += 1;
+        if (i % 16 == 0)
+            _usleep(100); // hold the lock long enough for others to block
+        mutex_unlock(&mtx);
+    }
+}
+
+void main(int argc, char ** argv) {
+    int tids[NWORKERS];
+    int wfd, rfd;
+    int child;
+    int tid;
+    char c;
+    int i;
+
+    if (_pipe(&wfd, &rfd) < 0)
+        fail("pipe", -1);
+
+    child = _fork();
+    if (child < 0)
+        fail("fork", child);
+
+    if (child == 0) {
+        // Hold on to the shared pages until the parent closes the pipe.
+        _close(wfd);
+        _read(rfd, &c, 1);
+        _exit();
+    }
+
+    _close(rfd);
+
+    tid = thread_create(waiter, NULL);
+    if (tid < 0)
+        fail("thread_create", tid);
+
+    _usleep(10000); // let the waiter go to sleep
+
+    mutex_lock(&mtx);
+    ready = 1;
+    condvar_signal(&ready_cv.cv);
+    mutex_unlock(&mtx);
+    thread_join(tid);
+
+    for (i = 0; i < NWORKERS; i++) {
+        tids[i] = thread_create(worker, NULL);
+        if (tids[i] < 0)
+            fail("thread_create", tids[i]);
+    }
+
+    for (i = 0; i < NWORKERS; i++)
+        thread_join(tids[i]);
+
+    _close(wfd);
+    _wait(child);
+
+    if (count != 1 + NWORKERS * NITER)
+        fail("count check", count);
+
+    printf("futex_test: PASSED\n");
+}
@@ -70,6 +70,7 @@ struct io_term {
 #define IOCTL_SETEND    3
 #define IOCTL_GETPOS    4
 #define IOCTL_SETPOS    5
+#define IOCTL_SETNONBLOCK 6
 
 // refcount functions
 unsigned long iorefcnt(const struct io * io);
@@ -0,0 +1,35 @@
+// ktdump.c - Stream the kernel trace ring to a serial port
+//
+// Copyright (c) 2024-2025 University of Illinois
+// SPDX-License-identifier: NCSA
+//
+
+// Copies the records in the kernel's trace ring (the kernel must be built with
+// -DKTRACE) to uart1, which the Makefile connects to a host pty. Capture them
+// on the host with cat and decode them with util/ktrace/ktdecode. The records
+// are written raw, so nothing else should be using uart1.
+
+#include "syscall.h"
+
+#define KTFD 3
+#define OUTFD 4
+
+#define NREC 64
+#define RECSZ 24 // sizeof(struct ktrace_rec) in sys/ktrace.h
+
+static char buf[NREC * RECSZ];
+
+void main(int argc, char ** argv) {
+    long n;
+
+    if (_devopen(KTFD, "ktrace", 0) < 0 || _devopen(OUTFD, "uart", 1) < 0) {
+        _print("ktdump: cannot open devices");
+        return;
+    }
+
+    while (0 < (n = _read(KTFD, buf, sizeof(buf))))
+        _write(OUTFD, buf, n);
+
+    _close(KTFD);
+    _close(OUTFD);
+}
@@ -0,0 +1,142 @@
+// membench.c - Memory and string function microbenchmark
+//
+// Copyright (c) 2024-2025 University of Illinois
+// SPDX-License-identifier: NCSA
+//
+
+// Times the library memcpy, memset, memcmp, strlen and strncmp against plain
+// byte loops at several sizes, with aligned buffers. The results are named
+// <function>_<size> and <function>_<size>_byte; the kernel's versions in
+// sys/string.c are the same code.
+
+#include "syscall.h"
+#include "string.h"
+#include "bench.h"
+
+#define NITER 64
+#define MAXSZ 16384
+
+static unsigned long bufa[MAXSZ / sizeof(unsigned long) + 1];
+static unsigned long bufb[MAXSZ / sizeof(unsigned long) + 1];
+
+static const unsigned int sizes[] = { 16, 64, 512, 4096, 16384 };
+
+static void byte_memcpy(void * dst, const void * src, size_t n) {
+    const char * q = src;
+    char * p = dst;
+
+    while (n-- != 0)
+        *p++ = *q++;
+}
+
+static void byte_memset(void * s, int c, size_t n) {
+    char * p = s;
+
+    while (n-- != 0)
+        *p++ = c;
+}
+
+static int byte_memcmp(const void * p1, const void * p2, size_t n) {
+    const unsigned char * u = p1;
+    const unsigned char * v = p2;
+
+    for (; n != 0; n--, u++, v++) {
+        if (*u != *v)
+            return *u - *v;
+    }
+
+    return 0;
+}
+
+static size_t byte_strlen(const char * s) {
+    const char * p = s;
+
+    while (*p != '\0')
+        p += 1;
+
+    return p - s;
+}
+
+static int byte_strncmp(const char * s1, const char * s2, size_t n) {
+    while (n != 0 && *s1 != '\0' && *s1 == *s2) {
+        s1 += 1;
+        s2 += 1;
+        n -= 1;
+    }
+
+    return (n != 0) ? (unsigned char)*s1 - (unsigned char)*s2 : 0;
+}
+
+static void report(const char * name, unsigned int sz, struct bench * t,
+    int byte)
+{
+    char namebuf[32];
+
+    snprintf(namebuf, sizeof(namebuf), "%s_%u%s",
+        name, sz, byte ? "_byte" : "");
+    bench_stop(t, namebuf, NITER, (unsigned long)NITER * sz);
+}
+
+void main(void) {
+    char * const a = (char *)bufa;
+    char * const b = (char *)bufb;
+    struct bench t;
+    volatile long sink = 0;
+    unsigned int sz;
+    int s, i;
+
+    for (s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+        sz = sizes[s];
+
+        bench_start(&t);
+        for (i = 0; i < NITER; i++)
+            memcpy(b, a, sz);
+        report("memcpy", sz, &t, 0);
+        bench_start(&t);
+        for (i = 0; i < NITER; i++)
+            byte_memcpy(b, a, sz);
+        report("memcpy", sz, &t, 1);
+
+        bench_start(&t);
+        for (i = 0; i < NITER; i++)
+            memset(a, 'x', sz);
+        report("memset", sz, &t, 0);
+        bench_start(&t);
+        for (i = 0; i < NITER; i++)
+            byte_memset(a, 'x', sz);
+        report("memset", sz, &t, 1);
+
+        // a and b now hold the same _sz_ bytes, so memcmp scans all of them.
+        // Terminating both makes them equal strings of length sz-1.
+
+        byte_memset(b, 'x', sz);
+        a[sz-1] = b[sz-1] = '\0';
+
+        bench_start(&t);
+        for (i = 0; i < NITER; i++)
+            sink += memcmp(a, b, sz);
+        report("memcmp", sz, &t, 0);
+        bench_start(&t);
+        for (i = 0; i < NITER; i++)
+            sink += byte_memcmp(a, b, sz);
+        report("memcmp", sz, &t, 1);
+
+        bench_start(&t);
+        for (i = 0; i < NITER; i++)
+            sink += strlen(a);
+        report("strlen", sz, &t, 0);
+        bench_start(&t);
+        for (i = 0; i < NITER; i++)
+            sink += byte_strlen(a);
+        report("strlen", sz, &t, 1);
+
+        bench_start(&t);
+        for (i = 0; i < NITER; i++)
+            sink += strncmp(a, b, sz);
+        report("strncmp", sz, &t, 0);
+        bench_start(&t);
+        for (i = 0; i < NITER; i++)
+            sink += byte_strncmp(a, b, sz);
+        report("strncmp", sz, &t, 1);
+    }
+}
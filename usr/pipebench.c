@@ -0,0 +1,111 @@
+// pipebench.c - Pipe latency and throughput microbenchmark
+//
+// Copyright (c) 2024-2025 University of Illinois
+// SPDX-License-identifier: NCSA
+//
+
+// Measures a one-byte round trip between two processes over a pair of pipes,
+// then the throughput of one process writing to another through a pipe in
+// chunks of several sizes. Each round trip includes two context switches.
+
+#include "syscall.h"
+#include "string.h"
+#include "bench.h"
+
+#define NITER_PINGPONG 1000
+#define BULK_BYTES (1024*1024)
+#define MAX_CHUNK (64*1024)
+
+static char buf[MAX_CHUNK];
+
+static void fail(const char * what, int result) {
+    printf("pipebench: %s failed (%d)\n", what, result);
+    exit();
+}
+
+static void bench_pingpong(void) {
+    int wfd[2], rfd[2];
+    struct bench b;
+    char c = 'x';
+    int result;
+    int tid;
+    int i;
+
+    if ((result = _pipe(&wfd[0], &rfd[0])) < 0 ||
+        (result = _pipe(&wfd[1], &rfd[1])) < 0)
+        fail("pipe", result);
+
+    tid = _fork();
+
+    if (tid == 0) {
+        // Child echoes bytes from the first pipe into the second until the
+        // parent closes its end of the first.
+
+        close(wfd[0]);
+        close(rfd[1]);
+        while (_read(rfd[0], &c, 1) == 1)
+            _write(wfd[1], &c, 1);
+        _exit();
+    } else if (tid < 0)
+        fail("fork", tid);
+
+    close(rfd[0]);
+    close(wfd[1]);
+
+    bench_start(&b);
+    for (i = 0; i < NITER_PINGPONG; i++) {
+        _write(wfd[0], &c, 1);
+        _read(rfd[1], &c, 1);
+    }
+    bench_stop(&b, "pipe_pingpong", NITER_PINGPONG, 0);
+
+    close(wfd[0]);
+    _wait(tid);
+    close(rfd[1]);
+}
+
+// The child reads until end of file and exits; the timer stops once it has
+// been reaped, so every byte has been consumed.
+
+static void bench_bulk(const char * name, size_t chunk) {
+    struct bench b;
+    int wfd, rfd;
+    size_t left;
+    long n;
+    int result;
+    int tid;
+
+    if ((result = _pipe(&wfd, &rfd)) < 0)
+        fail("pipe", result);
+
+    bench_start(&b);
+
+    tid = _fork();
+
+    if (tid == 0) {
+        close(wfd);
+        while (0 < _read(rfd, buf, chunk))
+            continue;
+        _exit();
+    } else if (tid < 0)
+        fail("fork", tid);
+
+    close(rfd);
+
+    for (left = BULK_BYTES; left != 0; left -= n) {
+        n = _write(wfd, buf, (left < chunk) ? left : chunk);
+        if (n <= 0)
+            fail("write", n);
+    }
+
+    close(wfd);
+    _wait(tid);
+
+    bench_stop(&b, name, BULK_BYTES / chunk, BULK_BYTES);
+}
+
+void main(void) {
+    bench_pingpong();
+    bench_bulk("pipe_bulk_4k", 4096);
+    bench_bulk("pipe_bulk_64k", 64*1024);
+}
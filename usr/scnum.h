@@ -13,6 +13,10 @@
 #define SYSCALL_WAIT    3   // wait for a child to exit
 #define SYSCALL_PRINT   4   // print a message to the console
 #define SYSCALL_USLEEP  5   // sleep for some number of microseconds
+#define SYSCALL_THRCREATE 6 // start a thread in the current process
+#define SYSCALL_THREXIT 7   // terminate the calling thread
+#define SYSCALL_THRJOIN 8   // wait for a thread to exit
+#define SYSCALL_SPAWN   9   // create a process from an executable
 
 #define SYSCALL_DEVOPEN 10  // open a device
 #define SYSCALL_FSOPEN  11  // open a file
@@ -26,5 +30,48 @@
 #define SYSCALL_IOCTL   19  // issue ioctl on fd
 #define SYSCALL_PIPE    20  // create a pipe
 #define SYSCALL_IODUP   21  //duplicate descriptor
+#define SYSCALL_FUTEX   22  // wait on or wake a user-space address
+#define SYSCALL_MULTICALL 23 // run a batch of system calls
+#define SYSCALL_AIOSETUP 24  // register an asynchronous I/O ring
+#define SYSCALL_AIOENTER 25  // submit ring entries and wait for completions
+#define SYSCALL_READV   26  // read from fd into several buffers
+#define SYSCALL_WRITEV  27  // write to fd from several buffers
+#define SYSCALL_PREADV  28  // readv at a position
+#define SYSCALL_PWRITEV 29  // writev at a position
+#define SYSCALL_SPLICE  30  // move data between fds inside the kernel
+#define SYSCALL_SHMCREATE 31 // create a shared memory segment
+#define SYSCALL_SHMATTACH 32 // map a shared memory segment
+#define SYSCALL_SHMDETACH 33 // unmap a shared memory segment
+#define SYSCALL_POLL    34  // wait for descriptors to become ready
+
+// A multicall batch is an array of these. Each entry names a system call and
+// its arguments, and the kernel writes the call's return value to _result_.
+// Entries after a stop (see MULTICALL_STOPERR) are left untouched.
+
+#define MULTICALL_NARGS   6
+#define MULTICALL_STOPERR 1 // stop at the first entry that returns < 0
+
+#ifndef __ASSEMBLER__
+struct syscall_desc {
+    long num;
+    long args[MULTICALL_NARGS];
+    long result;
+};
+#endif
+
+// The poll system call takes an array of these. The kernel sets _revents_ to
+// the subset of _events_ (plus POLLHUP) that is ready on _fd_.
+
+#define POLLIN  0x1 // read will not block
+#define POLLOUT 0x2 // write will not block
+#define POLLHUP 0x4 // other end closed
+
+#ifndef __ASSEMBLER__
+struct pollfd {
+    int fd;
+    short events;
+    short revents;
+};
+#endif
 
 #endif // _SCNUM_H_
\ No newline at end of file
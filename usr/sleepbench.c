@@ -0,0 +1,46 @@
+// sleepbench.c - Timer sleep accuracy benchmark
+//
+// Copyright (c) 2024-2025 University of Illinois
+// SPDX-License-identifier: NCSA
+//
+
+// Sleeps repeatedly for several durations and reports how long each sleep
+// actually took. ns_per_op is the mean time per sleep; a second line named
+// <name>_late gives the worst and mean oversleep in microseconds.
+
+#include "syscall.h"
+#include "string.h"
+#include "bench.h"
+
+#define NITER 20
+
+static const unsigned long durations[] = { 0, 100, 1000, 10000, 50000 };
+
+void main(void) {
+    unsigned long t0, dt, us, late, worst, total;
+    char namebuf[32];
+    struct bench b;
+    int d, i;
+
+    for (d = 0; d < sizeof(durations) / sizeof(durations[0]); d++) {
+        us = durations[d];
+        worst = 0;
+        total = 0;
+
+        bench_start(&b);
+        for (i = 0; i < NITER; i++) {
+            t0 = rdtime();
+            _usleep(us);
+            dt = (rdtime() - t0) / (BENCH_TIMER_FREQ / 1000000);
+            late = (us < dt) ? dt - us : 0;
+            total += late;
+            if (worst < late)
+                worst = late;
+        }
+        snprintf(namebuf, sizeof(namebuf), "sleep_%luus", us);
+        bench_stop(&b, namebuf, NITER, 0);
+
+        printf("BENCH name=%s_late requested_us=%lu max_late_us=%lu "
+            "mean_late_us=%lu\n", namebuf, us, worst, total / NITER);
+    }
+}
@@ -15,6 +15,29 @@
 #define UART_DESC 2
 #define NDEV     16
 
+// IOBUF_SIZE is the size of each descriptor's input and output buffers.
+
+#ifndef IOBUF_SIZE
+#define IOBUF_SIZE 512
+#endif
+
+// INTERNAL CONSTANT DEFINITIONS
+//
+
+// WORD_HAS_ZERO(w) is nonzero exactly when some byte of _w_ is zero: only a
+// zero byte can borrow into its own high bit while that bit is clear in _w_.
+
+#define WORD_SIZE sizeof(unsigned long)
+#define WORD_ONES 0x0101010101010101UL
+#define WORD_HIGHS 0x8080808080808080UL
+#define WORD_HAS_ZERO(w) (((w) - WORD_ONES) & ~(w) & WORD_HIGHS)
+
+// With the vector extension (RVV=1 in the Makefile), memcpy and memset hand
+// buffers of at least VEC_MIN_BYTES to a vector loop. Smaller ones are not
+// worth the vector unit trap a thread takes on its first vector instruction.
+
+#define VEC_MIN_BYTES 256
+
 // INTERNAL STRUCTURE DEFINITIONS
 // 
 
@@ -23,6 +46,19 @@ struct vsnprintf_state {
     size_t rem;
 };
 
+// Each descriptor below NDEV gets an output buffer, emptied according to its
+// mode (see setvbuf), and an input buffer that is refilled with one _read of
+// up to IOBUF_SIZE bytes (one byte if unbuffered).
+
+struct iobuf {
+    char mode; // IOBUF_* (0 until first use)
+    unsigned short wlen; // bytes in wbuf
+    unsigned short rpos; // next byte to return from rbuf
+    unsigned short rlen; // bytes in rbuf
+    char wbuf[IOBUF_SIZE];
+    char rbuf[IOBUF_SIZE];
+};
+
 // INTERNAL FUNCTION DECLARATIONS
 // 
 
@@ -40,6 +76,15 @@ static void vprintf_putc(char c, void * __attribute__ ((unused)) aux);
 
 static void dvprintf_putc(char c, void * aux);
 
+static struct iobuf * fd_iobuf(int fd);
+static void iobuf_putc(int fd, char c);
+static int iobuf_getc(int fd, char * c);
+
+// INTERNAL GLOBAL VARIABLES
+//
+
+static struct iobuf iobufs[NDEV];
+
 
 // EXPORTED FUNCTION DEFINITIONS
 // 
@@ -62,15 +107,15 @@ void dputc(int fd, char c) {
 
     switch (c) {
     case '\r':
-        _write(fd, &c, 1);
-        _write(fd, "\n",1);
+        iobuf_putc(fd, c);
+        iobuf_putc(fd, '\n');
         break;
     case '\n':
         if (pcprev[fd] != '\r')
-            _write(fd, "\r",1);
+            iobuf_putc(fd, '\r');
         // nobreak
     default:
-        _write(fd, &c, 1);
+        iobuf_putc(fd, c);
         break;
     }
 
@@ -83,7 +128,8 @@ char dgetc(int fd) {
     // Convert \r followed by any number of \n to just \n 
 
     do {
-        _read(fd,&c,1);
+        if (iobuf_getc(fd, &c) <= 0)
+            return '\0'; // end of input
     } while (c == '\n' && gcprev[fd] == '\r');
   
     gcprev[fd] = c;
@@ -177,6 +223,65 @@ void printf(const char * fmt, ...) {
 }
 
 
+int setvbuf(int fd, int mode) {
+    struct iobuf * const b = fd_iobuf(fd);
+
+    if (b == NULL || mode < IOBUF_UNBUF || IOBUF_FULL < mode)
+        return -1;
+
+    fflush(fd);
+    b->mode = mode;
+    return 0;
+}
+
+void fflush(int fd) {
+    struct iobuf * b;
+    long n;
+    int i;
+
+    if (fd < 0) {
+        for (i = 0; i < NDEV; i++)
+            fflush(i);
+        return;
+    }
+
+    b = fd_iobuf(fd);
+    if (b == NULL)
+        return;
+
+    for (i = 0; i < b->wlen; i += n) {
+        n = _write(fd, b->wbuf + i, b->wlen - i);
+        if (n <= 0)
+            break;
+    }
+
+    b->wlen = 0;
+}
+
+// Read-ahead is dropped as well as pending output being sent, so that the
+// next file opened at _fd_ starts with empty buffers.
+
+int close(int fd) {
+    struct iobuf * b;
+
+    fflush(fd);
+
+    if (0 <= fd && fd < NDEV) {
+        b = &iobufs[fd];
+        b->mode = 0;
+        b->wlen = 0;
+        b->rpos = 0;
+        b->rlen = 0;
+    }
+
+    return _close(fd);
+}
+
+void exit(void) {
+    fflush(-1);
+    _exit();
+}
+
 int strcmp(const char * s1, const char * s2) {
     // A null pointer compares before any non-null pointer
 
@@ -203,6 +308,34 @@ int strcmp(const char * s1, const char * s2) {
 }
 
 int strncmp(const char * s1, const char * s2, size_t n) {
+  const unsigned long * w1;
+  const unsigned long * w2;
+
+  // If both strings have the same alignment, skip whole words that match and
+  // have no null byte, then finish byte by byte.
+
+  if ((((uintptr_t)s1 ^ (uintptr_t)s2) & (WORD_SIZE-1)) == 0) {
+    while (n != 0 && ((uintptr_t)s1 & (WORD_SIZE-1)) != 0 &&
+      *s1 != '\0' && *s1 == *s2)
+    {
+      s1 += 1;
+      s2 += 1;
+      n -= 1;
+    }
+
+    if (((uintptr_t)s1 & (WORD_SIZE-1)) == 0) {
+      w1 = (const unsigned long *)s1;
+      w2 = (const unsigned long *)s2;
+      while (WORD_SIZE <= n && *w1 == *w2 && !WORD_HAS_ZERO(*w1)) {
+        w1 += 1;
+        w2 += 1;
+        n -= WORD_SIZE;
+      }
+      s1 = (const char *)w1;
+      s2 = (const char *)w2;
+    }
+  }
+
   while (n != 0 && *s1 != '\0' && *s1 == *s2) {
     s1 += 1;
     s2 += 1;
@@ -216,11 +349,27 @@ int strncmp(const char * s1, const char * s2, size_t n) {
 }
 
 size_t strlen(const char * s) {
+    const unsigned long * w;
     const char * p = s;
 
     if (s == NULL)
         return 0;
 
+    // Bytes up to a word boundary, then whole words until one has a null
+    // byte. An aligned word never crosses a page boundary, so reading past
+    // the end of the string this way cannot fault.
+
+    while (((uintptr_t)p & (WORD_SIZE-1)) != 0) {
+        if (*p == '\0')
+            return (p - s);
+        p += 1;
+    }
+
+    w = (const unsigned long *)p;
+    while (!WORD_HAS_ZERO(*w))
+        w += 1;
+
+    p = (const char *)w;
     while (*p != '\0')
         p += 1;
     
@@ -265,9 +414,55 @@ char * strrchr(const char * s, int c) {
     return p;
 }
 
+// The memory functions below move bytes only up to the first word boundary
+// and after the last one; in between they use 64-bit loads and stores, eight
+// at a time while possible. When the two pointers of memcpy or memcmp are not
+// equally aligned, they fall back to bytes, since misaligned word accesses
+// trap on many rv64 cores.
+
 void * memset(void * s, int c, size_t n) {
-  char * p = s;
+  unsigned char * p = s;
+  unsigned long * w;
+  unsigned long v;
+
+#ifdef __riscv_vector
+  if (VEC_MIN_BYTES <= n) {
+    asm volatile (
+    "   vsetvli t0, %1, e8, m8, ta, ma \n"
+    "   vmv.v.x v0, %2                 \n"
+    "1: vsetvli t0, %1, e8, m8, ta, ma \n"
+    "   vse8.v  v0, (%0)               \n"
+    "   add     %0, %0, t0             \n"
+    "   sub     %1, %1, t0             \n"
+    "   bnez    %1, 1b                 \n"
+    :   "+r" (p), "+r" (n)
+    :   "r" (c)
+    :   "t0", "v0", "v1", "v2", "v3", "v4", "v5", "v6", "v7", "memory");
+    return s;
+  }
+#endif
+
+  while (n != 0 && ((uintptr_t)p & (WORD_SIZE-1)) != 0) {
+    *p++ = c;
+    n -= 1;
+  }
 
+  v = (unsigned char)c * WORD_ONES;
+  w = (unsigned long *)p;
+
+  while (8*WORD_SIZE <= n) {
+    w[0] = v; w[1] = v; w[2] = v; w[3] = v;
+    w[4] = v; w[5] = v; w[6] = v; w[7] = v;
+    w += 8;
+    n -= 8*WORD_SIZE;
+  }
+
+  while (WORD_SIZE <= n) {
+    *w++ = v;
+    n -= WORD_SIZE;
+  }
+
+  p = (unsigned char *)w;
   while (n != 0) {
     *p++ = c;
     n -= 1;
@@ -279,7 +474,52 @@ void * memset(void * s, int c, size_t n) {
 void * memcpy(void * restrict dst, const void * restrict src, size_t n) {
     const char * q = src;
     char * p = dst;
-    
+    const unsigned long * wq;
+    unsigned long * wp;
+
+#ifdef __riscv_vector
+    if (VEC_MIN_BYTES <= n) {
+        asm volatile (
+        "1: vsetvli t0, %2, e8, m8, ta, ma \n"
+        "   vle8.v  v0, (%1)               \n"
+        "   vse8.v  v0, (%0)               \n"
+        "   add     %0, %0, t0             \n"
+        "   add     %1, %1, t0             \n"
+        "   sub     %2, %2, t0             \n"
+        "   bnez    %2, 1b                 \n"
+        :   "+r" (p), "+r" (q), "+r" (n)
+        :
+        :   "t0", "v0", "v1", "v2", "v3", "v4", "v5", "v6", "v7", "memory");
+        return dst;
+    }
+#endif
+
+    if ((((uintptr_t)p ^ (uintptr_t)q) & (WORD_SIZE-1)) == 0) {
+        while (n != 0 && ((uintptr_t)p & (WORD_SIZE-1)) != 0) {
+            *p++ = *q++;
+            n -= 1;
+        }
+
+        wp = (unsigned long *)p;
+        wq = (const unsigned long *)q;
+
+        while (8*WORD_SIZE <= n) {
+            wp[0] = wq[0]; wp[1] = wq[1]; wp[2] = wq[2]; wp[3] = wq[3];
+            wp[4] = wq[4]; wp[5] = wq[5]; wp[6] = wq[6]; wp[7] = wq[7];
+            wp += 8;
+            wq += 8;
+            n -= 8*WORD_SIZE;
+        }
+
+        while (WORD_SIZE <= n) {
+            *wp++ = *wq++;
+            n -= WORD_SIZE;
+        }
+
+        p = (char *)wp;
+        q = (const char *)wq;
+    }
+
     while (n != 0) {
         *p = *q;
         p += 1;
@@ -293,6 +533,33 @@ void * memcpy(void * restrict dst, const void * restrict src, size_t n) {
 int memcmp(const void * p1, const void * p2, size_t n) {
     const uint8_t * u = p1;
     const uint8_t * v = p2;
+    const unsigned long * wu;
+    const unsigned long * wv;
+
+    // Skip equal words; the bytes of the first differing word (if any) are
+    // compared below to find the sign.
+
+    if ((((uintptr_t)u ^ (uintptr_t)v) & (WORD_SIZE-1)) == 0) {
+        while (n != 0 && ((uintptr_t)u & (WORD_SIZE-1)) != 0) {
+            if (*u != *v)
+                return (*u - *v);
+            u += 1;
+            v += 1;
+            n -= 1;
+        }
+
+        wu = (const unsigned long *)u;
+        wv = (const unsigned long *)v;
+
+        while (WORD_SIZE <= n && *wu == *wv) {
+            wu += 1;
+            wv += 1;
+            n -= WORD_SIZE;
+        }
+
+        u = (const uint8_t *)wu;
+        v = (const uint8_t *)wv;
+    }
 
     while (n != 0) {
         if (*u != *v)
@@ -601,4 +868,60 @@ void vprintf_putc(char c, void * __attribute__ ((unused)) aux) {
 
 void dvprintf_putc(char c, void *  aux) {
     dputc(*((int*)aux), c);
+}
+
+// Returns the buffer for _fd_, giving it its default mode on first use: line
+// buffered for the console, fully buffered otherwise. Returns NULL if _fd_ is
+// out of range, in which case the caller does unbuffered I/O.
+
+struct iobuf * fd_iobuf(int fd) {
+    struct iobuf * b;
+
+    if (fd < 0 || NDEV <= fd)
+        return NULL;
+
+    b = &iobufs[fd];
+    if (b->mode == 0)
+        b->mode = (fd == UART_DESC) ? IOBUF_LINE : IOBUF_FULL;
+    return b;
+}
+
+void iobuf_putc(int fd, char c) {
+    struct iobuf * const b = fd_iobuf(fd);
+
+    if (b == NULL || b->mode == IOBUF_UNBUF) {
+        if (b != NULL)
+            fflush(fd); // in case the mode was just changed
+        _write(fd, &c, 1);
+        return;
+    }
+
+    b->wbuf[b->wlen++] = c;
+
+    if (b->wlen == IOBUF_SIZE || (b->mode == IOBUF_LINE && c == '\n'))
+        fflush(fd);
+}
+
+// Returns 1 and stores the next input byte in _c_, or returns 0 at end of
+// input (or a negative error). Before waiting for input, flushes all output,
+// so that a prompt, or a request sent down a pipe, goes out first.
+
+int iobuf_getc(int fd, char * c) {
+    struct iobuf * const b = fd_iobuf(fd);
+    long n;
+
+    if (b == NULL)
+        return _read(fd, c, 1);
+
+    if (b->rpos == b->rlen) {
+        fflush(-1);
+        n = _read(fd, b->rbuf, (b->mode == IOBUF_UNBUF) ? 1 : IOBUF_SIZE);
+        if (n <= 0)
+            return n;
+        b->rpos = 0;
+        b->rlen = n;
+    }
+
+    *c = b->rbuf[b->rpos++];
+    return 1;
 }
\ No newline at end of file
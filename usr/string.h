@@ -26,6 +26,25 @@ extern void dgetsn(int fd, char * buf, size_t n);
 extern void printf(const char * fmt, ...);
 extern void dprintf(int fd, const char * fmt, ...);
 
+// Output through dputc, dputs and dprintf (and putc, puts and printf, which use
+// the console descriptor) is buffered per descriptor. The console is line
+// buffered and other descriptors are fully buffered until changed with
+// setvbuf. Input through dgetc is read ahead in the same way. All output is
+// flushed before waiting for input and by exit, which start.s calls when main
+// returns. The buffers belong to the descriptor number, not to what it refers
+// to, so close descriptors with close, which flushes and discards them, rather
+// than _close. Flush a descriptor before passing it to _exec, and flush
+// everything before _fork so the child does not inherit pending output.
+
+#define IOBUF_UNBUF 1 // every character is written at once
+#define IOBUF_LINE  2 // written at each newline or when the buffer fills
+#define IOBUF_FULL  3 // written when the buffer fills
+
+extern int setvbuf(int fd, int mode);
+extern void fflush(int fd); // all descriptors if fd < 0
+extern int close(int fd);
+extern void __attribute__ ((noreturn)) exit(void);
+
 extern size_t strlen(const char * s);
 extern int strcmp(const char * s1, const char * s2);
 extern int strncmp(const char * s1, const char * s2, size_t n);
@@ -0,0 +1,96 @@
+// sync.c - User-space mutex and condition variable
+//
+// Copyright (c) 2024-2025 University of Illinois
+// SPDX-License-identifier: NCSA
+//
+// The mutex is the classic three-state futex lock. An uncontended lock is one
+// compare-and-swap and an uncontended unlock is one atomic swap; the kernel is
+// only entered when the lock word says there may be a sleeper.
+//
+
+#include "sync.h"
+#include "syscall.h"
+
+#include <limits.h>
+
+// INTERNAL FUNCTION DECLARATIONS
+//
+
+static inline int cas(int * p, int expected, int desired);
+static inline int xchg(int * p, int val);
+
+// EXPORTED FUNCTION DEFINITIONS
+//
+
+void mutex_init(struct mutex * mtx) {
+    __atomic_store_n(&mtx->state, 0, __ATOMIC_RELEASE);
+}
+
+void mutex_lock(struct mutex * mtx) {
+    int c;
+
+    c = cas(&mtx->state, 0, 1);
+    if (c == 0)
+        return;
+
+    // Contended: mark the lock as having waiters and sleep until it is
+    // released. Whoever takes it from here on leaves it in state 2, so the
+    // eventual unlock knows to wake someone.
+
+    if (c != 2)
+        c = xchg(&mtx->state, 2);
+
+    while (c != 0) {
+        _futex(&mtx->state, FUTEX_WAIT, 2);
+        c = xchg(&mtx->state, 2);
+    }
+}
+
+int mutex_trylock(struct mutex * mtx) {
+    return (cas(&mtx->state, 0, 1) == 0);
+}
+
+void mutex_unlock(struct mutex * mtx) {
+    if (xchg(&mtx->state, 0) == 2)
+        _futex(&mtx->state, FUTEX_WAKE, 1);
+}
+
+void condvar_init(struct condvar * cv) {
+    __atomic_store_n(&cv->seq, 0, __ATOMIC_RELEASE);
+}
+
+void condvar_wait(struct condvar * cv, struct mutex * mtx) {
+    int seq;
+
+    // Sample the sequence number before dropping the mutex. A signal that
+    // arrives between the unlock and the futex call changes seq, so the
+    // kernel returns immediately instead of losing the wake-up.
+
+    seq = __atomic_load_n(&cv->seq, __ATOMIC_ACQUIRE);
+    mutex_unlock(mtx);
+    _futex(&cv->seq, FUTEX_WAIT, seq);
+    mutex_lock(mtx);
+}
+
+void condvar_signal(struct condvar * cv) {
+    __atomic_fetch_add(&cv->seq, 1, __ATOMIC_ACQ_REL);
+    _futex(&cv->seq, FUTEX_WAKE, 1);
+}
+
+void condvar_broadcast(struct condvar * cv) {
+    __atomic_fetch_add(&cv->seq, 1, __ATOMIC_ACQ_REL);
+    _futex(&cv->seq, FUTEX_WAKE, INT_MAX);
+}
+
+// INTERNAL FUNCTION DEFINITIONS
+//
+
+static inline int cas(int * p, int expected, int desired) {
+    __atomic_compare_exchange_n(p, &expected, desired, 0,
+        __ATOMIC_ACQUIRE, __ATOMIC_RELAXED);
+    return expected; // value seen before the exchange
+}
+
+static inline int xchg(int * p, int val) {
+    return __atomic_exchange_n(p, val, __ATOMIC_ACQ_REL);
+}
@@ -0,0 +1,33 @@
+// sync.h - User-space mutex and condition variable
+//
+// Copyright (c) 2024-2025 University of Illinois
+// SPDX-License-identifier: NCSA
+//
+
+#ifndef _SYNC_H_
+#define _SYNC_H_
+
+// Both primitives live entirely in user memory and only enter the kernel (via
+// _futex) when a thread actually has to sleep or someone is asleep. They may be
+// placed in memory shared between processes. A zero-filled struct is a valid
+// unlocked mutex or idle condition variable.
+
+struct mutex {
+    int state; // 0 unlocked, 1 locked, 2 locked with (possible) waiters
+};
+
+struct condvar {
+    int seq; // bumped by every signal/broadcast
+};
+
+extern void mutex_init(struct mutex * mtx);
+extern void mutex_lock(struct mutex * mtx);
+extern int mutex_trylock(struct mutex * mtx); // returns 1 if acquired
+extern void mutex_unlock(struct mutex * mtx);
+
+extern void condvar_init(struct condvar * cv);
+extern void condvar_wait(struct condvar * cv, struct mutex * mtx);
+extern void condvar_signal(struct condvar * cv);
+extern void condvar_broadcast(struct condvar * cv);
+
+#endif // _SYNC_H_
@@ -0,0 +1,29 @@
+// sysbench.c - Null system call microbenchmark
+//
+// Copyright (c) 2024-2025 University of Illinois
+// SPDX-License-identifier: NCSA
+//
+
+// Times a system call that does no work (usleep of zero microseconds returns
+// as soon as it is dispatched), so the result is the cost of the trap entry,
+// dispatch and return path. Each round is reported separately so that the
+// spread between rounds is visible.
+
+#include "syscall.h"
+#include "string.h"
+#include "bench.h"
+
+#define NITER   10000
+#define NROUNDS 5
+
+void main(void) {
+    struct bench b;
+    int round, i;
+
+    for (round = 0; round < NROUNDS; round++) {
+        bench_start(&b);
+        for (i = 0; i < NITER; i++)
+            _usleep(0);
+        bench_stop(&b, "null_syscall", NITER, 0);
+    }
+}
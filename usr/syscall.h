@@ -7,22 +7,73 @@
 #ifndef _SYSCALL_H_
 #define _SYSCALL_H_
 
+#include "scnum.h" // for struct syscall_desc
+
 #include <stddef.h>
 
+// Operations for _futex()
+
+#define FUTEX_WAIT  0   // sleep if *uaddr == val
+#define FUTEX_WAKE  1   // wake up to val waiters
+
+// _spawn() fd map: child fd i gets parent fd fdmap[i] (negative leaves it
+// closed). A NULL map passes every open fd through unchanged.
+
+#define SPAWN_FDMAP_LEN 16  // PROCESS_IOMAX
+
+// One segment of a vectored transfer (_readv() and friends). At most IOV_MAX
+// segments are allowed per call. Same layout as in sys/io.h.
+
+#define IOV_MAX 16
+
+struct iovec {
+    void * base;
+    size_t len;
+};
 
 extern void __attribute__ ((noreturn)) _exit(void);
 extern int _exec(int fd, int argc, char ** argv);
 extern int _fork(void);
+extern int _spawn(int fd, int argc, char ** argv, const int * fdmap);
 extern int _wait(int tid);
+extern int _thread_create(void (*entry)(void *), void * arg, void * stack);
+extern void __attribute__ ((noreturn)) _thread_exit(void);
+extern int _thread_join(int tid);
 extern void _print(const char * msg);
 extern int _usleep(unsigned long us);
 extern int _devopen(int fd, const char * name, int instno);
 extern int _fsopen(int fd, const char * name);
+extern int _fscreate(const char * name);
+extern int _fsdelete(const char * name);
 extern int _close(int fd);
 extern long _read(int fd, void * buf, size_t bufsz);
 extern long _write(int fd, const void * buf, size_t len);
+extern long _readv(int fd, const struct iovec * iov, int iovcnt);
+extern long _writev(int fd, const struct iovec * iov, int iovcnt);
+extern long _preadv(int fd, const struct iovec * iov, int iovcnt, unsigned long long pos);
+extern long _pwritev(int fd, const struct iovec * iov, int iovcnt, unsigned long long pos);
+extern long _splice(int infd, int outfd, long len, long long offset);
+
+// Shared memory: _shmcreate() returns a descriptor for a new zero-filled
+// segment. Any process with the descriptor can _shmattach() it at a
+// page-aligned address of its choosing and see the same memory.
+
+extern int _shmcreate(int fd, size_t size);
+extern int _shmattach(int fd, void * addr);
+extern int _shmdetach(int fd, void * addr);
+
+// Waits up to _timeout_us_ microseconds (forever if negative) for one of the
+// descriptors in _fds_ to be ready and returns the number that are.
+
+extern int _poll(struct pollfd * fds, int nfds, long timeout_us);
 extern int _ioctl(int fd, const int cmd, void * arg);
 extern int _iodup(int oldfd, int newfd);
 extern int _pipe(int * wfdptr, int * rfdptr);
+extern int _futex(int * uaddr, int op, int val);
+extern int _multicall(struct syscall_desc * descs, int cnt, int flags);
+
+struct aio_ring; // usr/aio.h
+extern int _aio_setup(struct aio_ring * ring);
+extern int _aio_enter(unsigned int min_complete);
 
 #endif // _SYSCALL_H_
\ No newline at end of file
@@ -0,0 +1,66 @@
+// thread.c - User threads
+//
+// Copyright (c) 2024-2025 University of Illinois
+// SPDX-License-identifier: NCSA
+//
+
+#include "thread.h"
+#include "syscall.h"
+#include "heap.h"
+
+#include <stdint.h>
+
+// INTERNAL TYPE DEFINITIONS
+//
+
+// Placed at the top of each new thread's stack, so the kernel only has to pass
+// one argument to thread_start.
+
+struct thread_start_args {
+    void (*fn)(void * arg);
+    void * arg;
+};
+
+// INTERNAL FUNCTION DECLARATIONS
+//
+
+static void __attribute__ ((noreturn)) thread_start(struct thread_start_args * sa);
+
+// EXPORTED FUNCTION DEFINITIONS
+//
+
+int thread_create(void (*fn)(void * arg), void * arg) {
+    struct thread_start_args * sa;
+    uintptr_t sp;
+    char * stack;
+
+    stack = malloc(THREAD_STACK_SIZE);
+    if (stack == NULL)
+        return -1;
+
+    // The RISC-V ABI wants a 16-byte aligned stack pointer.
+
+    sp = ((uintptr_t)stack + THREAD_STACK_SIZE) & ~(uintptr_t)15;
+    sp -= (sizeof(struct thread_start_args) + 15) & ~(uintptr_t)15;
+    sa = (struct thread_start_args *)sp;
+    sa->fn = fn;
+    sa->arg = arg;
+
+    return _thread_create((void (*)(void *))thread_start, sa, (void *)sp);
+}
+
+int thread_join(int tid) {
+    return _thread_join(tid);
+}
+
+void thread_exit(void) {
+    _thread_exit();
+}
+
+// INTERNAL FUNCTION DEFINITIONS
+//
+
+void thread_start(struct thread_start_args * sa) {
+    sa->fn(sa->arg);
+    _thread_exit();
+}
@@ -0,0 +1,28 @@
+// thread.h - User threads
+//
+// Copyright (c) 2024-2025 University of Illinois
+// SPDX-License-identifier: NCSA
+//
+
+#ifndef _THREAD_H_
+#define _THREAD_H_
+
+#include <stddef.h>
+
+#ifndef THREAD_STACK_SIZE
+#define THREAD_STACK_SIZE 16384
+#endif
+
+// Starts _fn(arg)_ on a new thread that shares this process's memory and open
+// files. The thread exits when _fn_ returns. Returns the thread id or a
+// negative error code.
+
+extern int thread_create(void (*fn)(void * arg), void * arg);
+
+// Waits for a thread started by the caller to exit. Returns its thread id.
+
+extern int thread_join(int tid);
+
+extern void __attribute__ ((noreturn)) thread_exit(void);
+
+#endif // _THREAD_H_
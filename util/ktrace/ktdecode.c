@@ -0,0 +1,69 @@
+// ktdecode.c - Print a kernel trace captured with usr/ktdump
+//
+// Copyright (c) 2024-2025 University of Illinois
+// SPDX-License-identifier: NCSA
+//
+
+// Host-side decoder for the records written by the kernel's trace ring (see
+// sys/ktrace.h, whose layout and event numbers this file repeats). Build with
+//
+//     cc -O2 -o ktdecode ktdecode.c
+//
+// and run as "ktdecode [trace.bin]" (standard input if no file is named).
+// Times are printed in microseconds since the first record.
+
+#include <stdio.h>
+#include <stdint.h>
+#include <inttypes.h>
+
+#define TIMER_FREQ 10000000UL // sys/conf.h
+
+struct ktrace_rec {
+    uint64_t time;
+    uint16_t type;
+    uint16_t tid;
+    uint32_t a0;
+    uint64_t a1;
+};
+
+static const char * const event_names[] = {
+    [1] = "syscall-enter",
+    [2] = "syscall-exit",
+    [3] = "switch",
+    [4] = "cache-hit",
+    [5] = "cache-miss",
+    [6] = "vioblk-submit",
+    [7] = "vioblk-done",
+    [8] = "page-fault"
+};
+
+#define NEVENTS (sizeof(event_names) / sizeof(event_names[0]))
+
+int main(int argc, char ** argv) {
+    struct ktrace_rec r;
+    uint64_t t0 = 0;
+    unsigned long n = 0;
+    const char * name;
+    FILE * f = stdin;
+
+    if (1 < argc && (f = fopen(argv[1], "rb")) == NULL) {
+        perror(argv[1]);
+        return 1;
+    }
+
+    while (fread(&r, sizeof(r), 1, f) == 1) {
+        if (n++ == 0)
+            t0 = r.time;
+
+        name = (r.type < NEVENTS) ? event_names[r.type] : NULL;
+
+        printf("%12.3f  tid %-3u %-14s a0=%-8" PRIu32 " a1=0x%" PRIx64 "\n",
+            (double)(r.time - t0) * 1e6 / TIMER_FREQ,
+            r.tid, name ? name : "?", r.a0, r.a1);
+    }
+
+    if (f != stdin)
+        fclose(f);
+
+    return 0;
+}